@@ -0,0 +1,94 @@
+#include "bench_stats.h"
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return bench_now_ns();
+#endif
+}
+
+double bench_cycles_per_ns(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    // Spin for about 20 ms against the monotonic clock
+    uint64_t start_ns = bench_now_ns();
+    uint64_t start_cycles = bench_cycles();
+    uint64_t elapsed_ns;
+    do {
+        elapsed_ns = bench_now_ns() - start_ns;
+    } while (elapsed_ns < 20000000ull);
+    return (double)(bench_cycles() - start_cycles) / elapsed_ns;
+#else
+    return 1.0;
+#endif
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+* Nearest-rank percentile of sorted samples.
+*/
+static double percentile(const double *sorted, uint32_t count, double p) {
+    uint32_t rank = (uint32_t)(p * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+void bench_compute_stats(double *samples, uint32_t count, BENCH_STATS *stats) {
+    if (count == 0) {
+        stats->min = stats->p50 = stats->p95 = stats->p99 = stats->max = stats->mean = 0.0;
+        return;
+    }
+
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+
+    stats->min = samples[0];
+    stats->p50 = percentile(samples, count, 0.50);
+    stats->p95 = percentile(samples, count, 0.95);
+    stats->p99 = percentile(samples, count, 0.99);
+    stats->max = samples[count - 1];
+    stats->mean = sum / count;
+}
+
+void bench_json_stats(FILE *f, const BENCH_STATS *stats) {
+    fprintf(f, "{\"min\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"mean\": %.3f}",
+            stats->min, stats->p50, stats->p95, stats->p99, stats->max, stats->mean);
+}
+
+void bench_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
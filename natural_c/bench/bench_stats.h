@@ -0,0 +1,60 @@
+#ifndef BENCH_STATS_H
+#define BENCH_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+* Timing and statistics helpers shared by the benchmark executables.
+*/
+
+/*
+* Distribution of a set of samples (percentiles use the nearest-rank method).
+*/
+typedef struct {
+    double min;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+    double mean;
+} BENCH_STATS;
+
+/*
+* Returns a monotonic timestamp in nanoseconds.
+*/
+uint64_t bench_now_ns(void);
+
+/*
+* Returns a cycle count for short measurements: the time stamp counter on x86 (constant-rate
+* reference cycles, independent of turbo state), nanoseconds elsewhere. BENCH_CYCLE_UNIT names the unit.
+*/
+uint64_t bench_cycles(void);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BENCH_CYCLE_UNIT "cycles"
+#else
+#define BENCH_CYCLE_UNIT "ns"
+#endif
+
+/*
+* Measures how many bench_cycles units pass per nanosecond (1.0 without a cycle counter).
+*/
+double bench_cycles_per_ns(void);
+
+/*
+* Sorts 'samples' in place and fills 'stats'. All fields are 0 for an empty set.
+*/
+void bench_compute_stats(double *samples, uint32_t count, BENCH_STATS *stats);
+
+/*
+* Writes 'stats' as a JSON object.
+*/
+void bench_json_stats(FILE *f, const BENCH_STATS *stats);
+
+/*
+* Writes 's' as a JSON string literal (quoted and escaped).
+*/
+void bench_json_string(FILE *f, const char *s);
+
+#endif
@@ -0,0 +1,497 @@
+#include "bench_stats.h"
+#include "dct.h"
+#include "bmp_handler.h"
+#include "color_spaces.h"
+#include "grayscale.h"
+#include "simd.h"
+#include "entropy.h"
+#include "output_sink.h"
+#include "jpegenc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/*
+* jpeg_bench - per-stage timing of the natural_c encoder over a corpus of BMP files.
+* The staged pipeline is timed stage by stage, with the same stage split as the C7x
+* DEBUG_CYCLE_COUNT report (fetch, DCT, quantization, zigzag, Huffman). The fused pipeline
+* is timed end to end through the library. All timings run on one thread.
+*
+* Usage: jpeg_bench [options] <file.bmp | directory>...
+*/
+
+#define STAGE_COUNT 5
+#define MAX_CORPUS_FILES 4096
+
+static const char *stage_keys[STAGE_COUNT] = { "fetch", "dct", "quantization", "zigzag", "huffman" };
+static const char *stage_labels[STAGE_COUNT] = {
+    "RGB -> Y Conversion (segm, Y conv, cent.)",
+    "DCT Transform (Total)",
+    "Quantization",
+    "ZigZag Reorder",
+    "Huffman Encoding"
+};
+
+typedef struct {
+    int iterations;
+    int warmup;
+    int quality;
+    DCT_METHOD dct_method;
+    SIMD_ISA isa;
+    const char *json_path;      // NULL = no JSON, "-" = stdout (the tables are not printed)
+} BENCH_OPTIONS;
+
+typedef struct {
+    char *paths[MAX_CORPUS_FILES];
+    int count;
+} CORPUS;
+
+typedef struct {
+    const char *path;
+    uint32_t width;
+    uint32_t height;
+    uint32_t block_count;
+    size_t input_bytes;         // BGR bytes of the image (width * height * 3)
+    size_t scan_bytes;
+    size_t jpeg_bytes;
+    BENCH_STATS stages[STAGE_COUNT];    // all in ns per block
+    BENCH_STATS staged;
+    BENCH_STATS fused;
+} IMAGE_RESULT;
+
+/*
+* Buffers reused by every staged iteration, like an encoder serving a stream of frames.
+*/
+typedef struct {
+    float *coeffs;
+    int32_t *coeffs_int;
+    int16_t *quantized;
+    int16_t *zigzag;
+    GROWABLE_BUFFER scan;
+    BW_SINK scan_sink;
+} STAGED_BUFFERS;
+
+static const char* dct_method_name(DCT_METHOD method) {
+    switch (method) {
+        case DCT_METHOD_EXACT: return "exact";
+        case DCT_METHOD_ISLOW: return "int";
+        case DCT_METHOD_IFAST: return "fast";
+        default: return "float";
+    }
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int add_corpus_file(CORPUS *corpus, const char *path) {
+    if (corpus->count == MAX_CORPUS_FILES) {
+        printf("Warning: At most %d files are benchmarked, ignoring '%s'.\n", MAX_CORPUS_FILES, path);
+        return -1;
+    }
+    corpus->paths[corpus->count++] = strdup(path);
+    return 0;
+}
+
+/*
+* Adds a file, or every .bmp file of a directory (sorted by name, not recursive).
+*/
+static void add_corpus_input(CORPUS *corpus, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        printf("Warning: Cannot open '%s', skipping it.\n", path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        add_corpus_file(corpus, path);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        printf("Warning: Cannot read directory '%s', skipping it.\n", path);
+        return;
+    }
+
+    int first = corpus->count;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length < 4 || strcmp(entry->d_name + length - 4, ".bmp") != 0) continue;
+
+        char file[4096];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        if (add_corpus_file(corpus, file) != 0) break;
+    }
+    closedir(dir);
+
+    qsort(corpus->paths + first, corpus->count - first, sizeof(char*), compare_paths);
+}
+
+/*
+* One pass of the staged pipeline with a timestamp between stages.
+* Returns 0 on success, -1 on error; 'ns' receives the time of each stage.
+*/
+static int run_staged(BMP_IMAGE *image, uint32_t width, uint32_t height, const BENCH_OPTIONS *options,
+                      const KERNEL_TABLE *kernels, const QUANT_TABLE *qt, const INT_QUANT_TABLE *int_qt,
+                      STAGED_BUFFERS *buffers, uint64_t ns[STAGE_COUNT], size_t *scan_bytes) {
+    uint32_t blocks_w, blocks_h;
+    float *blocks;
+    uint64_t t[STAGE_COUNT + 1];
+
+    t[0] = bench_now_ns();
+
+    RGB *pixels = read_pixels(image->buffer, width, height, image->info.height < 0);
+    float *grayscale_y = convert_to_grayscale(pixels, width, height);
+    free(pixels);
+    center_around_zero(grayscale_y, width, height);
+    image_to_blocks(grayscale_y, width, height, &blocks_w, &blocks_h, &blocks);
+    free(grayscale_y);
+
+    t[1] = bench_now_ns();
+
+    uint32_t block_count = blocks_w * blocks_h;
+    int integer = int_qt != NULL;
+    if (integer) {
+        perform_dct_int(blocks, blocks_w, blocks_h, buffers->coeffs_int, options->dct_method);
+    } else {
+        perform_dct(blocks, blocks_w, blocks_h, buffers->coeffs, options->dct_method);
+    }
+    free(blocks);
+
+    t[2] = bench_now_ns();
+
+    for (uint32_t i = 0; i < block_count; i++) {
+        if (integer) {
+            kernels->quantize_int(&buffers->coeffs_int[(size_t)i * 64], int_qt, &buffers->quantized[(size_t)i * 64]);
+        } else {
+            kernels->quantize(&buffers->coeffs[(size_t)i * 64], qt, &buffers->quantized[(size_t)i * 64]);
+        }
+    }
+
+    t[3] = bench_now_ns();
+
+    for (uint32_t i = 0; i < block_count; i++) {
+        kernels->zigzag(&buffers->quantized[(size_t)i * 64], &buffers->zigzag[(size_t)i * 64]);
+    }
+
+    t[4] = bench_now_ns();
+
+    BitWriter bw;
+    bw_init_sink(&bw, &buffers->scan_sink);
+    int status = encode_blocks(buffers->zigzag, block_count, 0, &std_lum_huffman, 1, NULL, &bw);
+    if (bw_finish(&bw) != 0) status = -1;
+
+    t[5] = bench_now_ns();
+
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        ns[s] = t[s + 1] - t[s];
+    }
+    *scan_bytes = bw.byte_pos;
+    return status;
+}
+
+/*
+* Benchmarks one image. Returns 0 on success, -1 if the image could not be loaded or encoded.
+*/
+static int bench_image(const char *path, const BENCH_OPTIONS *options, const KERNEL_TABLE *kernels,
+                       IMAGE_RESULT *result) {
+    BMP_IMAGE image = load_bmp_image(path);
+    if (image.buffer == NULL) {
+        return -1;
+    }
+
+    uint32_t width = (uint32_t)image.info.width;
+    uint32_t height = (uint32_t)(image.info.height < 0 ? -image.info.height : image.info.height);
+    uint32_t block_count = ((width + 7) / 8) * ((height + 7) / 8);
+    size_t coeff_count = (size_t)block_count * 64;
+
+    memset(result, 0, sizeof(*result));
+    result->path = path;
+    result->width = width;
+    result->height = height;
+    result->block_count = block_count;
+    result->input_bytes = (size_t)width * height * 3;
+
+    QUANT_TABLE qt;
+    INT_QUANT_TABLE int_qt;
+    int integer = options->dct_method == DCT_METHOD_ISLOW || options->dct_method == DCT_METHOD_IFAST;
+    init_quant_table(&qt, options->quality);
+    if (integer) {
+        init_int_quant_table(&int_qt, qt.natural, options->dct_method);
+    }
+
+    STAGED_BUFFERS buffers;
+    memset(&buffers, 0, sizeof(buffers));
+    if (integer) {
+        buffers.coeffs_int = (int32_t*)malloc(coeff_count * sizeof(int32_t));
+    } else {
+        buffers.coeffs = (float*)malloc(coeff_count * sizeof(float));
+    }
+    buffers.quantized = (int16_t*)malloc(coeff_count * sizeof(int16_t));
+    buffers.zigzag = (int16_t*)malloc(coeff_count * sizeof(int16_t));
+    init_growable_sink(&buffers.scan_sink, &buffers.scan);
+
+    JPEGENC_OPTIONS encoder_options;
+    jpegenc_default_options(&encoder_options, width, height);
+    encoder_options.quality = options->quality;
+    encoder_options.dct_method = options->dct_method;
+    JPEGENC_CONTEXT *ctx = jpegenc_create(&encoder_options);
+
+    int total = options->warmup + options->iterations;
+    double *samples = (double*)malloc((size_t)(STAGE_COUNT + 2) * options->iterations * sizeof(double));
+
+    int status = 0;
+    if ((buffers.coeffs == NULL && buffers.coeffs_int == NULL) || buffers.quantized == NULL ||
+        buffers.zigzag == NULL || samples == NULL || ctx == NULL) {
+        printf("Error: Not enough memory to benchmark '%s'.\n", path);
+        status = -1;
+    }
+
+    // Sample layout: STAGE_COUNT stage series, then staged total, then fused total
+    double *staged_samples = samples + (size_t)STAGE_COUNT * options->iterations;
+    double *fused_samples = staged_samples + options->iterations;
+
+    for (int it = 0; it < total && status == 0; it++) {
+        uint64_t ns[STAGE_COUNT];
+        status = run_staged(&image, width, height, options, kernels, &qt, integer ? &int_qt : NULL,
+                            &buffers, ns, &result->scan_bytes);
+
+        ROW_SOURCE source;
+        BMP_MEMORY_SOURCE source_state;
+        JPEGENC_OUTPUT jpeg;
+        init_bmp_memory_source(&source, &source_state, image.buffer, width, height, image.info.height > 0);
+
+        uint64_t start = bench_now_ns();
+        if (status == 0) {
+            status = jpegenc_encode_rows(ctx, &source, &jpeg);
+        }
+        uint64_t fused_ns = bench_now_ns() - start;
+
+        if (status != 0 || it < options->warmup) continue;
+
+        int sample = it - options->warmup;
+        uint64_t staged_ns = 0;
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            samples[(size_t)s * options->iterations + sample] = (double)ns[s] / block_count;
+            staged_ns += ns[s];
+        }
+        staged_samples[sample] = (double)staged_ns / block_count;
+        fused_samples[sample] = (double)fused_ns / block_count;
+        result->jpeg_bytes = jpeg.size;
+    }
+
+    if (status == 0) {
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            bench_compute_stats(samples + (size_t)s * options->iterations, options->iterations, &result->stages[s]);
+        }
+        bench_compute_stats(staged_samples, options->iterations, &result->staged);
+        bench_compute_stats(fused_samples, options->iterations, &result->fused);
+    }
+
+    jpegenc_destroy(ctx);
+    free(samples);
+    free(buffers.coeffs);
+    free(buffers.coeffs_int);
+    free(buffers.quantized);
+    free(buffers.zigzag);
+    growable_buffer_free(&buffers.scan);
+    free(image.buffer);
+    return status;
+}
+
+/*
+* Megabytes (10^6 bytes) of BGR input per second at a given cost per block.
+*/
+static double mb_per_second(const IMAGE_RESULT *result, double ns_per_block) {
+    double seconds = ns_per_block * result->block_count * 1e-9;
+    return seconds > 0.0 ? result->input_bytes / seconds * 1e-6 : 0.0;
+}
+
+static double blocks_per_second(double ns_per_block) {
+    return ns_per_block > 0.0 ? 1e9 / ns_per_block : 0.0;
+}
+
+/*
+* Prints the per-stage table of one image, laid out like the C7x cycle report.
+*/
+static void print_image_report(const IMAGE_RESULT *r) {
+    const char *separator = "=======================================================================\n";
+    const char *divider   = "-----------------------------------------------------------------------\n";
+    char title[256];
+
+    snprintf(title, sizeof(title), "%s (%ux%u, %u blocks)", r->path, r->width, r->height, r->block_count);
+
+    printf("\n%s", separator);
+    printf("| %-67s |\n", title);
+    printf("%s", separator);
+    printf("| %-42s | %10s | %9s |\n", "JPEG COMPRESSION STAGE", "NS/BLK p50", "p95");
+    printf("%s", divider);
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        printf("| %-42s | %10.2f | %9.2f |\n", stage_labels[s], r->stages[s].p50, r->stages[s].p95);
+    }
+    printf("%s", divider);
+    printf("| %-42s | %10.2f | %9.2f |\n", "TOTAL (staged)", r->staged.p50, r->staged.p95);
+    printf("| %-42s | %10.2f | %9.2f |\n", "TOTAL (fused, library)", r->fused.p50, r->fused.p95);
+    printf("%s", separator);
+    printf("Staged: %.1f MB/s, %.0f blocks/s, %zu bytes of scan data.\n",
+           mb_per_second(r, r->staged.p50), blocks_per_second(r->staged.p50), r->scan_bytes);
+    printf("Fused:  %.1f MB/s, %.0f blocks/s, %zu bytes JPEG.\n",
+           mb_per_second(r, r->fused.p50), blocks_per_second(r->fused.p50), r->jpeg_bytes);
+}
+
+static void json_throughput(FILE *f, const IMAGE_RESULT *r, const BENCH_STATS *stats) {
+    fprintf(f, "{\"ns_per_block\": ");
+    bench_json_stats(f, stats);
+    fprintf(f, ", \"mb_per_s\": %.3f, \"blocks_per_s\": %.1f}", mb_per_second(r, stats->p50), blocks_per_second(stats->p50));
+}
+
+/*
+* Writes the whole run as JSON. Throughput figures are taken at the median.
+*/
+static void write_json(FILE *f, const BENCH_OPTIONS *options, const KERNEL_TABLE *kernels,
+                       const IMAGE_RESULT *results, int count) {
+    double staged_seconds = 0.0, fused_seconds = 0.0;
+    size_t input_bytes = 0;
+
+    fprintf(f, "{\n  \"benchmark\": \"jpeg_bench\",\n");
+    fprintf(f, "  \"isa\": \"%s\",\n  \"dct\": \"%s\",\n  \"quality\": %d,\n", kernels->name,
+            dct_method_name(options->dct_method), options->quality);
+    fprintf(f, "  \"iterations\": %d,\n  \"warmup\": %d,\n  \"images\": [", options->iterations, options->warmup);
+
+    for (int i = 0; i < count; i++) {
+        const IMAGE_RESULT *r = &results[i];
+
+        fprintf(f, "%s\n    {\n      \"file\": ", i ? "," : "");
+        bench_json_string(f, r->path);
+        fprintf(f, ",\n      \"width\": %u, \"height\": %u, \"blocks\": %u,\n", r->width, r->height, r->block_count);
+        fprintf(f, "      \"input_bytes\": %zu, \"scan_bytes\": %zu, \"jpeg_bytes\": %zu,\n",
+                r->input_bytes, r->scan_bytes, r->jpeg_bytes);
+        fprintf(f, "      \"stages\": {");
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            fprintf(f, "%s\n        \"%s\": ", s ? "," : "", stage_keys[s]);
+            bench_json_stats(f, &r->stages[s]);
+        }
+        fprintf(f, "\n      },\n      \"staged\": ");
+        json_throughput(f, r, &r->staged);
+        fprintf(f, ",\n      \"fused\": ");
+        json_throughput(f, r, &r->fused);
+        fprintf(f, "\n    }");
+
+        staged_seconds += r->staged.p50 * r->block_count * 1e-9;
+        fused_seconds += r->fused.p50 * r->block_count * 1e-9;
+        input_bytes += r->input_bytes;
+    }
+
+    fprintf(f, "\n  ],\n  \"corpus\": {\"input_bytes\": %zu, \"staged_mb_per_s\": %.3f, \"fused_mb_per_s\": %.3f}\n}\n",
+            input_bytes, staged_seconds > 0.0 ? input_bytes / staged_seconds * 1e-6 : 0.0,
+            fused_seconds > 0.0 ? input_bytes / fused_seconds * 1e-6 : 0.0);
+}
+
+static void print_usage(void) {
+    printf("Usage: jpeg_bench [options] <file.bmp | directory>...\n");
+    printf("  -iterations N     timed runs per image (default 20)\n");
+    printf("  -warmup N         untimed runs before them (default 2)\n");
+    printf("  -quality Q        1-100 (default 50)\n");
+    printf("  -dct exact|float|int|fast\n");
+    printf("  -isa auto|scalar|sse4|avx2\n");
+    printf("  -json PATH        also write the results as JSON ('-' = stdout only)\n");
+}
+
+int main(int argc, char *argv[]) {
+    BENCH_OPTIONS options = { 20, 2, 50, DCT_METHOD_FLOAT, SIMD_ISA_AUTO, NULL };
+    CORPUS corpus;
+    corpus.count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp("-iterations", argv[i]) == 0 && i + 1 < argc) {
+            options.iterations = atoi(argv[++i]);
+        }
+        else if (strcmp("-warmup", argv[i]) == 0 && i + 1 < argc) {
+            options.warmup = atoi(argv[++i]);
+        }
+        else if (strcmp("-quality", argv[i]) == 0 && i + 1 < argc) {
+            options.quality = atoi(argv[++i]);
+        }
+        else if (strcmp("-dct", argv[i]) == 0 && i + 1 < argc) {
+            const char *method = argv[++i];
+            if (strcmp(method, "exact") == 0) options.dct_method = DCT_METHOD_EXACT;
+            else if (strcmp(method, "float") == 0) options.dct_method = DCT_METHOD_FLOAT;
+            else if (strcmp(method, "int") == 0) options.dct_method = DCT_METHOD_ISLOW;
+            else if (strcmp(method, "fast") == 0) options.dct_method = DCT_METHOD_IFAST;
+            else printf("Warning: Unknown DCT method '%s', using 'float'.\n", method);
+        }
+        else if (strcmp("-isa", argv[i]) == 0 && i + 1 < argc) {
+            const char *isa = argv[++i];
+            if (strcmp(isa, "scalar") == 0) options.isa = SIMD_ISA_SCALAR;
+            else if (strcmp(isa, "sse4") == 0) options.isa = SIMD_ISA_SSE4;
+            else if (strcmp(isa, "avx2") == 0) options.isa = SIMD_ISA_AVX2;
+            else if (strcmp(isa, "auto") != 0) printf("Warning: Unknown instruction set '%s', using auto-detection.\n", isa);
+        }
+        else if (strcmp("-json", argv[i]) == 0 && i + 1 < argc) {
+            options.json_path = argv[++i];
+        }
+        else if (argv[i][0] == '-') {
+            printf("Warning: Unknown option '%s'.\n", argv[i]);
+        }
+        else {
+            add_corpus_input(&corpus, argv[i]);
+        }
+    }
+
+    if (corpus.count == 0) {
+        print_usage();
+        return -1;
+    }
+    if (options.iterations < 1) options.iterations = 1;
+    if (options.warmup < 0) options.warmup = 0;
+    if (options.quality < 1 || options.quality > 100) {
+        printf("Warning: Quality must be 1-100, using 50.\n");
+        options.quality = 50;
+    }
+
+    int to_stdout = options.json_path != NULL && strcmp(options.json_path, "-") == 0;
+    const KERNEL_TABLE *kernels = select_kernels(options.isa);
+    if (!to_stdout) {
+        printf("Using %s kernels, %s DCT, quality %d, %d iterations (+%d warmup) per image.\n", kernels->name,
+               dct_method_name(options.dct_method), options.quality, options.iterations, options.warmup);
+    }
+
+    IMAGE_RESULT *results = (IMAGE_RESULT*)calloc(corpus.count, sizeof(IMAGE_RESULT));
+    int result_count = 0;
+    int failed = 0;
+
+    for (int i = 0; i < corpus.count && results != NULL; i++) {
+        if (bench_image(corpus.paths[i], &options, kernels, &results[result_count]) != 0) {
+            printf("Warning: Skipping '%s'.\n", corpus.paths[i]);
+            failed = 1;
+            continue;
+        }
+        if (!to_stdout) {
+            print_image_report(&results[result_count]);
+        }
+        result_count++;
+    }
+
+    if (options.json_path != NULL && results != NULL) {
+        FILE *f = to_stdout ? stdout : fopen(options.json_path, "w");
+        if (f == NULL) {
+            printf("Error: Cannot open '%s'.\n", options.json_path);
+            failed = 1;
+        } else {
+            write_json(f, &options, kernels, results, result_count);
+            if (!to_stdout) {
+                fclose(f);
+                printf("\nResults written to %s.\n", options.json_path);
+            }
+        }
+    }
+
+    for (int i = 0; i < corpus.count; i++) {
+        free(corpus.paths[i]);
+    }
+    free(results);
+    return failed || result_count == 0 ? -1 : 0;
+}
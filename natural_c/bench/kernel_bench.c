@@ -0,0 +1,523 @@
+#include "bench_stats.h"
+#include "dct.h"
+#include "simd.h"
+#include "entropy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* kernel_bench - isolated timing of the encoder kernels.
+* Every kernel runs over a small pool of blocks that stays in L1/L2 cache, so the numbers
+* exclude I/O, allocation and memory bandwidth. Inputs are generated once from a fixed seed;
+* quantized inputs have a controllable fraction of zero AC coefficients (-sparsity), which
+* drives the cost of zigzag-order entropy coding. Each implementation of a kernel (reference,
+* scalar, SSE4, AVX2) is measured the same way and compared against the first one listed.
+*
+* Usage: kernel_bench [options]
+*/
+
+#define MAX_SAMPLES 1001
+#define MAX_ATTEMPTS 3
+
+// Samples are taken again when (p95 - p50) / p50 exceeds this
+#define STABLE_SPREAD 0.05
+
+typedef struct {
+    uint32_t pool_blocks;
+    double sparsity;            // fraction of AC coefficients that quantize to zero
+    int quality;
+    int samples;
+    uint32_t sample_us;         // minimum duration of one sample
+    uint32_t seed;
+    const char *filter;         // only kernels whose name contains this
+    const char *json_path;
+} KERNEL_BENCH_OPTIONS;
+
+/*
+* Inputs and outputs shared by all kernels, 'pool_blocks' blocks each.
+*/
+typedef struct {
+    uint32_t pool_blocks;
+    RGB *rgb;
+    uint8_t *bgr;
+    float *samples;             // centered pixel blocks (DCT input)
+    int16_t *samples_int;
+    float *coeffs;              // DCT coefficients that quantize to 'quantized'
+    int32_t *coeffs_int;        // the same for the integer (islow) quantizer
+    int16_t *quantized;         // row-major quantized blocks with the requested sparsity
+    int16_t *zigzagged;         // 'quantized' in zigzag order (entropy coder input)
+    float *out_f;
+    int32_t *out_i32;
+    int16_t *out_i16;
+    uint8_t *scan;
+    uint32_t scan_capacity;
+    uint32_t *codes;            // 64 (code, length) pairs per block for bw_write
+    uint8_t *lengths;
+    QUANT_TABLE qt;
+    INT_QUANT_TABLE int_qt;
+    uint64_t checksum;          // keeps results observable
+} KERNEL_DATA;
+
+typedef struct KERNEL_CASE {
+    const char *kernel;
+    const char *impl;
+    const KERNEL_TABLE *table;  // kernel set to take the function from, NULL for fixed functions
+    void (*run)(const struct KERNEL_CASE *c, KERNEL_DATA *d);   // one pass over the pool
+} KERNEL_CASE;
+
+typedef struct {
+    const KERNEL_CASE *c;
+    BENCH_STATS cycles;         // per block
+    double spread;
+    int stable;
+    double speedup;             // against the first implementation of the same kernel
+} KERNEL_RESULT;
+
+static uint32_t rng_state;
+
+static uint32_t next_random(void) {
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int random_range(int low, int high) {
+    return low + (int)(next_random() % (uint32_t)(high - low + 1));
+}
+
+// ---------------------------------------------------------------------------------------------
+// One pass of every kernel over the pool
+// ---------------------------------------------------------------------------------------------
+
+static void run_rgb_to_y(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    c->table->rgb_to_y(d->rgb, d->out_f, d->pool_blocks * 64);
+}
+
+static void run_bgr_to_y(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    c->table->bgr_to_y(d->bgr, d->out_f, d->pool_blocks * 64);
+}
+
+static void run_dct_exact(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    (void)c;
+    for (uint32_t b = 0; b < d->pool_blocks; b++) {
+        perform_dct_one_block(&d->samples[b * 64], &d->out_f[b * 64]);
+    }
+}
+
+static void run_dct_float(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    for (uint32_t b = 0; b < d->pool_blocks; b++) {
+        c->table->dct_float(&d->samples[b * 64], &d->out_f[b * 64]);
+    }
+}
+
+static void run_dct_islow(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    (void)c;
+    for (uint32_t b = 0; b < d->pool_blocks; b++) {
+        perform_dct_one_block_islow(&d->samples_int[b * 64], &d->out_i32[b * 64]);
+    }
+}
+
+static void run_dct_ifast(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    (void)c;
+    for (uint32_t b = 0; b < d->pool_blocks; b++) {
+        perform_dct_one_block_ifast(&d->samples_int[b * 64], &d->out_i32[b * 64]);
+    }
+}
+
+static void run_quantize(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    for (uint32_t b = 0; b < d->pool_blocks; b++) {
+        c->table->quantize(&d->coeffs[b * 64], &d->qt, &d->out_i16[b * 64]);
+    }
+}
+
+static void run_quantize_int(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    for (uint32_t b = 0; b < d->pool_blocks; b++) {
+        c->table->quantize_int(&d->coeffs_int[b * 64], &d->int_qt, &d->out_i16[b * 64]);
+    }
+}
+
+static void run_zigzag(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    for (uint32_t b = 0; b < d->pool_blocks; b++) {
+        c->table->zigzag(&d->quantized[b * 64], &d->out_i16[b * 64]);
+    }
+}
+
+static void run_encode_coefficients(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    (void)c;
+    BitWriter bw;
+    bw_init(&bw, d->scan, d->scan_capacity);
+
+    int16_t prev_dc = 0;
+    for (uint32_t b = 0; b < d->pool_blocks; b++) {
+        prev_dc = encode_coefficients(&d->zigzagged[b * 64], prev_dc, &std_lum_huffman, &bw);
+    }
+    bw_flush(&bw);
+    d->checksum += bw.byte_pos;
+}
+
+static void run_bw_write(const KERNEL_CASE *c, KERNEL_DATA *d) {
+    (void)c;
+    BitWriter bw;
+    bw_init(&bw, d->scan, d->scan_capacity);
+
+    for (uint32_t i = 0; i < d->pool_blocks * 64; i++) {
+        bw_write(&bw, d->codes[i], d->lengths[i]);
+    }
+    bw_flush(&bw);
+    d->checksum += bw.byte_pos;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Inputs
+// ---------------------------------------------------------------------------------------------
+
+static void free_kernel_data(KERNEL_DATA *d) {
+    free(d->rgb);
+    free(d->bgr);
+    free(d->samples);
+    free(d->samples_int);
+    free(d->coeffs);
+    free(d->coeffs_int);
+    free(d->quantized);
+    free(d->zigzagged);
+    free(d->out_f);
+    free(d->out_i32);
+    free(d->out_i16);
+    free(d->scan);
+    free(d->codes);
+    free(d->lengths);
+}
+
+/*
+* Magnitude of a nonzero quantized AC coefficient: mostly small, occasionally large,
+* like the coefficients of natural images.
+*/
+static int random_ac_magnitude(void) {
+    int magnitude = 1;
+    while (magnitude < 512 && next_random() % 3 == 0) {
+        magnitude *= 2;
+    }
+    return random_range(magnitude, magnitude * 2 - 1);
+}
+
+static int init_kernel_data(KERNEL_DATA *d, const KERNEL_BENCH_OPTIONS *options) {
+    uint32_t n = options->pool_blocks;
+    size_t values = (size_t)n * 64;
+
+    memset(d, 0, sizeof(*d));
+    d->pool_blocks = n;
+    d->scan_capacity = n * ENTROPY_MAX_BLOCK_BYTES + BW_MIN_CAPACITY;
+
+    d->rgb = (RGB*)malloc(values * sizeof(RGB));
+    d->bgr = (uint8_t*)malloc(values * 3);
+    d->samples = (float*)malloc(values * sizeof(float));
+    d->samples_int = (int16_t*)malloc(values * sizeof(int16_t));
+    d->coeffs = (float*)malloc(values * sizeof(float));
+    d->coeffs_int = (int32_t*)malloc(values * sizeof(int32_t));
+    d->quantized = (int16_t*)malloc(values * sizeof(int16_t));
+    d->zigzagged = (int16_t*)malloc(values * sizeof(int16_t));
+    d->out_f = (float*)malloc(values * sizeof(float));
+    d->out_i32 = (int32_t*)malloc(values * sizeof(int32_t));
+    d->out_i16 = (int16_t*)malloc(values * sizeof(int16_t));
+    d->scan = (uint8_t*)malloc(d->scan_capacity);
+    d->codes = (uint32_t*)malloc(values * sizeof(uint32_t));
+    d->lengths = (uint8_t*)malloc(values);
+
+    if (!d->rgb || !d->bgr || !d->samples || !d->samples_int || !d->coeffs || !d->coeffs_int ||
+        !d->quantized || !d->zigzagged || !d->out_f || !d->out_i32 || !d->out_i16 || !d->scan ||
+        !d->codes || !d->lengths) {
+        printf("Error: Not enough memory for the kernel inputs.\n");
+        free_kernel_data(d);
+        return -1;
+    }
+
+    rng_state = options->seed ? options->seed : 1;
+    init_quant_table(&d->qt, options->quality);
+    init_int_quant_table(&d->int_qt, d->qt.natural, DCT_METHOD_ISLOW);
+
+    // Pixels
+    for (size_t i = 0; i < values; i++) {
+        uint32_t r = next_random();
+        d->rgb[i].r = (uint8_t)r;
+        d->rgb[i].g = (uint8_t)(r >> 8);
+        d->rgb[i].b = (uint8_t)(r >> 16);
+        d->bgr[3 * i] = d->rgb[i].b;
+        d->bgr[3 * i + 1] = d->rgb[i].g;
+        d->bgr[3 * i + 2] = d->rgb[i].r;
+
+        int sample = (int)(uint8_t)(r >> 24) - 128;
+        d->samples[i] = (float)sample;
+        d->samples_int[i] = (int16_t)sample;
+    }
+
+    // Quantized blocks with the requested share of zero AC coefficients, and DCT coefficients
+    // that quantize to them (offset by less than half a step)
+    uint32_t zero_threshold = (uint32_t)(options->sparsity * 1000000.0);
+    for (uint32_t b = 0; b < n; b++) {
+        int16_t *q = &d->quantized[b * 64];
+
+        q[0] = (int16_t)random_range(-120, 120);
+        for (int i = 1; i < 64; i++) {
+            if (next_random() % 1000000 < zero_threshold) {
+                q[i] = 0;
+            } else {
+                int magnitude = random_ac_magnitude();
+                q[i] = (int16_t)(next_random() & 1 ? magnitude : -magnitude);
+            }
+        }
+
+        for (int i = 0; i < 64; i++) {
+            float jitter = (float)random_range(-40, 40) / 100.0f;
+            d->coeffs[b * 64 + i] = ((float)q[i] + jitter) * d->qt.divisor[i];
+            d->coeffs_int[b * 64 + i] = (int32_t)(((float)q[i] + jitter) * d->int_qt.divisor[i]);
+        }
+
+        zigzag_order(q, &d->zigzagged[b * 64]);
+    }
+
+    // Huffman-like codes: short codes are the most frequent
+    for (size_t i = 0; i < values; i++) {
+        int length = random_range(1, 4) + (next_random() % 4 == 0 ? random_range(0, 12) : 0);
+        d->lengths[i] = (uint8_t)length;
+        d->codes[i] = next_random() & ((1u << length) - 1);
+    }
+
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Measurement
+// ---------------------------------------------------------------------------------------------
+
+/*
+* Takes options->samples samples of one kernel. A sample runs as many passes over the pool as
+* fit in options->sample_us (calibrated after a warmup pass).
+*/
+static void measure_case(const KERNEL_CASE *c, KERNEL_DATA *d, const KERNEL_BENCH_OPTIONS *options,
+                         double *samples, BENCH_STATS *stats) {
+    // Warmup, then calibrate the passes per sample
+    c->run(c, d);
+    uint32_t passes = 1;
+    for (;;) {
+        uint64_t start = bench_now_ns();
+        for (uint32_t p = 0; p < passes; p++) {
+            c->run(c, d);
+        }
+        uint64_t elapsed = bench_now_ns() - start;
+        if (elapsed >= (uint64_t)options->sample_us * 1000 || passes >= (1u << 24)) break;
+        passes *= 2;
+    }
+
+    for (int s = 0; s < options->samples; s++) {
+        uint64_t start = bench_cycles();
+        for (uint32_t p = 0; p < passes; p++) {
+            c->run(c, d);
+        }
+        uint64_t elapsed = bench_cycles() - start;
+        samples[s] = (double)elapsed / ((double)passes * d->pool_blocks);
+    }
+
+    bench_compute_stats(samples, (uint32_t)options->samples, stats);
+}
+
+/*
+* Measures a kernel until its samples are stable (or MAX_ATTEMPTS), keeping the tightest run.
+*/
+static void bench_case(const KERNEL_CASE *c, KERNEL_DATA *d, const KERNEL_BENCH_OPTIONS *options,
+                       double *samples, KERNEL_RESULT *result) {
+    result->c = c;
+    result->spread = -1.0;
+
+    for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+        BENCH_STATS stats;
+        measure_case(c, d, options, samples, &stats);
+
+        double spread = stats.p50 > 0.0 ? (stats.p95 - stats.p50) / stats.p50 : 0.0;
+        if (result->spread < 0.0 || spread < result->spread) {
+            result->cycles = stats;
+            result->spread = spread;
+        }
+        if (result->spread <= STABLE_SPREAD) break;
+    }
+    result->stable = result->spread <= STABLE_SPREAD;
+}
+
+/*
+* Lists every kernel implementation available on this CPU, grouped by kernel.
+* The first entry of a group is the baseline of its comparison.
+*/
+static int build_cases(KERNEL_CASE *cases) {
+    const KERNEL_TABLE *tables[3];
+    int table_count = 0;
+    int n = 0;
+
+    SIMD_ISA isas[3] = { SIMD_ISA_SCALAR, SIMD_ISA_SSE4, SIMD_ISA_AVX2 };
+    for (int i = 0; i < 3; i++) {
+        const KERNEL_TABLE *table = get_kernel_table(isas[i]);
+        if (table != NULL) tables[table_count++] = table;
+    }
+
+    #define ADD_CASE(kernel, impl, table, run) \
+        do { KERNEL_CASE c = { kernel, impl, table, run }; cases[n++] = c; } while (0)
+
+    for (int t = 0; t < table_count; t++) ADD_CASE("rgb_to_y", tables[t]->name, tables[t], run_rgb_to_y);
+    for (int t = 0; t < table_count; t++) ADD_CASE("bgr_to_y", tables[t]->name, tables[t], run_bgr_to_y);
+
+    ADD_CASE("dct", "exact", NULL, run_dct_exact);
+    for (int t = 0; t < table_count; t++) ADD_CASE("dct", tables[t]->name, tables[t], run_dct_float);
+    ADD_CASE("dct", "islow", NULL, run_dct_islow);
+    ADD_CASE("dct", "ifast", NULL, run_dct_ifast);
+
+    for (int t = 0; t < table_count; t++) ADD_CASE("quantize", tables[t]->name, tables[t], run_quantize);
+    for (int t = 0; t < table_count; t++) ADD_CASE("quantize_int", tables[t]->name, tables[t], run_quantize_int);
+    for (int t = 0; t < table_count; t++) ADD_CASE("zigzag", tables[t]->name, tables[t], run_zigzag);
+
+    ADD_CASE("encode_coefficients", "std tables", NULL, run_encode_coefficients);
+    ADD_CASE("bw_write", "64 codes", NULL, run_bw_write);
+
+    #undef ADD_CASE
+    return n;
+}
+
+static void write_json(FILE *f, const KERNEL_BENCH_OPTIONS *options, double cycles_per_ns,
+                       const KERNEL_RESULT *results, int count) {
+    fprintf(f, "{\n  \"benchmark\": \"kernel_bench\",\n  \"unit\": \"%s\",\n", BENCH_CYCLE_UNIT);
+    fprintf(f, "  \"cycles_per_ns\": %.4f,\n  \"pool_blocks\": %u,\n  \"sparsity\": %.3f,\n",
+            cycles_per_ns, options->pool_blocks, options->sparsity);
+    fprintf(f, "  \"quality\": %d,\n  \"samples\": %d,\n  \"seed\": %u,\n  \"kernels\": [",
+            options->quality, options->samples, options->seed);
+
+    for (int i = 0; i < count; i++) {
+        const KERNEL_RESULT *r = &results[i];
+        fprintf(f, "%s\n    {\"kernel\": ", i ? "," : "");
+        bench_json_string(f, r->c->kernel);
+        fprintf(f, ", \"impl\": ");
+        bench_json_string(f, r->c->impl);
+        fprintf(f, ", \"per_block\": ");
+        bench_json_stats(f, &r->cycles);
+        fprintf(f, ", \"ns_per_block\": %.3f, \"spread\": %.4f, \"stable\": %s, \"speedup\": %.3f}",
+                r->cycles.p50 / cycles_per_ns, r->spread, r->stable ? "true" : "false", r->speedup);
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+static void print_usage(void) {
+    printf("Usage: kernel_bench [options]\n");
+    printf("  -blocks N         blocks in the input pool (default 64, cache resident)\n");
+    printf("  -sparsity F       fraction of zero AC coefficients, 0-1 (default 0.85)\n");
+    printf("  -quality Q        quantization tables, 1-100 (default 50)\n");
+    printf("  -samples N        samples per kernel (default 25)\n");
+    printf("  -sample-us N      minimum duration of a sample in microseconds (default 200)\n");
+    printf("  -seed N           input generator seed (default 1)\n");
+    printf("  -filter NAME      only kernels whose name contains NAME\n");
+    printf("  -json PATH        also write the results as JSON ('-' = stdout only)\n");
+}
+
+int main(int argc, char *argv[]) {
+    KERNEL_BENCH_OPTIONS options = { 64, 0.85, 50, 25, 200, 1, NULL, NULL };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp("-blocks", argv[i]) == 0 && i + 1 < argc) {
+            options.pool_blocks = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp("-sparsity", argv[i]) == 0 && i + 1 < argc) {
+            options.sparsity = atof(argv[++i]);
+        }
+        else if (strcmp("-quality", argv[i]) == 0 && i + 1 < argc) {
+            options.quality = atoi(argv[++i]);
+        }
+        else if (strcmp("-samples", argv[i]) == 0 && i + 1 < argc) {
+            options.samples = atoi(argv[++i]);
+        }
+        else if (strcmp("-sample-us", argv[i]) == 0 && i + 1 < argc) {
+            options.sample_us = (uint32_t)atoi(argv[++i]);
+        }
+        else if (strcmp("-seed", argv[i]) == 0 && i + 1 < argc) {
+            options.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp("-filter", argv[i]) == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        }
+        else if (strcmp("-json", argv[i]) == 0 && i + 1 < argc) {
+            options.json_path = argv[++i];
+        }
+        else {
+            print_usage();
+            return -1;
+        }
+    }
+
+    if (options.pool_blocks < 1) options.pool_blocks = 1;
+    if (options.sparsity < 0.0) options.sparsity = 0.0;
+    if (options.sparsity > 1.0) options.sparsity = 1.0;
+    if (options.samples < 1) options.samples = 1;
+    if (options.samples > MAX_SAMPLES) options.samples = MAX_SAMPLES;
+    if (options.quality < 1 || options.quality > 100) {
+        printf("Warning: Quality must be 1-100, using 50.\n");
+        options.quality = 50;
+    }
+
+    KERNEL_DATA data;
+    if (init_kernel_data(&data, &options) != 0) {
+        return -1;
+    }
+
+    int to_stdout = options.json_path != NULL && strcmp(options.json_path, "-") == 0;
+    double cycles_per_ns = bench_cycles_per_ns();
+
+    KERNEL_CASE cases[32];
+    KERNEL_RESULT results[32];
+    double samples[MAX_SAMPLES];
+    int case_count = build_cases(cases);
+    int result_count = 0;
+
+    if (!to_stdout) {
+        printf("%u blocks per pass, %.0f%% zero AC coefficients, quality %d, %d samples of >= %u us, %.2f %s/ns.\n\n",
+               options.pool_blocks, options.sparsity * 100.0, options.quality, options.samples,
+               options.sample_us, cycles_per_ns, BENCH_CYCLE_UNIT);
+        printf("%-20s %-11s %12s %10s %10s %8s %8s\n", "KERNEL", "IMPL", BENCH_CYCLE_UNIT "/BLK p50", "min", "p95",
+               "spread", "vs 1st");
+    }
+
+    const char *group = NULL;
+    double baseline = 0.0;
+    for (int i = 0; i < case_count; i++) {
+        if (options.filter != NULL && strstr(cases[i].kernel, options.filter) == NULL) continue;
+
+        KERNEL_RESULT *r = &results[result_count++];
+        bench_case(&cases[i], &data, &options, samples, r);
+
+        if (group == NULL || strcmp(group, cases[i].kernel) != 0) {
+            group = cases[i].kernel;
+            baseline = r->cycles.p50;
+        }
+        r->speedup = r->cycles.p50 > 0.0 ? baseline / r->cycles.p50 : 0.0;
+
+        if (!to_stdout) {
+            printf("%-20s %-11s %12.1f %10.1f %10.1f %7.1f%% %7.2fx%s\n", r->c->kernel, r->c->impl, r->cycles.p50,
+                   r->cycles.min, r->cycles.p95, r->spread * 100.0, r->speedup, r->stable ? "" : "  unstable");
+        }
+    }
+
+    if (options.json_path != NULL) {
+        FILE *f = to_stdout ? stdout : fopen(options.json_path, "w");
+        if (f == NULL) {
+            printf("Error: Cannot open '%s'.\n", options.json_path);
+        } else {
+            write_json(f, &options, cycles_per_ns, results, result_count);
+            if (!to_stdout) {
+                fclose(f);
+                printf("\nResults written to %s.\n", options.json_path);
+            }
+        }
+    }
+
+    // Results are consumed so the compiler cannot drop any pass
+    if (data.checksum == 1) printf(" ");
+
+    free_kernel_data(&data);
+    return 0;
+}
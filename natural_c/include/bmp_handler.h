@@ -2,6 +2,9 @@
 #define BMP_HANDLER_H
 
 #include <stdint.h> 
+#include "dct.h"
+#include "simd.h"
+#include "pipeline.h"
 
 // Ensure no padding in structures, because no padding is used in BMP file format
 #pragma pack(push, 1) 
@@ -36,9 +39,68 @@ typedef struct {
     unsigned char *buffer; 
 } BMP_IMAGE;
 
+/*
+* How the BMP pixel array is read.
+* INPUT_LOAD reads it into memory, INPUT_STREAM reads 8-row strips on a reader thread,
+* INPUT_MMAP maps the file. Both streaming modes imply the fused pipeline.
+*/
+typedef enum {
+    INPUT_LOAD = 0,
+    INPUT_STREAM,
+    INPUT_MMAP
+} INPUT_MODE;
+
+/*
+* Input file format.
+* INPUT_FORMAT_BMP is a 24-bit BMP. The others are raw YUV frames encoded without color conversion:
+* I420 (Y, U, V planes, 4:2:0), NV12 (Y plane, interleaved UV plane, 4:2:0), YUYV (packed 4:2:2)
+* and Y4M (YUV4MPEG2 stream, 4:2:0, 4:2:2, 4:4:4 or mono).
+*/
+typedef enum {
+    INPUT_FORMAT_BMP = 0,
+    INPUT_FORMAT_I420,
+    INPUT_FORMAT_NV12,
+    INPUT_FORMAT_YUYV,
+    INPUT_FORMAT_Y4M
+} INPUT_FORMAT;
+
+/*
+* Output file layout.
+* OUTPUT_JPEG writes one JFIF file. The MJPEG layouts encode every frame of the input sequence
+* into one stream: back-to-back JPEG files, or an AVI container with an MJPG video stream.
+*/
+typedef enum {
+    OUTPUT_JPEG = 0,
+    OUTPUT_MJPEG_CONCAT,
+    OUTPUT_MJPEG_AVI
+} OUTPUT_CONTAINER;
+
+// Maximum number of -variant outputs
+#define MAX_VARIANTS 16
+
 typedef struct {
     char* inputFile;
     char* outputFile;
+    DCT_METHOD dct_method;
+    SIMD_ISA isa;
+    PIPELINE_MODE pipeline;
+    INPUT_MODE input_mode;
+    uint32_t restart_interval;  // blocks per restart interval, 0 = no restart markers
+    int threads;                // worker threads for quantization and entropy coding
+    int optimize_huffman;       // 1 = two-pass coding with per-image Huffman tables
+    int quality;                // quantization table quality factor, 1-100 (50 = standard table)
+    uint32_t target_size;       // file size budget in bytes, 0 = use 'quality'
+    int variant_count;          // number of -variant outputs, 0 = single output
+    int variant_quality[MAX_VARIANTS];
+    char* variant_output[MAX_VARIANTS];
+    COLOR_MODE color_mode;      // grayscale or YCbCr with the given chroma subsampling
+    INPUT_FORMAT input_format;
+    uint32_t input_width;       // frame size of raw YUV input (-size)
+    uint32_t input_height;
+    OUTPUT_CONTAINER container;
+    uint32_t max_frames;        // frames to encode in MJPEG mode, 0 = all
+    uint32_t fps;               // frame rate written to AVI headers, 0 = from the input (Y4M) or 25
+    int quality_metrics;        // 1 = report luminance PSNR and block-SSIM of the coded image
 } PARAMETERS;
 
 BMP_IMAGE load_bmp_image(const char* inputFile);
@@ -0,0 +1,97 @@
+#ifndef BMP_STREAM_H
+#define BMP_STREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "bmp_handler.h"
+#include "pipeline.h"
+
+/*
+* Strip-based streaming BMP reader.
+* Pulls one MCU row (8 scanlines) at a time instead of loading the whole pixel array,
+* so memory use does not depend on image height. A reader thread fills the next strip
+* while the encoder works on the current one (double buffering).
+*/
+
+#define BMP_STRIP_ROWS 8
+
+typedef struct {
+    uint8_t *data;              // BMP_STRIP_ROWS * row_stride bytes
+    uint32_t rows;              // scanlines actually read (last strip may be shorter)
+    int64_t strip;              // strip index held in this slot, -1 if none
+    int full;                   // 1 when filled by the reader and not yet released by the encoder
+} BMP_STRIP_SLOT;
+
+typedef struct {
+    FILE *file;
+    BMP_FILE_HEADER header;
+    BMP_INFO info;
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_stride;
+    int bottom_up;
+    uint32_t strip_count;
+
+    BMP_STRIP_SLOT slots[2];
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int reader_started;
+    int stop;
+    int error;
+    uint32_t next_strip;        // strips handed to the encoder so far
+} BMP_STRIP_READER;
+
+/*
+* Opens a 24-bit BMP for strip reading and starts the reader thread.
+* Returns 0 on success, -1 on error (reader is left closed).
+*/
+int bmp_strip_open(BMP_STRIP_READER *reader, const char *inputFile);
+
+/*
+* Stops the reader thread and releases all resources.
+*/
+void bmp_strip_close(BMP_STRIP_READER *reader);
+
+/*
+* Initializes a fused-pipeline row source over an open strip reader.
+* Strips must be requested in increasing order; requesting strip k releases strip k - 1.
+* The current strip can be requested again, any other out-of-order request fails.
+*/
+void init_bmp_strip_source(ROW_SOURCE *source, BMP_STRIP_READER *reader);
+
+/*
+* Memory-mapped BMP input.
+* The file is mapped read-only and the fused pipeline reads BGR bytes straight from the mapping,
+* so neither the pixel payload nor a float RGB copy is ever materialized.
+*/
+typedef struct {
+    void *mapping;
+    size_t mapping_size;
+    BMP_FILE_HEADER header;
+    BMP_INFO info;
+    uint32_t width;
+    uint32_t height;
+    const uint8_t *pixels;      // start of the pixel array inside the mapping
+    int bottom_up;
+    BMP_MEMORY_SOURCE rows;     // row addressing state used by the row source
+} BMP_MAPPED_IMAGE;
+
+/*
+* Maps a 24-bit BMP and advises the kernel about sequential access (and transparent huge pages where available).
+* Returns 0 on success, -1 on error.
+*/
+int bmp_mmap_open(BMP_MAPPED_IMAGE *image, const char *inputFile);
+
+/*
+* Unmaps the image.
+*/
+void bmp_mmap_close(BMP_MAPPED_IMAGE *image);
+
+/*
+* Initializes a fused-pipeline row source reading directly from the mapping.
+*/
+void init_bmp_mmap_source(ROW_SOURCE *source, BMP_MAPPED_IMAGE *image);
+
+#endif
@@ -19,6 +19,21 @@ typedef struct {
     float cr;
 } YCbCr;
 
+/*
+* Output color mode.
+* COLOR_MODE_GRAY encodes luminance only. The others encode YCbCr with interleaved MCUs
+* and chroma subsampled by the given ratio:
+*   444 - full resolution chroma, MCU = 1 Y + Cb + Cr block (8x8 pixels)
+*   422 - chroma halved horizontally, MCU = 2 Y + Cb + Cr blocks (16x8 pixels)
+*   420 - chroma halved in both directions, MCU = 4 Y + Cb + Cr blocks (16x16 pixels)
+*/
+typedef enum {
+    COLOR_MODE_GRAY = 0,
+    COLOR_MODE_444,
+    COLOR_MODE_422,
+    COLOR_MODE_420
+} COLOR_MODE;
+
 /*
 * Constructs RGB array from pixel data.
 * orientation - defines reading orientation. Values:
@@ -31,4 +46,27 @@ RGB* read_pixels(uint8_t* pixel_data, uint32_t width, uint32_t height, int orien
 
 YCbCr* rgb_to_ycbcr(RGB* pixels, uint32_t width, uint32_t height);
 
+/*
+* Returns the luminance sampling factors of a color mode (chroma is always sampled 1x1),
+* i.e. how many Y blocks an MCU spans horizontally and vertically.
+*/
+uint32_t color_mode_h_factor(COLOR_MODE mode);
+uint32_t color_mode_v_factor(COLOR_MODE mode);
+
+/*
+* Returns the command line name of a color mode ("gray", "444", "422", "420").
+*/
+const char* color_mode_name(COLOR_MODE mode);
+
+/*
+* Converts one row of packed BGR bytes to centered Cb and Cr (BT.601, minus 128), downsampling
+* horizontally on the way: each output sample is the sum of 'h_factor' neighbouring pixels
+* times 'weight'. Pixels past 'width' repeat the last one (edge padding).
+* Input: BGR row, image width, number of chroma samples to produce, horizontal factor
+* Input: weight applied to every sum (1 / (h_factor * v_factor) averages a whole MCU cell)
+* Input: accumulate - 0 stores the result, 1 adds it to cb/cr (vertical downsampling)
+*/
+void bgr_to_cbcr_row(const uint8_t *bgr, uint32_t width, uint32_t count, uint32_t h_factor,
+                     float weight, int accumulate, float *cb, float *cr);
+
 #endif
@@ -2,21 +2,93 @@
 #define DCT_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define PI 3.14159265358979323846f
 
+/*
+* Selects the forward DCT implementation.
+* DCT_METHOD_EXACT is the direct cosine sum kept as the golden reference.
+* DCT_METHOD_FLOAT is the separable AAN transform (rows, then columns) with precomputed constants.
+* DCT_METHOD_ISLOW is the accurate integer transform (libjpeg "islow" style, 13-bit fixed point).
+* DCT_METHOD_IFAST is the fast integer AAN transform (libjpeg "ifast" style, 8-bit fixed point).
+*/
+typedef enum {
+    DCT_METHOD_EXACT = 0,
+    DCT_METHOD_FLOAT,
+    DCT_METHOD_ISLOW,
+    DCT_METHOD_IFAST
+} DCT_METHOD;
+
+/*
+* Integer quantization table for the integer DCT methods.
+* Divisors include the output scaling of the integer DCT, and division is replaced by
+* multiplication with a fixed-point reciprocal: q = ((|x| + bias) * recip) >> shift.
+*/
+typedef struct {
+    uint16_t divisor[64];   // Quantization step in integer DCT units
+    uint16_t bias[64];      // divisor / 2, rounds to the nearest integer
+    uint32_t recip[64];     // ceil(2^shift / divisor)
+    uint8_t shift[64];      // 16 + floor(log2(divisor))
+} INT_QUANT_TABLE;
+
+/*
+* Quantization table generated at encoder init for a quality factor.
+*/
+typedef struct {
+    uint8_t natural[64];    // row-major values, 1-255 (baseline)
+    uint8_t zigzag[64];     // the same values in zigzag order, as written to DQT
+    float divisor[64];      // row-major values as float, used by the float quantizers
+} QUANT_TABLE;
+
 /* DCT function declarations */
 
+struct BitWriter;
+
 /*
-* Structure for handling bit-level writing.
+* Smallest buffer a BitWriter can work with: one 32-bit word with every byte stuffed, twice.
+*/
+#define BW_MIN_CAPACITY 16
+
+/*
+* Destination behind a BitWriter's buffer (file, socket, growable memory, ...).
+* 'drain' is called when fewer than 'needed' bytes are free in the buffer, and with 'needed' = 0 by
+* bw_finish. It either hands the buffered bytes on (adding byte_pos to drained, resetting byte_pos,
+* possibly switching to a new buffer) or grows the buffer, and returns 0; -1 if it cannot.
 */
 typedef struct {
+    void *ctx;
+    int (*drain)(void *ctx, struct BitWriter *bw, uint32_t needed);
+} BW_SINK;
+
+/*
+* Structure for handling bit-level writing.
+* Writes are bounds checked: when the buffer runs short the sink makes room. Without a sink, or when
+* the sink fails, the buffered bytes are dropped and 'failed' is set, so nothing is written past the
+* buffer and the byte count stays exact.
+*/
+typedef struct BitWriter {
     uint8_t *buffer;    // Buffer in which we write encoded coefficients
     uint32_t byte_pos;  // Current byte in the buffer
-    uint32_t bit_pos;   // Current bit position in the current byte (0-7)
-    uint8_t current;    // Current byte being constructed
+    uint32_t capacity;  // Size of the buffer in bytes
+    uint32_t bit_pos;   // Number of pending bits in the accumulator (0-31 between writes)
+    uint64_t current;   // Bit accumulator, pending bits are left-aligned (MSB first)
+    int stuffing;       // 1 = insert 0x00 after every 0xFF byte (JPEG scan data), 0 = raw bits
+    int failed;         // 1 once bytes were dropped (fixed buffer full or sink error)
+    uint64_t drained;   // Bytes handed to the sink (or dropped) before the buffer was reused
+    const BW_SINK *sink;    // Makes room when the buffer is full, NULL = fixed buffer
+    uint8_t spill[BW_MIN_CAPACITY];     // Write target once output is being dropped into a too small buffer
 } BitWriter;
 
+/*
+* Dry-run BitWriter: tracks the bytes a stuffing BitWriter would produce without storing them.
+*/
+typedef struct {
+    uint64_t bytes;     // Bytes that would have been written, stuffing included
+    uint32_t bit_pos;   // Number of pending bits in the accumulator
+    uint64_t current;   // Bit accumulator, pending bits are left-aligned (MSB first)
+} BitCounter;
+
 /*
 *  Structure representing a Huffman code.
 */
@@ -25,6 +97,25 @@ typedef struct {
     uint8_t len;        // Length of the code in bits
 } HuffmanCode;
 
+/*
+* Huffman table in DHT form (ISO/IEC 10918-1, B.2.4.2).
+*/
+typedef struct {
+    uint8_t bits[16];   // number of codes of each length 1-16
+    uint8_t vals[256];  // symbols in order of increasing code length
+    uint16_t count;     // number of symbols (sum of bits)
+} HUFFMAN_SPEC;
+
+/*
+* Huffman tables used for one scan: code lookup tables plus the DHT form written to the file.
+*/
+typedef struct {
+    const HuffmanCode *dc;          // 16 entries, indexed by DC category
+    const HuffmanCode *ac;          // 256 entries, indexed by (run << 4) | size
+    const HUFFMAN_SPEC *dc_spec;
+    const HUFFMAN_SPEC *ac_spec;
+} HUFFMAN_TABLES;
+
 /*
 * Structure representing a Variable Length Integer.
 * Used for encoding non-zero DCT coefficients.
@@ -38,12 +129,35 @@ typedef struct {
 /* Huffman tables */
 extern const HuffmanCode huff_dc_lum[16];   // DC table
 extern const HuffmanCode huff_ac_lum[256];  // AC table
+extern const HUFFMAN_SPEC std_dc_lum_spec;  // DC table, DHT form
+extern const HUFFMAN_SPEC std_ac_lum_spec;  // AC table, DHT form
+extern const HUFFMAN_TABLES std_lum_huffman; // Annex K luminance tables
+extern const HuffmanCode huff_dc_chrom[16];     // DC table
+extern const HuffmanCode huff_ac_chrom[256];    // AC table
+extern const HUFFMAN_SPEC std_dc_chrom_spec;    // DC table, DHT form
+extern const HUFFMAN_SPEC std_ac_chrom_spec;    // AC table, DHT form
+extern const HUFFMAN_TABLES std_chrom_huffman;  // Annex K chrominance tables
 
 /* 
 * Standard Luminance quantization table.
 */
 extern const uint8_t std_lum_qt[64];
 
+/*
+* Standard Chrominance quantization table.
+*/
+extern const uint8_t std_chrom_qt[64];
+
+/*
+* Zigzag position -> natural (row-major) index.
+*/
+extern const uint8_t zigzag_map[64];
+
+/*
+* AAN output descaling factors (row-major), 1 / (8 * s(u) * s(v)).
+*/
+extern const float aan_descale[64];
+
 /*
  * Centers the grayscale values around zero.
  * DCT works with cosine waves oscillating around zero.
@@ -66,18 +180,82 @@ void image_to_blocks(float *image, uint32_t width, uint32_t height, uint32_t *ou
     * Input: pointer to an array of blocks as returned by image_to_blocks
     * Input: number of blocks in width and height, 
     * Input: pointer to store the output DCT blocks.
+    * Input: DCT implementation to use.
     * Return value is stored in out_dct_blocks parameter which should be pre-allocated by the caller.
     */
-void perform_dct(float *blocks, uint32_t blocks_w, uint32_t blocks_h, float *out_dct_blocks);
+void perform_dct(float *blocks, uint32_t blocks_w, uint32_t blocks_h, float *out_dct_blocks, DCT_METHOD method);
 
 /*
     * Performs DCT on a single 8x8 block.
+    * Reference implementation - evaluates the DCT-II definition directly (4096 multiply-adds per block).
     * Input: pointer to an array of 64 floats (8x8 block).
     * Input: pointer to an array to store the DCT coefficients.
     * Return value is stored in out_dct_block parameter which should be pre-allocated by the caller.
     */
 void perform_dct_one_block(float *block, float *out_dct_block);
 
+/*
+    * Performs DCT on a single 8x8 block using the AAN (Arai, Agui, Nakajima) factorization.
+    * 1D transform is applied to rows, then to columns; AAN output scaling is removed at the end,
+    * so coefficients match perform_dct_one_block up to float rounding.
+    * Input: pointer to an array of 64 floats (8x8 block).
+    * Input: pointer to an array to store the DCT coefficients.
+    */
+void perform_dct_one_block_aan(const float *block, float *out_dct_block);
+
+/*
+    * Inverse of perform_dct_one_block: 8x8 DCT coefficients (row-major, unscaled) back to samples.
+    * Separable float transform, used to measure the reconstruction error of quantized blocks.
+    * Input: pointer to an array of 64 DCT coefficients.
+    * Input: pointer to an array to store the 64 samples (centered around zero, not rounded or clamped).
+    */
+void perform_idct_one_block(const float *dct_block, float *out_block);
+
+/*
+    * Performs integer DCT on all 8x8 blocks.
+    * Samples are rounded to int16 before the transform.
+    * Input: pointer to an array of blocks as returned by image_to_blocks
+    * Input: number of blocks in width and height
+    * Input: pointer to store the scaled integer DCT blocks (pre-allocated by the caller)
+    * Input: DCT_METHOD_ISLOW or DCT_METHOD_IFAST
+    */
+void perform_dct_int(float *blocks, uint32_t blocks_w, uint32_t blocks_h, int32_t *out_dct_blocks, DCT_METHOD method);
+
+/*
+    * Integer DCT on a single 8x8 block of centered samples.
+    * islow output is scaled up by 8, ifast output is scaled by 8 * s(u) * s(v) (AAN factors).
+    * Both scalings are removed by quantize_block_int with a table built for the same method.
+    */
+void perform_dct_one_block_islow(const int16_t *block, int32_t *out_dct_block);
+void perform_dct_one_block_ifast(const int16_t *block, int32_t *out_dct_block);
+
+/*
+    * Builds integer divisors and reciprocals from a quantization table (natural order).
+    * Input: table to fill
+    * Input: 64-entry quantization table
+    * Input: integer DCT method the coefficients will come from
+    */
+void init_int_quant_table(INT_QUANT_TABLE *table, const uint8_t *qt, DCT_METHOD method);
+
+/*
+    * Quantizes a scaled integer DCT block using reciprocal multiplication.
+    * Rounds to nearest with halves away from zero, matching quantize_block.
+    */
+void quantize_block_int(const int32_t *dct_block, const INT_QUANT_TABLE *table, int16_t *out_quantized_block);
+
+/*
+    * Builds a quantization table by scaling std_lum_qt for a quality factor (IJG convention):
+    * quality 50 gives the standard table, lower values scale it up, higher values down.
+    * Input: table to fill
+    * Input: quality 1-100 (clamped)
+    */
+void init_quant_table(QUANT_TABLE *table, int quality);
+
+/*
+    * Same as init_quant_table, scaling std_chrom_qt (Cb and Cr components).
+    */
+void init_chroma_quant_table(QUANT_TABLE *table, int quality);
+
 /*
     * Quantizes a DCT block.
     * Input: pointer to an array of DCT coefficients for a single block.
@@ -86,18 +264,41 @@ void perform_dct_one_block(float *block, float *out_dct_block);
     * Each coefficient is represented as int16_t, as Baseline JPEG standard requires.
     * Return value is stored in out_quantized_block parameter which should be pre-allocated by the caller.
     */
-void quantize_block(float *dct_block, int16_t* out_quantized_block);
+void quantize_block(float *dct_block, const QUANT_TABLE *qt, int16_t* out_quantized_block);
 
 /*
     * Encodes the DCT coefficients.
     * Input: pointer to an array of DCT coefficients for a single block. Coefficients need to be in zigzag order.
     * Input: pointer to an array to store the encoded data.
+    * Input: Huffman tables to code with
     * Input: pointer to a BitWriter (bit conitnuity is improtant for JFIF serialization)
     * Return value is stored in bw parameter which should be pre-allocated by the caller.
     * Returns the actual DC coefficient, so it can be used as 'prev_dc' for the next block.
     * Also outputs the size of the encoded data via out_data_size parameter.
     */
-int16_t encode_coefficients(int16_t *dct_block, int16_t prev_dc, BitWriter *bw);
+int16_t encode_coefficients(const int16_t *dct_block, int16_t prev_dc, const HUFFMAN_TABLES *tables, BitWriter *bw);
+
+/*
+    * Counts the Huffman symbols encode_coefficients would emit for a block.
+    * Input: block in zigzag order and the DC prediction
+    * Input: DC category histogram (16 entries) and AC symbol histogram (256 entries) to add to
+    * Returns the block's DC coefficient, like encode_coefficients.
+    */
+int16_t count_coefficient_symbols(const int16_t *dct_block, int16_t prev_dc, uint32_t *dc_freq, uint32_t *ac_freq);
+
+/*
+    * Dry run of encode_coefficients: advances the BitCounter by exactly what encode_coefficients
+    * would write to a stuffing BitWriter in the same state (0xFF stuffing included).
+    * Returns the block's DC coefficient, like encode_coefficients.
+    */
+int16_t dry_run_coefficients(const int16_t *dct_block, int16_t prev_dc, const HUFFMAN_TABLES *tables, BitCounter *bc);
+
+/*
+    * BitCounter counterparts of bw_init, bw_flush and bw_restart.
+    */
+void bc_init(BitCounter *bc);
+void bc_flush(BitCounter *bc);
+void bc_restart(BitCounter *bc);
 
 /*
     * Reorders the quantized DCT coefficients in zigzag order.
@@ -108,19 +309,72 @@ int16_t encode_coefficients(int16_t *dct_block, int16_t prev_dc, BitWriter *bw);
 void zigzag_order(const int16_t *input_block, int16_t *output_block);
 
 /*
-    * Writes a single byte to the BitWriter.
-    * It ensures byte stuffing is performed so JFIF decoder can distinguish markers from encoded values.
+    * Initializes a BitWriter over a caller-provided buffer of 'capacity' bytes (at least BW_MIN_CAPACITY).
+    * Output that does not fit is dropped and marks the writer as failed.
+    */
+void bw_init(BitWriter *bw, uint8_t *buffer, uint32_t capacity);
+
+/*
+    * Initializes a BitWriter that writes raw bits without byte stuffing.
+    * Used for intermediate bit buffers that are later re-emitted through a stuffing BitWriter.
+    */
+void bw_init_raw(BitWriter *bw, uint8_t *buffer, uint32_t capacity);
+
+/*
+    * Initializes a BitWriter whose buffer is provided and drained by a sink.
+    */
+void bw_init_sink(BitWriter *bw, const BW_SINK *sink);
+
+/*
+    * Makes sure 'bytes' bytes are free past the write position.
+    * Returns 0 on success, -1 if the room could not be made (the writer is marked as failed).
+    */
+int bw_reserve(BitWriter *bw, uint32_t bytes);
+
+/*
+    * Writes a single byte straight to the buffer, bypassing the accumulator.
+    * Only valid when no bits are pending (e.g. after bw_flush).
+    * Unless the writer is raw, it ensures byte stuffing is performed so JFIF decoder can distinguish markers from encoded values.
     */
 void bw_put_byte(BitWriter *bw, uint8_t val);
 
+/*
+    * Copies bytes verbatim (no stuffing), e.g. headers or scan pieces coded elsewhere.
+    * Only valid when no bits are pending.
+    */
+void bw_write_bytes(BitWriter *bw, const uint8_t *data, size_t length);
+
 /*
     * Writes a code to the BitWriter.
     * Input: pointer to a BitWriter struct.
     * Input: code to write.
-    * Input: length of the code in bits.
+    * Input: length of the code in bits (0-32).
     */
 void bw_write(BitWriter *bw, uint32_t code, int length);
 
+/*
+    * Writes out all pending bits; a partial last byte is padded with zeros.
+    */
+void bw_flush(BitWriter *bw);
+
+/*
+    * Flushes pending bits and lets the sink take the rest of the buffer.
+    * Returns 0 on success, -1 if any output was lost.
+    */
+int bw_finish(BitWriter *bw);
+
+/*
+    * Returns the number of bytes written so far, including those already drained.
+    */
+uint64_t bw_total_bytes(const BitWriter *bw);
+
+/*
+    * Ends a restart interval: pads pending bits to a byte boundary with 1-bits,
+    * then writes the marker RSTn with n = index % 8 (unstuffed).
+    * Input: index of the interval being closed (0 for the first one)
+    */
+void bw_restart(BitWriter *bw, uint32_t index);
+
 /*
     * Returns the VLI (Variable Length Integer) representation of a value.
     * Input: value to encode.
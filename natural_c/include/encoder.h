@@ -0,0 +1,73 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdint.h>
+#include "dct.h"
+#include "huffman.h"
+#include "entropy.h"
+#include "simd.h"
+#include "pipeline.h"
+
+/*
+* Stages of the staged (whole-image) pipeline.
+* The front half (color conversion, segmentation, DCT) is separate from the back half
+* (quantization, entropy coding), so one set of DCT coefficients can be re-quantized
+* for several quality factors.
+*/
+
+/*
+* DCT coefficients of a whole image, block after block in row-major block order.
+*/
+typedef struct {
+    DCT_METHOD method;
+    uint32_t blocks_w;
+    uint32_t blocks_h;
+    uint32_t block_count;
+    float *coeffs;          // exact and float methods
+    int32_t *coeffs_int;    // integer methods (scaled, see perform_dct_int)
+} DCT_COEFFICIENTS;
+
+/*
+* Back half settings shared by quantization, Huffman table selection and rate control.
+*/
+typedef struct {
+    uint32_t restart_interval;  // blocks per restart interval, 0 = no restart markers
+    int optimize_huffman;       // 1 = per-image Huffman tables (two-pass coding)
+    int threads;                // worker threads for quantization and entropy coding
+    ENTROPY_WORKSPACE *entropy; // scratch of the entropy coding threads, NULL = allocated per call
+} SCAN_SETTINGS;
+
+/*
+* Front half: BGR rows -> centered Y -> 8x8 blocks -> DCT, one MCU row at a time, so the only
+* image-sized state is the coefficients themselves.
+* Input: row source, image dimensions, DCT method, kernel set
+* Input: workspace of fused_workspace_size(width, COLOR_MODE_GRAY) bytes
+* Input: coefficients to fill; the caller provides 'coeffs' (exact and float methods) or
+*        'coeffs_int' (integer methods) with room for every block of the image
+* Returns 0 on success, -1 on error.
+*/
+int compute_dct_coefficients(const ROW_SOURCE *source, uint32_t width, uint32_t height, DCT_METHOD method,
+                             const KERNEL_TABLE *kernels, float *workspace, DCT_COEFFICIENTS *out);
+
+/*
+* Frees coefficient arrays the caller allocated with malloc.
+*/
+void free_dct_coefficients(DCT_COEFFICIENTS *coeffs);
+
+/*
+* Quantizes and zigzag-orders all blocks on 'threads' threads.
+* Input: DCT coefficients, quantization table, kernel set
+* Input: output array of coeffs->block_count * 64 values
+*/
+void quantize_coefficients(const DCT_COEFFICIENTS *coeffs, const QUANT_TABLE *qt, const KERNEL_TABLE *kernels,
+                           int threads, int16_t *out_zigzag_blocks);
+
+/*
+* Picks the Huffman tables for a scan: the standard ones, or with settings->optimize_huffman,
+* tables generated into 'huffman_data' from the blocks' statistics.
+* Returns 0 on success, -1 on error.
+*/
+int select_huffman_tables(const int16_t *zigzag_blocks, uint32_t block_count, const SCAN_SETTINGS *settings,
+                          HUFFMAN_TABLE_DATA *huffman_data, HUFFMAN_TABLES *tables);
+
+#endif
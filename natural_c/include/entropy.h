@@ -0,0 +1,92 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <stdint.h>
+#include "dct.h"
+#include "output_sink.h"
+
+/*
+* Entropy coding of whole images held as quantized, zigzag-ordered blocks (64 int16_t each).
+*/
+
+/*
+* Upper bound of the encoded size of one block in bytes:
+* DC (9 + 11 bits) + 63 AC symbols (16 + 10 bits), every byte possibly stuffed.
+*/
+#define ENTROPY_MAX_BLOCK_BYTES 416
+
+/*
+* Restart chunk or slice of the parallel coder, coded on a worker thread into its own buffer.
+*/
+typedef struct {
+    GROWABLE_BUFFER buffer;     // grown by the chunk's BitWriter as needed, kept for the next scan
+    uint32_t size;
+    int failed;
+} ENTROPY_CHUNK;
+
+/*
+* Scratch arrays of the parallel paths of encode_blocks, gather_block_statistics and
+* dry_run_scan_size, kept between scans so repeated encodes do not allocate.
+* Zero-initialize, size with entropy_workspace_reserve and release with entropy_workspace_free.
+* The functions take NULL instead to allocate a temporary one per call.
+* One workspace serves one call at a time.
+*/
+typedef struct {
+    ENTROPY_CHUNK *chunks;          // restart chunks or slices
+    uint64_t *chunk_bits;           // valid bits per slice, or bytes per dry run task
+    uint32_t chunk_capacity;
+    uint32_t (*dc_freq)[16];        // per task symbol histograms
+    uint32_t (*ac_freq)[256];
+    uint32_t freq_capacity;
+} ENTROPY_WORKSPACE;
+
+/*
+* Grows (never shrinks) a workspace for scans of up to 'block_count' blocks on up to 'threads' threads.
+* Returns 0 on success, -1 when memory is exhausted.
+*/
+int entropy_workspace_reserve(ENTROPY_WORKSPACE *workspace, uint32_t block_count, int threads);
+
+void entropy_workspace_free(ENTROPY_WORKSPACE *workspace);
+
+/*
+* Huffman-codes a sequence of blocks.
+* Input: blocks in zigzag order, block count
+* Input: restart interval in blocks (0 = no restart markers)
+* Input: Huffman tables
+* Input: number of worker threads and their workspace (NULL = allocated per call)
+* Input: BitWriter to append to (not flushed at the end)
+* With a restart interval each interval starts from a zero DC prediction and is closed with RSTn,
+* so intervals are independent and are encoded on worker threads, each into its own buffer.
+* The buffers are concatenated in order; the output does not depend on the thread count.
+* The parallel path needs a byte aligned BitWriter (nothing pending), otherwise it runs serially.
+* Without restart markers the blocks are split into slices instead: each slice is coded on a worker
+* thread into a raw bit buffer, seeded with the last DC of the previous slice, and the slices are
+* stitched at bit granularity with stuffing redone on the way, so the bytes match the serial coder.
+* Returns 0 on success, -1 on error.
+*/
+int encode_blocks(const int16_t *zigzag_blocks, uint32_t block_count, uint32_t restart_interval,
+                  const HUFFMAN_TABLES *tables, int threads, ENTROPY_WORKSPACE *workspace, BitWriter *bw);
+
+/*
+* First pass of two-pass coding: histograms of the DC categories and AC symbols
+* encode_blocks would emit for the same blocks and restart interval.
+* Input: blocks in zigzag order, block count, restart interval
+* Input: number of worker threads and their workspace (NULL = allocated per call)
+* Input: DC (16 entries) and AC (256 entries) histograms to fill
+* Returns 0 on success, -1 on error.
+*/
+int gather_block_statistics(const int16_t *zigzag_blocks, uint32_t block_count, uint32_t restart_interval,
+                            int threads, ENTROPY_WORKSPACE *workspace, uint32_t *dc_freq, uint32_t *ac_freq);
+
+/*
+* Exact scan size in bytes that encode_blocks (followed by bw_flush) would produce, computed by
+* a dry run that shares the block walk of encode_coefficients but writes nothing.
+* Includes 0xFF stuffing, restart padding and RSTn markers.
+* Input: blocks in zigzag order, block count, restart interval, Huffman tables
+* Input: number of worker threads (used when restart intervals make the scan splittable)
+*        and their workspace (NULL = allocated per call)
+*/
+uint64_t dry_run_scan_size(const int16_t *zigzag_blocks, uint32_t block_count, uint32_t restart_interval,
+                           const HUFFMAN_TABLES *tables, int threads, ENTROPY_WORKSPACE *workspace);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include <stdint.h>
+#include "dct.h"
+
+/*
+* Generation of per-image optimal Huffman tables (ISO/IEC 10918-1, Annex K.2).
+*/
+
+/*
+* Storage for a generated table set; HUFFMAN_TABLES built from it point into this struct.
+*/
+typedef struct {
+    HuffmanCode dc[16];
+    HuffmanCode ac[256];
+    HUFFMAN_SPEC dc_spec;
+    HUFFMAN_SPEC ac_spec;
+} HUFFMAN_TABLE_DATA;
+
+/*
+* Builds a length-limited (max 16 bits) Huffman table from symbol frequencies.
+* A reserved symbol keeps the all-ones code out of the table, as the standard requires.
+* Input: frequencies of 'symbol_count' symbols (at most 256), zero = symbol unused
+* Input: table to fill, in DHT form
+*/
+void build_optimal_huffman_spec(const uint32_t *freq, int symbol_count, HUFFMAN_SPEC *spec);
+
+/*
+* Assigns canonical codes to a DHT-form table (Annex C).
+* Input: table in DHT form
+* Input: lookup table indexed by symbol (must hold every symbol value used)
+*/
+void build_huffman_codes(const HUFFMAN_SPEC *spec, HuffmanCode *codes);
+
+/*
+* Builds DC and AC tables for the given symbol statistics.
+* Input: DC category (16 entries) and AC symbol (256 entries) histograms
+* Input: storage for the generated tables
+* Input: table set to initialize, pointing into 'data'
+*/
+void build_optimal_huffman_tables(const uint32_t *dc_freq, const uint32_t *ac_freq,
+                                  HUFFMAN_TABLE_DATA *data, HUFFMAN_TABLES *tables);
+
+#endif
@@ -1,73 +1,90 @@
-#include <stdio.h>
+#ifndef JFIF_HANDLER_H
+#define JFIF_HANDLER_H
+
 #include <stdint.h>
+#include <stddef.h>
+#include "dct.h"
+#include "color_spaces.h"
 
 /*
 * JFIF Handler
 * Contains function definitions for handling JFIF serialization.
 */
 
-/* 
-* Standard Luminance quantization table.
+/*
+* Everything the headers describe about a frame and its single scan.
+* Grayscale frames use index 0 only; YCbCr frames use index 0 for Y and 1 for Cb and Cr.
 */
-extern const uint8_t std_lum_qt[64];
-extern const uint8_t std_lum_qt_zigzagged[64];
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint16_t restart_interval;          // MCUs per restart interval, 0 = no DRI segment
+    COLOR_MODE color_mode;
+    const QUANT_TABLE *qt[2];           // quantization tables (luminance, chrominance)
+    const HUFFMAN_TABLES *tables[2];    // Huffman tables (luminance, chrominance)
+} JFIF_FRAME;
 
 /*
-* Writes 2 bytes into file.
-* Input: pointer to a open file
-* Input: two-byte data
+* Largest header (SOI through SOS) a frame can produce: APP0, two DQT, SOF0 with three components,
+* four DHT segments with up to 256 symbols each, DRI and SOS.
 */
-void write_word(FILE *f, uint16_t v);
+#define JFIF_HEADER_MAX (2 + 18 + 2 * 69 + 19 + 4 * (21 + 256) + 6 + 14)
 
 /*
-* Writes SOI marker - Start of Image
+* Serialized header of a frame, built once and reused for every image with the same tables.
+* Only the picture size in SOF0 depends on the image, and it can be patched in place.
 */
-void write_soi(FILE *f);
+typedef struct {
+    uint8_t bytes[JFIF_HEADER_MAX];
+    uint32_t size;                      // SOI through SOS
+    uint32_t size_pos;                  // offset of the SOF0 height and width fields
+} JFIF_HEADER;
 
-/*
-* Writes APP0 marker
+/* 
+* Standard Luminance quantization table.
 */
-void write_app0(FILE *f);
+extern const uint8_t std_lum_qt[64];
+extern const uint8_t std_lum_qt_zigzagged[64];
 
 /*
-* Writes DQT marker - Define Quantization Table
-* It uses external quantization table std_lum_qt
+* Returns the number of bytes a grayscale frame adds around the scan data (all markers and segments).
+* Input: restart interval and Huffman tables of the scan
 */
-void write_dqt(FILE *f);
+uint32_t jfif_header_size(uint16_t restart_interval, const HUFFMAN_TABLES *tables);
 
 /*
-* Writes SOF0 marker - Start of Frame
-* Input: width of the picture
-* Input: height of the picture
+* Returns the number of bytes a frame adds around the scan data (header and EOI).
 */
-void write_sof0(FILE *f, uint16_t width, uint16_t height);
+uint32_t jfif_frame_header_size(const JFIF_FRAME *frame);
 
 /*
-* Writes DHT marker - Define Huffman Table
+* Builds the header template of a frame (SOI through SOS) in memory.
 */
-void write_dht(FILE *f);
+void jfif_header_init(JFIF_HEADER *header, const JFIF_FRAME *frame);
 
 /*
-* Writes SOS marker - Start of Scan
+* Patches the picture size of a header template in place; everything else stays valid.
 */
-void write_sos(FILE *f);
+void jfif_header_set_size(JFIF_HEADER *header, uint16_t width, uint16_t height);
 
 /*
-* Writes EOI marker - End of Image
+* Encode-to-memory: places the header at the start of a caller buffer and returns where the scan
+* data goes, directly after it. Once the scan is written (and flushed), jfif_finish appends EOI.
+* The buffer needs header->size + scan length + 2 bytes.
 */
-void write_eoi(FILE *f);
+uint8_t* jfif_begin(const JFIF_HEADER *header, uint8_t *out);
 
-/* 
-* Write processed image bytes.
+/*
+* Appends EOI after 'scan_length' bytes of scan data written at jfif_begin's position.
+* Returns the size of the complete JPEG at 'out'.
 */
-void write_bitstream(FILE *f, uint8_t *buffer, int length);
+size_t jfif_finish(const JFIF_HEADER *header, uint8_t *out, uint32_t scan_length);
 
 /*
-* Perform image serialization into a JFIF file.
-* Input: file to write to
-* Input: buffer containing processed bytes of image
-* Input: buffer length
-* Input: image width
-* Input: image height
+* Writes header, scan data and EOI to a file descriptor (file, pipe or socket) with a single
+* writev call, continuing after partial writes.
+* Returns 0 on success, -1 on error.
 */
-void write_to_jfif(FILE *f, uint8_t *buffer, int length, uint16_t width, uint16_t height);
+int jfif_writev(int fd, const JFIF_HEADER *header, const uint8_t *scan, uint32_t length);
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef JPEGENC_H
+#define JPEGENC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "dct.h"
+#include "simd.h"
+#include "color_spaces.h"
+#include "pipeline.h"
+
+/*
+* libjpegenc - in-process encoder API.
+* An encoder context is created for one frame size and set of options and then encodes any
+* number of images with them. Quantization tables, the JFIF header bytes, the MCU row workspace
+* (fused pipeline) or the coefficient and quantized block arrays (staged pipeline) and the output
+* buffer are built or allocated once and owned by the context. The output buffer
+* starts at an estimate and grows when a scan needs more room; it is kept for later encodes, so
+* steady-state encoding performs no allocation. Each encode produces a complete JPEG file in memory,
+* or streams it to a file descriptor.
+*
+* Typical use:
+*     JPEGENC_OPTIONS options;
+*     jpegenc_default_options(&options, width, height);
+*     options.quality = 75;
+*     JPEGENC_CONTEXT *ctx = jpegenc_create(&options);
+*     JPEGENC_OUTPUT jpeg;
+*     jpegenc_encode_bgr(ctx, pixels, stride, &jpeg);     // jpeg.data / jpeg.size
+*     jpegenc_destroy(ctx);
+*
+* Functions report problems with an "Error: ..." line on stdout and return -1 (NULL for create).
+*/
+
+typedef struct {
+    uint32_t width;             // 1-65535
+    uint32_t height;            // 1-65535
+    int quality;                // 1-100, 50 = standard tables
+    COLOR_MODE color_mode;      // grayscale, or YCbCr 4:4:4 / 4:2:2 / 4:2:0
+    DCT_METHOD dct_method;
+    uint32_t restart_interval;  // MCUs per restart interval, 0 = no restart markers
+    SIMD_ISA isa;               // kernel set of this context, SIMD_ISA_AUTO takes the current get_kernels() one
+    int quality_metrics;        // 1 = measure luminance PSNR and block-SSIM of every encode (quality_metrics.h)
+
+    // The options below need the staged pipeline, which keeps the DCT coefficients of the whole
+    // image. It encodes grayscale only.
+    PIPELINE_MODE pipeline;     // PIPELINE_FUSED (one MCU row at a time) or PIPELINE_STAGED
+    int threads;                // staged: threads for quantization and entropy coding, 0 = one per core
+    int optimize_huffman;       // staged: 1 = Huffman tables built for each image (two-pass coding)
+    uint32_t target_size;       // staged: highest quality whose file fits this many bytes, 0 = use 'quality'
+} JPEGENC_OPTIONS;
+
+/*
+* Encoded JPEG file, owned by the context (data is NULL for streamed output).
+* Valid until the next encode, reset or destroy on the same context.
+*/
+typedef struct {
+    const uint8_t *data;
+    size_t size;                // whole file, SOI to EOI
+    size_t scan_size;           // entropy-coded data between the header and EOI
+    int quality;                // quality the image was encoded with (chosen one with options.target_size)
+    double psnr;                // luminance PSNR in dB, with options.quality_metrics (0 otherwise)
+    double ssim;                // mean luminance block-SSIM, with options.quality_metrics (0 otherwise)
+} JPEGENC_OUTPUT;
+
+typedef struct JPEGENC_CONTEXT JPEGENC_CONTEXT;
+
+// Most qualities one jpegenc_encode_variants call encodes
+#define JPEGENC_MAX_VARIANTS 16
+
+/*
+* Fills 'options' with the defaults for a frame size: quality 50, grayscale, float DCT,
+* no restart markers, auto-detected kernels, no quality metrics, fused pipeline on one thread.
+*/
+void jpegenc_default_options(JPEGENC_OPTIONS *options, uint32_t width, uint32_t height);
+
+/*
+* Creates an encoder context.
+* Returns NULL on invalid options or when memory is exhausted.
+*/
+JPEGENC_CONTEXT* jpegenc_create(const JPEGENC_OPTIONS *options);
+
+/*
+* Switches a context to new options (frame size, quality, ...).
+* Buffers are only reallocated when the new frame needs more room.
+* Returns 0 on success, -1 on error (the context keeps its previous options).
+*/
+int jpegenc_reset(JPEGENC_CONTEXT *ctx, const JPEGENC_OPTIONS *options);
+
+/*
+* Releases the context and everything it owns. Accepts NULL.
+*/
+void jpegenc_destroy(JPEGENC_CONTEXT *ctx);
+
+/*
+* Returns the options the context currently encodes with.
+*/
+const JPEGENC_OPTIONS* jpegenc_options(const JPEGENC_CONTEXT *ctx);
+
+/*
+* Encodes packed BGR pixels (3 bytes per pixel, rows top-down).
+* Input: pixel buffer and the distance between rows in bytes (0 = width * 3)
+* Input: output descriptor to fill
+*/
+int jpegenc_encode_bgr(JPEGENC_CONTEXT *ctx, const uint8_t *bgr, size_t stride, JPEGENC_OUTPUT *out);
+
+/*
+* Encodes from a BGR row source (BMP in memory, mapped or streamed).
+* The staged pipeline with quality_metrics reads the source a second time to compare it with the
+* quantized blocks, so a single-pass source (the strip reader of bmp_stream.h) is refused with an
+* error. The same holds for jpegenc_stream_rows and jpegenc_encode_variants.
+*/
+int jpegenc_encode_rows(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source, JPEGENC_OUTPUT *out);
+
+/*
+* Encodes from a BGR row source straight to a file descriptor (file, pipe or socket).
+* Output goes through a small ring of chunks written by a separate thread, so memory use does not
+* depend on the image and the first bytes are sent while the rest is still being encoded.
+* 'out' receives the sizes only (data is NULL).
+*/
+int jpegenc_stream_rows(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source, int fd, JPEGENC_OUTPUT *out);
+
+/*
+* Encodes YUV planes without color conversion. The image must match the context's frame size.
+* A color context encodes with the image's own chroma sampling (the frame header follows it),
+* a grayscale context encodes the Y plane only. Needs a fused pipeline context.
+*/
+int jpegenc_encode_yuv(JPEGENC_CONTEXT *ctx, const YUV_IMAGE *image, JPEGENC_OUTPUT *out);
+
+/*
+* Encodes one image at several qualities (staged pipeline only). Color conversion and DCT run once,
+* then every quality gets its own quantization, entropy coding and file. With options.threads above
+* one the variants are encoded concurrently and share the threads; with quality_metrics they read
+* the source concurrently (see jpegenc_encode_rows). options.quality and options.target_size are not used.
+* Input: row source, qualities (1-100) and their count (1-JPEGENC_MAX_VARIANTS)
+* Input: one output descriptor per quality, each valid until the next encode on the context
+*/
+int jpegenc_encode_variants(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source, const int *qualities, uint32_t count,
+                            JPEGENC_OUTPUT *outs);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef MJPEG_H
+#define MJPEG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "bmp_handler.h"
+
+/*
+* Motion-JPEG stream writer.
+* Frames are complete JPEG files (e.g. from an encoder context, which builds the shared JFIF
+* header once), so every frame costs a single fwrite.
+* OUTPUT_MJPEG_CONCAT writes the JPEGs back to back. OUTPUT_MJPEG_AVI wraps them in an AVI 1.0
+* file ('MJPG' video stream, one '00dc' chunk per frame, idx1 index). The AVI headers are patched
+* at close, so the output must be seekable. AVI 1.0 is limited to 4 GB: a frame that would not fit
+* (with its index entry) is refused and the file is closed cleanly with the frames before it.
+*/
+
+typedef struct {
+    uint32_t offset;            // chunk position relative to the 'movi' fourcc
+    uint32_t size;              // chunk payload size
+} MJPEG_INDEX_ENTRY;
+
+typedef struct {
+    FILE *file;
+    OUTPUT_CONTAINER container;
+    uint32_t frame_count;
+    uint32_t max_frame_size;
+
+    // AVI bookkeeping
+    long movi_pos;              // file position of the 'movi' fourcc
+    MJPEG_INDEX_ENTRY *index;
+    uint32_t index_capacity;
+} MJPEG_WRITER;
+
+/*
+* Creates the output file and (for AVI) writes placeholder headers.
+* Input: writer to initialize, output path, container
+* Input: frame size shared by all frames (AVI only)
+* Input: frame rate as a fraction (AVI only)
+* Returns 0 on success, -1 on error (writer is left closed).
+*/
+int mjpeg_open(MJPEG_WRITER *writer, const char *outputFile, OUTPUT_CONTAINER container,
+               uint32_t width, uint32_t height, uint32_t fps_num, uint32_t fps_den);
+
+/*
+* Appends one frame.
+* Input: complete JPEG file of the frame (SOI to EOI) and its size
+* Returns 0 on success, 1 if the AVI file is full (4 GB, nothing written), -1 on error.
+*/
+int mjpeg_write_frame(MJPEG_WRITER *writer, const uint8_t *jpeg, uint32_t frame_size);
+
+/*
+* Finishes the stream (AVI index and header sizes) and closes the file.
+* Returns 0 on success, -1 on error.
+*/
+int mjpeg_close(MJPEG_WRITER *writer);
+
+#endif
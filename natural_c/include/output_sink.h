@@ -0,0 +1,87 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "dct.h"
+
+/*
+* BitWriter sinks.
+*   - growable buffer: the whole output stays in memory, the buffer is grown geometrically on demand
+*     and kept for the next image
+*   - file descriptor ring: a fixed ring of output chunks; full chunks are written to a file, pipe or
+*     socket by a writer thread while the encoder fills the next one, so memory use is bounded and
+*     the first bytes reach the consumer before encoding finishes
+*/
+
+/*
+* Memory output that grows on demand. The BitWriter writes from data + offset, which leaves
+* room for a header in front of the scan.
+*/
+typedef struct {
+    uint8_t *data;
+    size_t capacity;
+    size_t offset;
+} GROWABLE_BUFFER;
+
+/*
+* Makes sure the buffer holds at least 'size' bytes (contents are kept).
+* Returns 0 on success, -1 when memory is exhausted.
+*/
+int growable_buffer_reserve(GROWABLE_BUFFER *buffer, size_t size);
+
+/*
+* Releases the buffer's memory.
+*/
+void growable_buffer_free(GROWABLE_BUFFER *buffer);
+
+/*
+* Initializes a sink that grows 'buffer' whenever the BitWriter runs out of room.
+* The BitWriter's bytes end up at buffer->data + buffer->offset.
+*/
+void init_growable_sink(BW_SINK *sink, GROWABLE_BUFFER *buffer);
+
+#define FD_SINK_CHUNK_SIZE      (64 * 1024)
+#define FD_SINK_CHUNK_COUNT     4
+
+typedef struct {
+    int fd;
+    uint8_t *chunks;            // chunk_count buffers of chunk_size bytes
+    uint32_t *lengths;          // bytes queued in each chunk
+    uint32_t chunk_size;
+    uint32_t chunk_count;
+    uint32_t filling;           // chunk the BitWriter writes into
+    uint32_t next_write;        // oldest queued chunk
+    uint32_t queued;            // chunks waiting for the writer thread
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int writer_started;
+    int stop;
+    int error;
+    uint64_t written;           // bytes written to the descriptor
+} FD_SINK;
+
+/*
+* Allocates the chunk ring and starts the writer thread.
+* Input: descriptor to write to (not closed by the sink)
+* Input: chunk size (at least BW_MIN_CAPACITY) and number of chunks (at least 2)
+* Returns 0 on success, -1 on error.
+*/
+int fd_sink_open(FD_SINK *fd_sink, int fd, uint32_t chunk_size, uint32_t chunk_count);
+
+/*
+* Waits until every queued chunk is written, stops the writer thread and frees the ring.
+* Call after bw_finish, which queues the BitWriter's last partial chunk.
+* Returns 0 on success, -1 if a write failed.
+*/
+int fd_sink_close(FD_SINK *fd_sink);
+
+/*
+* Initializes a BitWriter sink over an open descriptor ring.
+*/
+void init_fd_sink(BW_SINK *sink, FD_SINK *fd_sink);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+
+/*
+* Minimal fork-join helper on top of pthreads.
+* Runs task(ctx, i) for every i in [0, task_count) on up to 'threads' worker threads.
+* Workers pull task indices from a shared counter, so uneven tasks balance out.
+* With threads <= 1 (or a single task) everything runs on the calling thread.
+* Returns once all tasks are done.
+*/
+void parallel_for(uint32_t task_count, int threads, void (*task)(void *ctx, uint32_t index), void *ctx);
+
+/*
+* Returns the number of online CPUs (at least 1).
+*/
+int cpu_count(void);
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "dct.h"
+#include "color_spaces.h"
+#include "simd.h"
+#include "quality_metrics.h"
+
+/*
+* Fused single-pass encoding pipeline.
+* Each MCU row goes from BGR bytes through Y conversion, DCT, quantization, zigzag and
+* entropy coding before the next one is touched, so working memory is one MCU row
+* instead of several full-image intermediates.
+*/
+
+/*
+* Encoding pipeline layout.
+* PIPELINE_STAGED runs each stage over the whole image, PIPELINE_FUSED processes one MCU row at a time.
+*/
+typedef enum {
+    PIPELINE_STAGED = 0,
+    PIPELINE_FUSED
+} PIPELINE_MODE;
+
+/*
+* Source of BGR scanlines (3 bytes per pixel, no padding requirements).
+* fetch_rows fills rows[0..7] with the top-down scanlines of MCU row 'mcu_row'.
+* Scanlines past the bottom edge must repeat the last scanline (edge padding).
+* Returns 0 on success, non-zero on error.
+*/
+typedef struct {
+    void *ctx;
+    int (*fetch_rows)(void *ctx, uint32_t mcu_row, const uint8_t *rows[8]);
+    int single_pass;        // 1 if every MCU row can be fetched only once, in order (strip reader)
+} ROW_SOURCE;
+
+/*
+* Row source over a BMP pixel array already in memory (zero copy).
+*/
+typedef struct {
+    const uint8_t *pixel_data;
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_stride;    // bytes per BMP row including padding
+    int bottom_up;          // 1 if the first stored row is the bottom one
+} BMP_MEMORY_SOURCE;
+
+/*
+* Initializes a row source over a BMP pixel array.
+* Input: source to initialize and its state (must outlive the source)
+* Input: pixel data, image dimensions and storage orientation
+*/
+void init_bmp_memory_source(ROW_SOURCE *source, BMP_MEMORY_SOURCE *state, const uint8_t *pixel_data,
+                            uint32_t width, uint32_t height, int bottom_up);
+
+/*
+* One 8-bit component plane of a YUV image.
+* Sample (x, y) is at data[y * stride + x * step], so planar, semi-planar (NV12) and packed (YUYV)
+* layouts are all addressed in place.
+*/
+typedef struct {
+    const uint8_t *data;
+    uint32_t width;             // samples per row
+    uint32_t height;            // rows
+    uint32_t stride;            // bytes between rows
+    uint32_t step;              // bytes between neighbouring samples in a row
+} YUV_PLANE;
+
+/*
+* YUV image whose planes go straight to the block stage, with no color conversion.
+* 'sampling' is the chroma subsampling of the planes (COLOR_MODE_GRAY for luminance only).
+*/
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    COLOR_MODE sampling;
+    YUV_PLANE planes[3];        // Y, Cb (U), Cr (V)
+} YUV_IMAGE;
+
+/*
+* Returns the size of a BMP row in bytes (24-bit pixels padded to a multiple of 4).
+*/
+uint32_t bmp_row_stride(uint32_t width);
+
+/*
+* Returns the size in bytes of the MCU row workspace encode_fused / encode_fused_color need
+* for an image width and color mode.
+*/
+size_t fused_workspace_size(uint32_t width, COLOR_MODE mode);
+
+/*
+* Returns a first capacity for a growable scan buffer: 4 bits per sample, which covers typical
+* photos up to high qualities. Noisier images grow the buffer on demand.
+*/
+size_t scan_buffer_estimate(uint32_t width, uint32_t height, COLOR_MODE mode);
+
+/*
+* Converts MCU row 'mcu_row' of a row source to 8 rows of centered Y, each padded to whole blocks
+* (padded_w = 8 * blocks_w floats) by repeating its last sample.
+* Input: row source, image width, kernel set
+* Input: output rows, fused_workspace_size(width, COLOR_MODE_GRAY) bytes
+* Returns 0 on success, -1 when the source fails.
+*/
+int load_y_rows(const ROW_SOURCE *source, uint32_t mcu_row, uint32_t width, const KERNEL_TABLE *kernels,
+                float *y_rows);
+
+/*
+* Encodes a grayscale image through the fused pipeline.
+* Input: row source, image dimensions, DCT method
+* Input: kernel set (e.g. get_kernels(), or a table kept by an encoder context)
+* Input: quantization table
+* Input: restart interval in blocks (0 = no restart markers)
+* Input: workspace of fused_workspace_size bytes, or NULL to allocate one for this call
+* Input: quality metrics to add every coded block to, or NULL
+* Input: BitWriter to append scan data to (not flushed, so the caller can continue or pad it)
+* Returns 0 on success, -1 on error.
+*/
+int encode_fused(const ROW_SOURCE *source, uint32_t width, uint32_t height, DCT_METHOD method,
+                 const KERNEL_TABLE *kernels, const QUANT_TABLE *qt, uint32_t restart_interval, float *workspace, QUALITY_METRICS *metrics,
+                 BitWriter *bw);
+
+/*
+* Encodes a YCbCr image through the fused pipeline, with interleaved MCUs (Y blocks, then Cb, then Cr).
+* Chroma is downsampled during color conversion, so Cb and Cr are never held at full resolution.
+* Input: row source, image dimensions, DCT method
+* Input: color mode (COLOR_MODE_444, COLOR_MODE_422 or COLOR_MODE_420), kernel set
+* Input: luminance and chrominance quantization tables
+* Input: restart interval in MCUs (0 = no restart markers)
+* Input: workspace of fused_workspace_size bytes, or NULL to allocate one for this call
+* Input: quality metrics to add every luminance block to, or NULL
+* Input: BitWriter to append scan data to (not flushed)
+* Returns 0 on success, -1 on error.
+*/
+int encode_fused_color(const ROW_SOURCE *source, uint32_t width, uint32_t height, DCT_METHOD method, COLOR_MODE mode,
+                       const KERNEL_TABLE *kernels, const QUANT_TABLE *qt, const QUANT_TABLE *chroma_qt, uint32_t restart_interval,
+                       float *workspace, QUALITY_METRICS *metrics, BitWriter *bw);
+
+/*
+* Encodes a YUV image: blocks are cut straight out of its planes (edge samples repeated),
+* only centered and transformed.
+* Input: image, DCT method and kernel set
+* Input: color mode - COLOR_MODE_GRAY encodes the Y plane only, any other value encodes all three
+*        planes with the image's own sampling
+* Input: luminance and chrominance quantization tables
+* Input: restart interval in MCUs (0 = no restart markers)
+* Input: quality metrics to add every Y block to, or NULL
+* Input: BitWriter to append scan data to (not flushed)
+* Returns 0 on success, -1 on error.
+*/
+int encode_planes(const YUV_IMAGE *image, DCT_METHOD method, const KERNEL_TABLE *kernels, COLOR_MODE mode,
+                  const QUANT_TABLE *qt, const QUANT_TABLE *chroma_qt, uint32_t restart_interval,
+                  QUALITY_METRICS *metrics, BitWriter *bw);
+
+/*
+* Measures the quality of a grayscale image coded by the staged pipeline: Y is converted again
+* from the row source, one MCU row at a time, and compared with the reconstruction of the
+* quantized blocks.
+* Input: row source and image dimensions
+* Input: quantized blocks in zigzag order (row-major block order) and the table they were quantized with
+* Input: kernel set for the Y conversion
+* Input: workspace of fused_workspace_size(width, COLOR_MODE_GRAY) bytes, or NULL to allocate one per call
+* Input: metrics to add the blocks to
+* Returns 0 on success, -1 on error.
+*/
+int measure_quality_rows(const ROW_SOURCE *source, uint32_t width, uint32_t height, const int16_t *zigzag_blocks,
+                         const QUANT_TABLE *qt, const KERNEL_TABLE *kernels, float *workspace, QUALITY_METRICS *metrics);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef QUALITY_METRICS_H
+#define QUALITY_METRICS_H
+
+#include <stdint.h>
+#include "dct.h"
+
+/*
+* Reconstruction quality measured inside the encoder, without a decoder or a file round trip.
+* Every quantized luminance block is dequantized and inverse transformed, rounded and clamped to
+* 8 bits like a decoder's output, and compared with the source samples it was coded from.
+*   - PSNR over all pixels of the image (edge padding excluded), 255 peak
+*   - block-SSIM: SSIM on each 8x8 block as one window (uniform weights, C1 = (0.01 * 255)^2,
+*     C2 = (0.03 * 255)^2), averaged over the blocks. It tracks, but does not equal, the 7x7 sliding
+*     window SSIM of analysis/analyze_jpeg.py.
+*/
+
+typedef struct {
+    double squared_error;   // sum of (source - reconstructed)^2 over all measured pixels
+    uint64_t pixels;
+    double ssim_sum;        // sum of the per-block SSIM values
+    uint32_t blocks;
+} QUALITY_METRICS;
+
+/*
+* Resets the accumulated error and SSIM.
+*/
+void quality_metrics_init(QUALITY_METRICS *metrics);
+
+/*
+* Adds one coded block.
+* Input: source block, 64 samples centered around zero (the DCT input)
+* Input: the block's quantized coefficients in zigzag order and the quantization table they use
+* Input: number of columns and rows of the block inside the image (0-8), the rest is edge padding;
+*        blocks entirely in the padding are ignored
+*/
+void quality_metrics_add_block(QUALITY_METRICS *metrics, const float *block, const int16_t *zigzag_block,
+                               const QUANT_TABLE *qt, uint32_t valid_w, uint32_t valid_h);
+
+/*
+* Returns the PSNR in dB; 100 for an exact reconstruction, 0 if nothing was measured.
+*/
+double quality_metrics_psnr(const QUALITY_METRICS *metrics);
+
+/*
+* Returns the mean block-SSIM (1 = identical), 0 if nothing was measured.
+*/
+double quality_metrics_ssim(const QUALITY_METRICS *metrics);
+
+#endif
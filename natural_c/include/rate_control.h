@@ -0,0 +1,28 @@
+#ifndef RATE_CONTROL_H
+#define RATE_CONTROL_H
+
+#include <stdint.h>
+#include "encoder.h"
+
+/*
+* Rate control over cached DCT coefficients.
+* Each candidate quality only re-runs quantization, zigzag and an entropy dry run (no bitstream is written).
+*/
+
+/*
+* Exact JFIF file size for a quality factor.
+* Input: DCT coefficients, quality, kernel set, scan settings (restart interval, Huffman optimization, threads)
+* Input: scratch array for the quantized blocks (coeffs->block_count * 64 values)
+*/
+uint64_t predict_file_size(const DCT_COEFFICIENTS *coeffs, int quality, const KERNEL_TABLE *kernels,
+                            const SCAN_SETTINGS *settings, int16_t *zigzag_blocks);
+
+/*
+* Binary search for the highest quality whose file size is at most 'target_size' bytes.
+* Input: same as predict_file_size, plus the byte budget
+* Returns the quality (1-100); 1 if even the lowest quality does not fit.
+*/
+int find_quality_for_size(const DCT_COEFFICIENTS *coeffs, const KERNEL_TABLE *kernels, const SCAN_SETTINGS *settings,
+                          uint32_t target_size, int16_t *zigzag_blocks);
+
+#endif
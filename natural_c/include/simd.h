@@ -0,0 +1,92 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+#include "dct.h"
+#include "color_spaces.h"
+
+/*
+* x86 SIMD kernel set with runtime CPU dispatch.
+* Every kernel has a scalar variant (the reference functions from dct.c / grayscale.c) and,
+* where the CPU allows it, SSE4.1 and AVX2 variants producing identical results.
+*/
+
+typedef enum {
+    SIMD_ISA_AUTO = -1,     // pick the best ISA reported by CPUID
+    SIMD_ISA_SCALAR = 0,
+    SIMD_ISA_SSE4,          // SSE4.1 + SSSE3
+    SIMD_ISA_AVX2
+} SIMD_ISA;
+
+/*
+* Table of kernels for one instruction set.
+*/
+typedef struct {
+    SIMD_ISA isa;
+    const char *name;
+
+    // RGB -> Y (BT.601) for 'count' pixels
+    void (*rgb_to_y)(const RGB *pixels, float *out_y, uint32_t count);
+
+    // Packed BGR bytes -> Y (BT.601) centered around zero (Y - 128), for 'count' pixels
+    void (*bgr_to_y)(const uint8_t *bgr, float *out_y, uint32_t count);
+
+    // Float AAN forward DCT, same contract as perform_dct_one_block_aan
+    void (*dct_float)(const float *block, float *out_dct_block);
+
+    // Float quantization, same contract as quantize_block
+    void (*quantize)(float *dct_block, const QUANT_TABLE *qt, int16_t *out_quantized_block);
+
+    // Integer reciprocal quantization, same contract as quantize_block_int
+    void (*quantize_int)(const int32_t *dct_block, const INT_QUANT_TABLE *table, int16_t *out_quantized_block);
+
+    // Zigzag reorder, same contract as zigzag_order
+    void (*zigzag)(const int16_t *input_block, int16_t *output_block);
+} KERNEL_TABLE;
+
+/*
+* Returns the best ISA supported by the running CPU (and enabled by the OS).
+*/
+SIMD_ISA detect_simd_isa(void);
+
+/*
+* Returns the kernel table for the given ISA, or NULL if the CPU does not support it.
+*/
+const KERNEL_TABLE* get_kernel_table(SIMD_ISA isa);
+
+/*
+* Selects the kernels used by the encoder.
+* SIMD_ISA_AUTO picks the detected ISA. Forcing an unsupported ISA falls back to the best supported one.
+* Returns the selected table. The selection is process-wide: call it at start-up, before any encoding
+* thread runs. Code that needs its own kernels (e.g. a libjpegenc context) keeps the table from
+* get_kernel_table instead.
+*/
+const KERNEL_TABLE* select_kernels(SIMD_ISA isa);
+
+/*
+* Returns the currently selected kernels (auto-detected once on first use, thread-safe).
+*/
+const KERNEL_TABLE* get_kernels(void);
+
+/*
+* Scalar RGB -> Y conversion. Reference for the rgb_to_y kernels.
+*/
+void rgb_to_y(const RGB *pixels, float *out_y, uint32_t count);
+
+/*
+* Scalar packed BGR -> centered Y conversion. Reference for the bgr_to_y kernels.
+* Produces the same values as rgb_to_y followed by center_around_zero.
+*/
+void bgr_to_y(const uint8_t *bgr, float *out_y, uint32_t count);
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const KERNEL_TABLE kernels_sse4;
+extern const KERNEL_TABLE kernels_avx2;
+
+/*
+* SSSE3 PSHUFB zigzag, shared by the SSE4 and AVX2 tables.
+*/
+void zigzag_order_sse4(const int16_t *input_block, int16_t *output_block);
+#endif
+
+#endif
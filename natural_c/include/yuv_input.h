@@ -0,0 +1,47 @@
+#ifndef YUV_INPUT_H
+#define YUV_INPUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "bmp_handler.h"
+#include "pipeline.h"
+
+/*
+* Raw YUV input: I420, NV12 and YUYV frames (size given on the command line) and Y4M streams
+* (size and chroma layout from the stream header).
+* Frames are read into one reusable buffer and described as YUV_IMAGE planes over that buffer,
+* so the encoder reads the camera's samples in place.
+*/
+
+typedef struct {
+    FILE *file;
+    INPUT_FORMAT format;
+    uint32_t width;
+    uint32_t height;
+    COLOR_MODE sampling;        // chroma layout of every frame
+    size_t frame_size;          // payload bytes per frame (without the Y4M FRAME line)
+    uint32_t fps_num;           // frame rate from the Y4M header (0 if unknown)
+    uint32_t fps_den;
+    uint8_t *buffer;            // holds the current frame
+} YUV_READER;
+
+/*
+* Opens a YUV file.
+* Input: reader to initialize, file path, format
+* Input: frame size for the raw formats (ignored for Y4M, whose header carries it)
+* Returns 0 on success, -1 on error (reader is left closed).
+*/
+int yuv_open(YUV_READER *reader, const char *inputFile, INPUT_FORMAT format, uint32_t width, uint32_t height);
+
+/*
+* Reads the next frame and describes its planes in 'image' (valid until the next read or close).
+* Returns 0 on success, 1 at the end of the file, -1 on error.
+*/
+int yuv_read_frame(YUV_READER *reader, YUV_IMAGE *image);
+
+/*
+* Releases all resources.
+*/
+void yuv_close(YUV_READER *reader);
+
+#endif
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <math.h>
 #include "bmp_handler.h"
+#include "parallel.h"
 
 BMP_IMAGE load_bmp_image(const char* inputFile) {
     BMP_IMAGE image = {0}; 
@@ -97,7 +98,7 @@ void free_bmp_image(BMP_IMAGE image) {
 }
 
 PARAMETERS parse_parameters(int argc, char* argv[]) {
-    PARAMETERS params = {NULL, NULL};
+    PARAMETERS params = {NULL, NULL, DCT_METHOD_FLOAT, SIMD_ISA_AUTO, PIPELINE_STAGED, INPUT_LOAD, 0, 1, 0, 50, 0, 0, {0}, {NULL}, COLOR_MODE_GRAY, INPUT_FORMAT_BMP, 0, 0, OUTPUT_JPEG, 0, 0, 0};
     for(int i = 0; i < argc; i++) {
         if(strcmp("-output", argv[i]) == 0 && i + 1 < argc) {
             params.outputFile = argv[++i];
@@ -105,6 +106,178 @@ PARAMETERS parse_parameters(int argc, char* argv[]) {
         else if(strcmp("-input", argv[i]) == 0 && i + 1 < argc) {
             params.inputFile = argv[++i];
         }
+        else if(strcmp("-dct", argv[i]) == 0 && i + 1 < argc) {
+            const char *method = argv[++i];
+            if(strcmp(method, "exact") == 0) {
+                params.dct_method = DCT_METHOD_EXACT;
+            }
+            else if(strcmp(method, "float") == 0) {
+                params.dct_method = DCT_METHOD_FLOAT;
+            }
+            else if(strcmp(method, "int") == 0) {
+                params.dct_method = DCT_METHOD_ISLOW;
+            }
+            else if(strcmp(method, "fast") == 0) {
+                params.dct_method = DCT_METHOD_IFAST;
+            }
+            else {
+                printf("Warning: Unknown DCT method '%s', using 'float'.\n", method);
+            }
+        }
+        else if(strcmp("-isa", argv[i]) == 0 && i + 1 < argc) {
+            const char *isa = argv[++i];
+            if(strcmp(isa, "scalar") == 0) {
+                params.isa = SIMD_ISA_SCALAR;
+            }
+            else if(strcmp(isa, "sse4") == 0) {
+                params.isa = SIMD_ISA_SSE4;
+            }
+            else if(strcmp(isa, "avx2") == 0) {
+                params.isa = SIMD_ISA_AVX2;
+            }
+            else if(strcmp(isa, "auto") != 0) {
+                printf("Warning: Unknown instruction set '%s', using auto-detection.\n", isa);
+            }
+        }
+        else if(strcmp("-stream", argv[i]) == 0) {
+            params.input_mode = INPUT_STREAM;
+            params.pipeline = PIPELINE_FUSED;
+        }
+        else if(strcmp("-mmap", argv[i]) == 0) {
+            params.input_mode = INPUT_MMAP;
+            params.pipeline = PIPELINE_FUSED;
+        }
+        else if(strcmp("-restart", argv[i]) == 0 && i + 1 < argc) {
+            long interval = strtol(argv[++i], NULL, 10);
+            if(interval < 0 || interval > 0xFFFF) {
+                printf("Warning: Restart interval must be 0-65535, restart markers disabled.\n");
+                interval = 0;
+            }
+            params.restart_interval = (uint32_t)interval;
+        }
+        else if(strcmp("-threads", argv[i]) == 0 && i + 1 < argc) {
+            params.threads = (int)strtol(argv[++i], NULL, 10);
+            if(params.threads <= 0) {
+                params.threads = cpu_count();      // 0 = one thread per core
+            }
+        }
+        else if(strcmp("-quality", argv[i]) == 0 && i + 1 < argc) {
+            params.quality = (int)strtol(argv[++i], NULL, 10);
+            if(params.quality < 1 || params.quality > 100) {
+                printf("Warning: Quality must be 1-100, using 50.\n");
+                params.quality = 50;
+            }
+        }
+        else if(strcmp("-target-size", argv[i]) == 0 && i + 1 < argc) {
+            long size = strtol(argv[++i], NULL, 10);
+            if(size <= 0) {
+                printf("Warning: Target size must be positive, ignoring it.\n");
+                size = 0;
+            }
+            params.target_size = (uint32_t)size;
+        }
+        else if(strcmp("-variant", argv[i]) == 0 && i + 2 < argc) {
+            int quality = (int)strtol(argv[++i], NULL, 10);
+            char *output = argv[++i];
+            if(params.variant_count == MAX_VARIANTS) {
+                printf("Warning: At most %d variants are supported, ignoring '%s'.\n", MAX_VARIANTS, output);
+            }
+            else if(quality < 1 || quality > 100) {
+                printf("Warning: Quality must be 1-100, ignoring variant '%s'.\n", output);
+            }
+            else {
+                params.variant_quality[params.variant_count] = quality;
+                params.variant_output[params.variant_count] = output;
+                params.variant_count++;
+            }
+        }
+        else if(strcmp("-optimize", argv[i]) == 0) {
+            params.optimize_huffman = 1;
+        }
+        else if(strcmp("-metrics", argv[i]) == 0) {
+            params.quality_metrics = 1;
+        }
+        else if(strcmp("-color", argv[i]) == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if(strcmp(mode, "gray") == 0) {
+                params.color_mode = COLOR_MODE_GRAY;
+            }
+            else if(strcmp(mode, "444") == 0) {
+                params.color_mode = COLOR_MODE_444;
+            }
+            else if(strcmp(mode, "422") == 0) {
+                params.color_mode = COLOR_MODE_422;
+            }
+            else if(strcmp(mode, "420") == 0) {
+                params.color_mode = COLOR_MODE_420;
+            }
+            else {
+                printf("Warning: Unknown color mode '%s', using 'gray'.\n", mode);
+            }
+        }
+        else if(strcmp("-format", argv[i]) == 0 && i + 1 < argc) {
+            const char *format = argv[++i];
+            if(strcmp(format, "bmp") == 0) {
+                params.input_format = INPUT_FORMAT_BMP;
+            }
+            else if(strcmp(format, "i420") == 0) {
+                params.input_format = INPUT_FORMAT_I420;
+            }
+            else if(strcmp(format, "nv12") == 0) {
+                params.input_format = INPUT_FORMAT_NV12;
+            }
+            else if(strcmp(format, "yuyv") == 0) {
+                params.input_format = INPUT_FORMAT_YUYV;
+            }
+            else if(strcmp(format, "y4m") == 0) {
+                params.input_format = INPUT_FORMAT_Y4M;
+            }
+            else {
+                printf("Warning: Unknown input format '%s', using 'bmp'.\n", format);
+            }
+        }
+        else if(strcmp("-size", argv[i]) == 0 && i + 1 < argc) {
+            unsigned int width, height;
+            const char *size = argv[++i];
+            if(sscanf(size, "%ux%u", &width, &height) == 2 && width > 0 && height > 0) {
+                params.input_width = width;
+                params.input_height = height;
+            }
+            else {
+                printf("Warning: Frame size must be WIDTHxHEIGHT, ignoring '%s'.\n", size);
+            }
+        }
+        else if(strcmp("-mjpeg", argv[i]) == 0 && i + 1 < argc) {
+            const char *container = argv[++i];
+            if(strcmp(container, "concat") == 0) {
+                params.container = OUTPUT_MJPEG_CONCAT;
+            }
+            else if(strcmp(container, "avi") == 0) {
+                params.container = OUTPUT_MJPEG_AVI;
+            }
+            else {
+                printf("Warning: Unknown MJPEG container '%s', using 'concat'.\n", container);
+                params.container = OUTPUT_MJPEG_CONCAT;
+            }
+        }
+        else if(strcmp("-frames", argv[i]) == 0 && i + 1 < argc) {
+            params.max_frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp("-fps", argv[i]) == 0 && i + 1 < argc) {
+            params.fps = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp("-pipeline", argv[i]) == 0 && i + 1 < argc) {
+            const char *pipeline = argv[++i];
+            if(strcmp(pipeline, "fused") == 0) {
+                params.pipeline = PIPELINE_FUSED;
+            }
+            else if(strcmp(pipeline, "staged") == 0) {
+                params.pipeline = PIPELINE_STAGED;
+            }
+            else {
+                printf("Warning: Unknown pipeline '%s', using 'staged'.\n", pipeline);
+            }
+        }
     }
     return params;
 }
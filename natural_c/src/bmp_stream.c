@@ -0,0 +1,282 @@
+#define _FILE_OFFSET_BITS 64            // BMPs larger than 2 GB need 64-bit file offsets
+
+#include "bmp_stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+* Reads strip 'strip' (top-down scanlines 8*strip .. 8*strip + 7) into 'slot'.
+* Both orientations need a single seek and read: a bottom-up file stores the strip's rows contiguously in reverse.
+*/
+static int read_strip(BMP_STRIP_READER *reader, uint32_t strip, BMP_STRIP_SLOT *slot) {
+    uint32_t first_row = strip * BMP_STRIP_ROWS;
+    uint32_t rows = reader->height - first_row;
+    if (rows > BMP_STRIP_ROWS) rows = BMP_STRIP_ROWS;
+
+    uint32_t first_file_row = reader->bottom_up ? reader->height - first_row - rows : first_row;
+    off_t offset = (off_t)reader->header.offset + (off_t)first_file_row * reader->row_stride;
+
+    if (fseeko(reader->file, offset, SEEK_SET) != 0) {
+        return -1;
+    }
+
+    size_t bytes = (size_t)rows * reader->row_stride;
+    if (fread(slot->data, 1, bytes, reader->file) != bytes) {
+        return -1;
+    }
+
+    slot->rows = rows;
+    return 0;
+}
+
+static void* strip_reader_thread(void *arg) {
+    BMP_STRIP_READER *reader = (BMP_STRIP_READER*)arg;
+
+    for (uint32_t strip = 0; strip < reader->strip_count; strip++) {
+        BMP_STRIP_SLOT *slot = &reader->slots[strip & 1];
+
+        // Wait until the encoder releases this slot
+        pthread_mutex_lock(&reader->lock);
+        while (slot->full && !reader->stop) {
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        }
+        int stop = reader->stop;
+        pthread_mutex_unlock(&reader->lock);
+
+        if (stop) break;
+
+        // File I/O runs unlocked, overlapping with the encoder's work on the other slot
+        int status = read_strip(reader, strip, slot);
+
+        pthread_mutex_lock(&reader->lock);
+        if (status != 0) {
+            reader->error = 1;
+        } else {
+            slot->strip = strip;
+            slot->full = 1;
+        }
+        pthread_cond_broadcast(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+
+        if (status != 0) break;
+    }
+
+    return NULL;
+}
+
+int bmp_strip_open(BMP_STRIP_READER *reader, const char *inputFile) {
+    memset(reader, 0, sizeof(*reader));
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->changed, NULL);
+
+    reader->file = fopen(inputFile, "rb");
+    if (reader->file == NULL) {
+        printf("Error: Cannot open file %s\n", inputFile);
+        bmp_strip_close(reader);
+        return -1;
+    }
+
+    if (fread(&reader->header, sizeof(BMP_FILE_HEADER), 1, reader->file) != 1 ||
+        fread(&reader->info, sizeof(BMP_INFO), 1, reader->file) != 1) {
+        printf("Error: File is too short for BMP headers.\n");
+        bmp_strip_close(reader);
+        return -1;
+    }
+
+    if (reader->header.file_type != 0x4D42) { // 'BM'
+        printf("Error: File is not a BMP format (Magic number mismatch).\n");
+        bmp_strip_close(reader);
+        return -1;
+    }
+
+    if (reader->info.bit_per_px != 24 || reader->info.compression != 0 || reader->info.width <= 0 || reader->info.height == 0) {
+        printf("Error: Only uncompressed 24-bit BMP images are supported.\n");
+        bmp_strip_close(reader);
+        return -1;
+    }
+
+    // Negative height marks a top-down BMP
+    reader->width = (uint32_t)reader->info.width;
+    reader->height = (uint32_t)(reader->info.height < 0 ? -(int64_t)reader->info.height : reader->info.height);
+    reader->bottom_up = reader->info.height > 0;
+    reader->row_stride = bmp_row_stride(reader->width);
+    reader->strip_count = (reader->height + BMP_STRIP_ROWS - 1) / BMP_STRIP_ROWS;
+
+    for (int i = 0; i < 2; i++) {
+        reader->slots[i].data = (uint8_t*)malloc((size_t)BMP_STRIP_ROWS * reader->row_stride);
+        reader->slots[i].strip = -1;
+        if (reader->slots[i].data == NULL) {
+            printf("Error: Not enough memory for BMP strips.\n");
+            bmp_strip_close(reader);
+            return -1;
+        }
+    }
+
+    if (pthread_create(&reader->reader, NULL, strip_reader_thread, reader) != 0) {
+        printf("Error: Cannot start BMP reader thread.\n");
+        bmp_strip_close(reader);
+        return -1;
+    }
+    reader->reader_started = 1;
+
+    return 0;
+}
+
+void bmp_strip_close(BMP_STRIP_READER *reader) {
+    if (reader->reader_started) {
+        pthread_mutex_lock(&reader->lock);
+        reader->stop = 1;
+        pthread_cond_broadcast(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+
+        pthread_join(reader->reader, NULL);
+        reader->reader_started = 0;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        free(reader->slots[i].data);
+        reader->slots[i].data = NULL;
+    }
+
+    if (reader->file != NULL) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->changed);
+}
+
+static int bmp_strip_fetch_rows(void *ctx, uint32_t mcu_row, const uint8_t *rows[8]) {
+    BMP_STRIP_READER *reader = (BMP_STRIP_READER*)ctx;
+    BMP_STRIP_SLOT *slot = &reader->slots[mcu_row & 1];
+
+    pthread_mutex_lock(&reader->lock);
+
+    // The reader only moves forwards: an earlier strip is gone and a later one would never arrive
+    if (mcu_row + 1 < reader->next_strip || mcu_row > reader->next_strip) {
+        pthread_mutex_unlock(&reader->lock);
+        printf("Error: Strip %u requested out of order, the strip reader is at strip %u.\n", mcu_row, reader->next_strip);
+        return -1;
+    }
+    if (mcu_row == reader->next_strip) {
+        reader->next_strip++;
+    }
+
+    // The encoder is done with the previous strip, hand its slot back to the reader
+    if (mcu_row > 0) {
+        reader->slots[(mcu_row - 1) & 1].full = 0;
+        pthread_cond_broadcast(&reader->changed);
+    }
+
+    while (!(slot->full && slot->strip == mcu_row) && !reader->error) {
+        pthread_cond_wait(&reader->changed, &reader->lock);
+    }
+    int error = reader->error && !(slot->full && slot->strip == mcu_row);
+
+    pthread_mutex_unlock(&reader->lock);
+
+    if (error) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < 8; i++) {
+        uint32_t row = i < slot->rows ? i : slot->rows - 1;                    // clamp to the last row
+        uint32_t stored = reader->bottom_up ? slot->rows - 1 - row : row;       // bottom-up strips are reversed
+        rows[i] = slot->data + (size_t)stored * reader->row_stride;
+    }
+
+    return 0;
+}
+
+void init_bmp_strip_source(ROW_SOURCE *source, BMP_STRIP_READER *reader) {
+    source->ctx = reader;
+    source->fetch_rows = bmp_strip_fetch_rows;
+    source->single_pass = 1;
+}
+
+int bmp_mmap_open(BMP_MAPPED_IMAGE *image, const char *inputFile) {
+    memset(image, 0, sizeof(*image));
+
+    int fd = open(inputFile, O_RDONLY);
+    if (fd < 0) {
+        printf("Error: Cannot open file %s\n", inputFile);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BMP_FILE_HEADER) + sizeof(BMP_INFO)) {
+        printf("Error: File is too short for BMP headers.\n");
+        close(fd);
+        return -1;
+    }
+
+    void *mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                          // the mapping keeps the file referenced
+
+    if (mapping == MAP_FAILED) {
+        printf("Error: Cannot map file %s\n", inputFile);
+        return -1;
+    }
+
+    image->mapping = mapping;
+    image->mapping_size = (size_t)st.st_size;
+
+#ifdef MADV_HUGEPAGE
+    madvise(mapping, image->mapping_size, MADV_HUGEPAGE);
+#endif
+
+    memcpy(&image->header, mapping, sizeof(BMP_FILE_HEADER));
+    memcpy(&image->info, (const uint8_t*)mapping + sizeof(BMP_FILE_HEADER), sizeof(BMP_INFO));
+
+    if (image->header.file_type != 0x4D42) { // 'BM'
+        printf("Error: File is not a BMP format (Magic number mismatch).\n");
+        bmp_mmap_close(image);
+        return -1;
+    }
+
+    if (image->info.bit_per_px != 24 || image->info.compression != 0 || image->info.width <= 0 || image->info.height == 0) {
+        printf("Error: Only uncompressed 24-bit BMP images are supported.\n");
+        bmp_mmap_close(image);
+        return -1;
+    }
+
+    image->width = (uint32_t)image->info.width;
+    image->height = (uint32_t)(image->info.height < 0 ? -(int64_t)image->info.height : image->info.height);
+
+    // The last row only needs its pixels, not its padding
+    uint64_t needed = (uint64_t)image->header.offset + (uint64_t)(image->height - 1) * bmp_row_stride(image->width)
+                    + (uint64_t)image->width * 3;
+    if (needed > image->mapping_size) {
+        printf("Error: BMP pixel data is truncated.\n");
+        bmp_mmap_close(image);
+        return -1;
+    }
+
+    image->pixels = (const uint8_t*)mapping + image->header.offset;
+    image->bottom_up = image->info.height > 0;
+
+    // Kernel read-ahead for MADV_SEQUENTIAL only runs forwards, so it helps top-down files only.
+    // A bottom-up file is read from its end backwards and keeps the default read-around.
+    if (!image->bottom_up) {
+        madvise(mapping, image->mapping_size, MADV_SEQUENTIAL);
+    }
+
+    return 0;
+}
+
+void bmp_mmap_close(BMP_MAPPED_IMAGE *image) {
+    if (image->mapping != NULL) {
+        munmap(image->mapping, image->mapping_size);
+        image->mapping = NULL;
+    }
+}
+
+void init_bmp_mmap_source(ROW_SOURCE *source, BMP_MAPPED_IMAGE *image) {
+    init_bmp_memory_source(source, &image->rows, image->pixels, image->width, image->height, image->bottom_up);
+}
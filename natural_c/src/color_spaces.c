@@ -48,3 +48,50 @@ YCbCr* rgb_to_ycbcr(RGB* pixels, uint32_t width, uint32_t height) {
 
     return ycbcr_pixels;
 }
+
+uint32_t color_mode_h_factor(COLOR_MODE mode) {
+    return mode == COLOR_MODE_422 || mode == COLOR_MODE_420 ? 2 : 1;
+}
+
+uint32_t color_mode_v_factor(COLOR_MODE mode) {
+    return mode == COLOR_MODE_420 ? 2 : 1;
+}
+
+const char* color_mode_name(COLOR_MODE mode) {
+    switch (mode) {
+        case COLOR_MODE_444: return "444";
+        case COLOR_MODE_422: return "422";
+        case COLOR_MODE_420: return "420";
+        default:             return "gray";
+    }
+}
+
+void bgr_to_cbcr_row(const uint8_t *bgr, uint32_t width, uint32_t count, uint32_t h_factor,
+                     float weight, int accumulate, float *cb, float *cr) {
+    for (uint32_t i = 0; i < count; i++) {
+        float sum_cb = 0.0f;
+        float sum_cr = 0.0f;
+
+        for (uint32_t k = 0; k < h_factor; k++) {
+            uint32_t x = i * h_factor + k;
+            if (x >= width) x = width - 1;                  // clamp to the last column
+
+            const uint8_t *px = bgr + 3 * x;
+            float b = (float)px[0];
+            float g = (float)px[1];
+            float r = (float)px[2];
+
+            // BT.601, the +128 offset cancels with centering
+            sum_cb += -0.168736f * r - 0.331264f * g + 0.5f * b;
+            sum_cr +=  0.5f * r - 0.418688f * g - 0.081312f * b;
+        }
+
+        if (accumulate) {
+            cb[i] += sum_cb * weight;
+            cr[i] += sum_cr * weight;
+        } else {
+            cb[i] = sum_cb * weight;
+            cr[i] = sum_cr * weight;
+        }
+    }
+}
@@ -1,7 +1,37 @@
 #include "dct.h"
+#include "simd.h"
 #include <stdlib.h>
 #include <math.h>
 
+/*
+* Output descaling for the AAN transform.
+* aan_descale[v * 8 + u] = 1 / (8 * s(u) * s(v)), where s(0) = 1 and s(k) = sqrt(2) * cos(k * PI / 16).
+*/
+const float aan_descale[64] = {
+    0.125000000f, 0.090119978f, 0.095670858f, 0.106303762f, 0.125000000f, 0.159094823f, 0.230969883f, 0.453063723f,
+    0.090119978f, 0.064972883f, 0.068974845f, 0.076640741f, 0.090119978f, 0.114700975f, 0.166520006f, 0.326640741f,
+    0.095670858f, 0.068974845f, 0.073223305f, 0.081361377f, 0.095670858f, 0.121765906f, 0.176776695f, 0.346759961f,
+    0.106303762f, 0.076640741f, 0.081361377f, 0.090403918f, 0.106303762f, 0.135299025f, 0.196423740f, 0.385299025f,
+    0.125000000f, 0.090119978f, 0.095670858f, 0.106303762f, 0.125000000f, 0.159094823f, 0.230969883f, 0.453063723f,
+    0.159094823f, 0.114700975f, 0.121765906f, 0.135299025f, 0.159094823f, 0.202489301f, 0.293968901f, 0.576640741f,
+    0.230969883f, 0.166520006f, 0.176776695f, 0.196423740f, 0.230969883f, 0.293968901f, 0.426776695f, 0.837152602f,
+    0.453063723f, 0.326640741f, 0.346759961f, 0.385299025f, 0.453063723f, 0.576640741f, 0.837152602f, 1.642133898f
+};
+
+/*
+* Inverse DCT basis: idct_basis[x * 8 + u] = c(u) / 2 * cos((2x + 1) * u * PI / 16), c(0) = 1 / sqrt(2), else 1.
+*/
+static const float idct_basis[64] = {
+    0.353553391f, 0.490392640f, 0.461939766f, 0.415734806f, 0.353553391f, 0.277785117f, 0.191341716f, 0.097545161f,
+    0.353553391f, 0.415734806f, 0.191341716f, -0.097545161f, -0.353553391f, -0.490392640f, -0.461939766f, -0.277785117f,
+    0.353553391f, 0.277785117f, -0.191341716f, -0.490392640f, -0.353553391f, 0.097545161f, 0.461939766f, 0.415734806f,
+    0.353553391f, 0.097545161f, -0.461939766f, -0.277785117f, 0.353553391f, 0.415734806f, -0.191341716f, -0.490392640f,
+    0.353553391f, -0.097545161f, -0.461939766f, 0.277785117f, 0.353553391f, -0.415734806f, -0.191341716f, 0.490392640f,
+    0.353553391f, -0.277785117f, -0.191341716f, 0.490392640f, -0.353553391f, -0.097545161f, 0.461939766f, -0.415734806f,
+    0.353553391f, -0.415734806f, 0.191341716f, 0.097545161f, -0.353553391f, 0.490392640f, -0.461939766f, 0.277785117f,
+    0.353553391f, -0.490392640f, 0.461939766f, -0.415734806f, 0.353553391f, -0.277785117f, 0.191341716f, -0.097545161f
+};
+
 
 void center_around_zero(float* grayscale_values, uint32_t width, uint32_t height) {
     for (uint32_t i = 0; i < width * height; i++) {
@@ -57,151 +87,171 @@ void perform_dct_one_block(float *block, float *out_dct_block) {
 
 }
 
-void quantize_block(float *dct_block, int16_t* out_quantized_block) {
-    for(int i = 0; i < 64; i++) {
-        out_quantized_block[i] = (int16_t)roundf(dct_block[i] / std_lum_qt[i]);         // rounding to nearest integer
-    }
-}
+/*
+* 1D AAN forward DCT on 8 elements spaced 'stride' apart, in-place.
+* Produces coefficients scaled by s(k) * sqrt(8) (see aan_descale).
+*/
+static inline void aan_1d(float *d, int stride) {
+    float tmp0 = d[0 * stride] + d[7 * stride];
+    float tmp7 = d[0 * stride] - d[7 * stride];
+    float tmp1 = d[1 * stride] + d[6 * stride];
+    float tmp6 = d[1 * stride] - d[6 * stride];
+    float tmp2 = d[2 * stride] + d[5 * stride];
+    float tmp5 = d[2 * stride] - d[5 * stride];
+    float tmp3 = d[3 * stride] + d[4 * stride];
+    float tmp4 = d[3 * stride] - d[4 * stride];
 
-void perform_dct(float *blocks, uint32_t blocks_w, uint32_t blocks_h, float *out_dct_blocks) {
-    uint32_t total_blocks = blocks_w * blocks_h;
+    // Even part
+    float tmp10 = tmp0 + tmp3;
+    float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
 
-    /* Process each block */
-    for(uint32_t b = 0; b < total_blocks; b++) {
-        perform_dct_one_block(blocks + (b * 64), out_dct_blocks + (b * 64));
-    }
+    d[0 * stride] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+
+    float z1 = (tmp12 + tmp13) * 0.707106781f;          // c4
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    float z5 = (tmp10 - tmp12) * 0.382683433f;          // c6
+    float z2 = 0.541196100f * tmp10 + z5;               // c2 - c6
+    float z4 = 1.306562965f * tmp12 + z5;               // c2 + c6
+    float z3 = tmp11 * 0.707106781f;                    // c4
+
+    float z11 = tmp7 + z3;
+    float z13 = tmp7 - z3;
+
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[1 * stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
 }
 
-void zigzag_order(const int16_t *input_block, int16_t *output_block) {
-    /*
-    * Instead of computing the zigzag order on the fly, we use a predefined mapping.
-    */
-    const uint8_t zigzag_map[64] = {
-     0,  1,  8, 16,  9,  2,  3, 10,
-    17, 24, 32, 25, 18, 11,  4,  5,
-    12, 19, 26, 33, 40, 48, 41, 34,
-    27, 20, 13,  6,  7, 14, 21, 28,
-    35, 42, 49, 56, 57, 50, 43, 36,
-    29, 22, 15, 23, 30, 37, 44, 51,
-    58, 59, 52, 45, 38, 31, 39, 46,
-    53, 60, 61, 54, 47, 55, 62, 63
-    };
+void perform_dct_one_block_aan(const float *block, float *out_dct_block) {
+    float ws[64];
 
     for(int i = 0; i < 64; i++) {
-        output_block[i] = input_block[zigzag_map[i]];
+        ws[i] = block[i];
     }
-}
 
-void bw_write(BitWriter *bw, uint32_t code, int length) {
-    for (int i = length - 1; i >= 0; i--) {
-        // Isolate the i-th bit from the code
-        uint8_t bit = (code >> i) & 1;
-        
-        // Write it to the current byte in the BitWriter
-        if (bit) {
-            // Write 1 to the current position using shifting and OR
-            bw->current |= (1 << (7 - bw->bit_pos));
-        }
-        
-        // Move to the next bit position
-        bw->bit_pos++;
-        
-        // Check if we have filled the current byte. If so, write it to the buffer, reset current byte and bit position.
-        if (bw->bit_pos == 8) {
-            bw_put_byte(bw, bw->current);           // delegate writing to bw_put_byte so byte stuffing is performed
-            bw->current = 0;
-            bw->bit_pos = 0;
-        }
+    // Rows first (horizontal frequencies u), then columns (vertical frequencies v)
+    for(int y = 0; y < 8; y++) {
+        aan_1d(ws + y * 8, 1);
+    }
+    for(int x = 0; x < 8; x++) {
+        aan_1d(ws + x, 8);
+    }
+
+    for(int i = 0; i < 64; i++) {
+        out_dct_block[i] = ws[i] * aan_descale[i];
     }
 }
 
-void bw_put_byte(BitWriter *bw, uint8_t val) {
-    bw->buffer[bw->byte_pos++] = val;
+/*
+* Scales a base table (natural order) for a quality factor and fills every form of 'table'.
+*/
+static void scale_quant_table(QUANT_TABLE *table, const uint8_t *base, int quality) {
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
 
-    if(val == 0xFF)
-        bw->buffer[bw->byte_pos++] = 0x00;              // byte stuff so decoder can distinguish markers and payload
-}
+    // IJG scaling: percentage applied to the base table
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
 
-VLI get_vli(int16_t value) {
-    VLI vli;
-    int16_t temp = value;
+    for(int i = 0; i < 64; i++) {
+        int value = (base[i] * scale + 50) / 100;
+        if (value < 1) value = 1;
+        if (value > 255) value = 255;              // baseline DQT holds 8-bit values
 
-    if(value < 0) {
-        value = -value;
-        temp--;             // transform 2's complement to 1's complement
+        table->natural[i] = (uint8_t)value;
+        table->divisor[i] = (float)value;
     }
 
-    // Calculate number of bits needed
-    // Calculation is done by shifting right until value becomes 0
-    // This is why we work with absolute value - we only care about magnitude here
-    uint8_t nbits = 0;
-    while (value > 0) {
-        nbits++;
-        value >>= 1;
+    for(int i = 0; i < 64; i++) {
+        table->zigzag[i] = table->natural[zigzag_map[i]];
     }
+}
 
-    vli.len = nbits;
-    vli.bits = (temp & ((1 << nbits) - 1)); // Mask to get the lower nbits
-    return vli;
+void init_quant_table(QUANT_TABLE *table, int quality) {
+    scale_quant_table(table, std_lum_qt, quality);
 }
 
-int16_t encode_coefficients(int16_t *dct_block, int16_t prev_dc
-                            , BitWriter* bw) {
-    
-    // Predictive DC encoding
-    int16_t diff = dct_block[0] - prev_dc;
-    VLI vli = get_vli(diff);
-    
-    // Huffman DC encoding
-    HuffmanCode hc = huff_dc_lum[vli.len];
-    bw_write(bw, hc.code, hc.len);             // write DC Huffman code into bitstream
-    
-    if (vli.len > 0) {
-        bw_write(bw, vli.bits, vli.len);       // write DC VLI bits into bitstream
+void init_chroma_quant_table(QUANT_TABLE *table, int quality) {
+    scale_quant_table(table, std_chrom_qt, quality);
+}
+
+void quantize_block(float *dct_block, const QUANT_TABLE *qt, int16_t* out_quantized_block) {
+    for(int i = 0; i < 64; i++) {
+        out_quantized_block[i] = (int16_t)roundf(dct_block[i] / qt->divisor[i]);         // rounding to nearest integer
     }
+}
 
-    int zeros_count = 0;
-    
-    for (int i = 1; i < 64; i++) {              // Skip DC component, start from AC components
-        int16_t val = dct_block[i];
-
-        if (val == 0) {
-            zeros_count++;
-        } else {
-            // Handle any preceding zeros
-            while (zeros_count > 15) {
-                // ZRL (Zero Run Length): 16 continuous zeros
-                // Symbol is 0xF0
-                // We perform Huffman encoding for ZRL
-                bw_write(bw, huff_ac_lum[0xF0].code, huff_ac_lum[0xF0].len);
-                zeros_count -= 16;
+void perform_idct_one_block(const float *dct_block, float *out_block) {
+    float rows[64];
+
+    // Rows: rows[v][x] = sum over u of F(u, v) * basis(x, u)
+    for (int v = 0; v < 8; v++) {
+        for (int x = 0; x < 8; x++) {
+            float sum = 0.0f;
+            for (int u = 0; u < 8; u++) {
+                sum += dct_block[v * 8 + u] * idct_basis[x * 8 + u];
             }
+            rows[v * 8 + x] = sum;
+        }
+    }
 
-            // Get VLI for the non-zero value
-            vli = get_vli(val);
-            
-            // Build the symbol: (RUNLENGTH << 4) | SIZE
-            uint8_t symbol = (zeros_count << 4) | vli.len;
-            
-            // Get Huffman code for the symbol
-            bw_write(bw, huff_ac_lum[symbol].code, huff_ac_lum[symbol].len);
-            
-            // Write the actual bits of the value
-            bw_write(bw, vli.bits, vli.len);
-            
-            zeros_count = 0; 
+    // Columns: out[y][x] = sum over v of rows[v][x] * basis(y, v)
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            float sum = 0.0f;
+            for (int v = 0; v < 8; v++) {
+                sum += rows[v * 8 + x] * idct_basis[y * 8 + v];
+            }
+            out_block[y * 8 + x] = sum;
+        }
+    }
+}
+
+void perform_dct(float *blocks, uint32_t blocks_w, uint32_t blocks_h, float *out_dct_blocks, DCT_METHOD method) {
+    uint32_t total_blocks = blocks_w * blocks_h;
+
+    /* Process each block */
+    if (method == DCT_METHOD_EXACT) {
+        for(uint32_t b = 0; b < total_blocks; b++) {
+            perform_dct_one_block(blocks + (b * 64), out_dct_blocks + (b * 64));
+        }
+    } else {
+        const KERNEL_TABLE *kernels = get_kernels();
+        for(uint32_t b = 0; b < total_blocks; b++) {
+            kernels->dct_float(blocks + (b * 64), out_dct_blocks + (b * 64));
         }
     }
+}
+
+/*
+* Zigzag position -> natural (row-major) index.
+*/
+const uint8_t zigzag_map[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
 
-    // EOB handling
-    if (zeros_count > 0) {
-        // If there are trailing zeros, write EOB (symbol 0x00)
-        bw_write(bw, huff_ac_lum[0x00].code, huff_ac_lum[0x00].len);
+void zigzag_order(const int16_t *input_block, int16_t *output_block) {
+    /*
+    * Instead of computing the zigzag order on the fly, we use a predefined mapping (zigzag_map).
+    */
+    for(int i = 0; i < 64; i++) {
+        output_block[i] = input_block[zigzag_map[i]];
     }
-        
-    // if (bw.bit_pos > 0) {
-    //     bw.buffer[bw.byte_pos++] = bw.current;      // Flush out the last byte if it has remaining bits
-    // }
-    
-    return dct_block[0];                       // Return current DC for next block's prediction       
 }
@@ -0,0 +1,237 @@
+#include "dct.h"
+#include <stdlib.h>
+#include <math.h>
+
+/*
+* Integer forward DCT implementations, modelled on the IJG libjpeg "islow" and "ifast" transforms.
+* Both take centered 8-bit samples and produce scaled int32 coefficients; the scaling is removed
+* by the matching integer quantization divisors (see init_int_quant_table).
+*/
+
+/* --- islow: Loeffler/Ligtenberg/Moschytz, 13-bit constants --- */
+
+#define ISLOW_CONST_BITS 13
+#define ISLOW_PASS1_BITS 2
+
+#define FIX_0_298631336 ((int32_t)2446)
+#define FIX_0_390180644 ((int32_t)3196)
+#define FIX_0_541196100 ((int32_t)4433)
+#define FIX_0_765366865 ((int32_t)6270)
+#define FIX_0_899976223 ((int32_t)7373)
+#define FIX_1_175875602 ((int32_t)9633)
+#define FIX_1_501321110 ((int32_t)12299)
+#define FIX_1_847759065 ((int32_t)15137)
+#define FIX_1_961570560 ((int32_t)16069)
+#define FIX_2_053119869 ((int32_t)16819)
+#define FIX_2_562915447 ((int32_t)20995)
+#define FIX_3_072711026 ((int32_t)25172)
+
+// Right shift with rounding
+#define DESCALE(x, n) (((x) + ((int32_t)1 << ((n) - 1))) >> (n))
+
+/*
+* One islow pass over 8 elements spaced 'stride' apart.
+* Pass 1 (rows) keeps PASS1_BITS of extra precision, pass 2 (columns) removes it.
+*/
+static inline void islow_1d(int32_t *d, int stride, int pass) {
+    int32_t tmp0 = d[0 * stride] + d[7 * stride];
+    int32_t tmp7 = d[0 * stride] - d[7 * stride];
+    int32_t tmp1 = d[1 * stride] + d[6 * stride];
+    int32_t tmp6 = d[1 * stride] - d[6 * stride];
+    int32_t tmp2 = d[2 * stride] + d[5 * stride];
+    int32_t tmp5 = d[2 * stride] - d[5 * stride];
+    int32_t tmp3 = d[3 * stride] + d[4 * stride];
+    int32_t tmp4 = d[3 * stride] - d[4 * stride];
+
+    int shift = pass == 1 ? ISLOW_CONST_BITS - ISLOW_PASS1_BITS : ISLOW_CONST_BITS + ISLOW_PASS1_BITS;
+
+    // Even part
+    int32_t tmp10 = tmp0 + tmp3;
+    int32_t tmp13 = tmp0 - tmp3;
+    int32_t tmp11 = tmp1 + tmp2;
+    int32_t tmp12 = tmp1 - tmp2;
+
+    if (pass == 1) {
+        d[0 * stride] = (tmp10 + tmp11) * (1 << ISLOW_PASS1_BITS);
+        d[4 * stride] = (tmp10 - tmp11) * (1 << ISLOW_PASS1_BITS);
+    } else {
+        d[0 * stride] = DESCALE(tmp10 + tmp11, ISLOW_PASS1_BITS);
+        d[4 * stride] = DESCALE(tmp10 - tmp11, ISLOW_PASS1_BITS);
+    }
+
+    int32_t z1 = (tmp12 + tmp13) * FIX_0_541196100;
+    d[2 * stride] = DESCALE(z1 + tmp13 * FIX_0_765366865, shift);
+    d[6 * stride] = DESCALE(z1 - tmp12 * FIX_1_847759065, shift);
+
+    // Odd part
+    z1 = tmp4 + tmp7;
+    int32_t z2 = tmp5 + tmp6;
+    int32_t z3 = tmp4 + tmp6;
+    int32_t z4 = tmp5 + tmp7;
+    int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+    tmp4 *= FIX_0_298631336;
+    tmp5 *= FIX_2_053119869;
+    tmp6 *= FIX_3_072711026;
+    tmp7 *= FIX_1_501321110;
+    z1 *= -FIX_0_899976223;
+    z2 *= -FIX_2_562915447;
+    z3 *= -FIX_1_961570560;
+    z4 *= -FIX_0_390180644;
+
+    z3 += z5;
+    z4 += z5;
+
+    d[7 * stride] = DESCALE(tmp4 + z1 + z3, shift);
+    d[5 * stride] = DESCALE(tmp5 + z2 + z4, shift);
+    d[3 * stride] = DESCALE(tmp6 + z2 + z3, shift);
+    d[1 * stride] = DESCALE(tmp7 + z1 + z4, shift);
+}
+
+void perform_dct_one_block_islow(const int16_t *block, int32_t *out_dct_block) {
+    for(int i = 0; i < 64; i++) {
+        out_dct_block[i] = block[i];
+    }
+
+    for(int y = 0; y < 8; y++) {
+        islow_1d(out_dct_block + y * 8, 1, 1);
+    }
+    for(int x = 0; x < 8; x++) {
+        islow_1d(out_dct_block + x, 8, 2);
+    }
+}
+
+/* --- ifast: AAN with 8-bit constants, no rounding in multiplies --- */
+
+#define IFAST_CONST_BITS 8
+
+#define FIX_0_382683433 ((int32_t)98)
+#define FIX_0_707106781 ((int32_t)181)
+#define FIX_1_306562965 ((int32_t)334)
+#define FIX_0_541196100_FAST ((int32_t)139)
+
+#define IFAST_MULTIPLY(var, c) (((var) * (c)) >> IFAST_CONST_BITS)
+
+static inline void ifast_1d(int32_t *d, int stride) {
+    int32_t tmp0 = d[0 * stride] + d[7 * stride];
+    int32_t tmp7 = d[0 * stride] - d[7 * stride];
+    int32_t tmp1 = d[1 * stride] + d[6 * stride];
+    int32_t tmp6 = d[1 * stride] - d[6 * stride];
+    int32_t tmp2 = d[2 * stride] + d[5 * stride];
+    int32_t tmp5 = d[2 * stride] - d[5 * stride];
+    int32_t tmp3 = d[3 * stride] + d[4 * stride];
+    int32_t tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    int32_t tmp10 = tmp0 + tmp3;
+    int32_t tmp13 = tmp0 - tmp3;
+    int32_t tmp11 = tmp1 + tmp2;
+    int32_t tmp12 = tmp1 - tmp2;
+
+    d[0 * stride] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+
+    int32_t z1 = IFAST_MULTIPLY(tmp12 + tmp13, FIX_0_707106781);
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    int32_t z5 = IFAST_MULTIPLY(tmp10 - tmp12, FIX_0_382683433);
+    int32_t z2 = IFAST_MULTIPLY(tmp10, FIX_0_541196100_FAST) + z5;
+    int32_t z4 = IFAST_MULTIPLY(tmp12, FIX_1_306562965) + z5;
+    int32_t z3 = IFAST_MULTIPLY(tmp11, FIX_0_707106781);
+
+    int32_t z11 = tmp7 + z3;
+    int32_t z13 = tmp7 - z3;
+
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[1 * stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+void perform_dct_one_block_ifast(const int16_t *block, int32_t *out_dct_block) {
+    for(int i = 0; i < 64; i++) {
+        out_dct_block[i] = block[i];
+    }
+
+    for(int y = 0; y < 8; y++) {
+        ifast_1d(out_dct_block + y * 8, 1);
+    }
+    for(int x = 0; x < 8; x++) {
+        ifast_1d(out_dct_block + x, 8);
+    }
+}
+
+void perform_dct_int(float *blocks, uint32_t blocks_w, uint32_t blocks_h, int32_t *out_dct_blocks, DCT_METHOD method) {
+    uint32_t total_blocks = blocks_w * blocks_h;
+    int16_t samples[64];
+
+    for(uint32_t b = 0; b < total_blocks; b++) {
+        // Samples are 8-bit values centered around zero, so rounding recovers them exactly enough for 16 bits
+        for(int i = 0; i < 64; i++) {
+            samples[i] = (int16_t)roundf(blocks[b * 64 + i]);
+        }
+
+        if (method == DCT_METHOD_IFAST) {
+            perform_dct_one_block_ifast(samples, out_dct_blocks + (b * 64));
+        } else {
+            perform_dct_one_block_islow(samples, out_dct_blocks + (b * 64));
+        }
+    }
+}
+
+/*
+* AAN scale factors s(u) * s(v) scaled by 2^14, used to fold the ifast output scaling into the divisors.
+*/
+static const uint16_t aan_scales[64] = {
+    16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+    22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
+    21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
+    19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
+    16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+    12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
+     8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
+     4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247
+};
+
+void init_int_quant_table(INT_QUANT_TABLE *table, const uint8_t *qt, DCT_METHOD method) {
+    for(int i = 0; i < 64; i++) {
+        uint32_t divisor;
+
+        if (method == DCT_METHOD_IFAST) {
+            divisor = ((uint32_t)qt[i] * aan_scales[i] + (1u << 10)) >> 11;     // qt * s(u) * s(v) * 8
+        } else {
+            divisor = (uint32_t)qt[i] << 3;                                     // islow output is scaled by 8
+        }
+        if (divisor == 0) divisor = 1;
+
+        // shift = 16 + floor(log2(divisor)) keeps the reciprocal within 17 bits and the product within 32 bits
+        uint32_t log2_div = 0;
+        while ((divisor >> (log2_div + 1)) != 0) log2_div++;
+
+        uint32_t shift = 16 + log2_div;
+
+        table->divisor[i] = (uint16_t)divisor;
+        table->bias[i] = (uint16_t)(divisor >> 1);
+        table->recip[i] = (uint32_t)((((uint64_t)1 << shift) + divisor - 1) / divisor);     // ceil(2^shift / divisor)
+        table->shift[i] = (uint8_t)shift;
+    }
+}
+
+void quantize_block_int(const int32_t *dct_block, const INT_QUANT_TABLE *table, int16_t *out_quantized_block) {
+    for(int i = 0; i < 64; i++) {
+        int32_t val = dct_block[i];
+        int32_t sign = val >> 31;                                   // 0 or -1
+        uint32_t magnitude = (uint32_t)((val ^ sign) - sign);
+
+        // Exact round(|val| / divisor) for |val| < 2^15, halves rounded away from zero like roundf
+        uint32_t q = ((magnitude + table->bias[i]) * table->recip[i]) >> table->shift[i];
+
+        out_quantized_block[i] = (int16_t)(((int32_t)q ^ sign) - sign);
+    }
+}
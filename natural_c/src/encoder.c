@@ -0,0 +1,126 @@
+#include "encoder.h"
+#include "entropy.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <math.h>
+
+// Blocks quantized per parallel task
+#define QUANTIZE_CHUNK_BLOCKS 1024
+
+int compute_dct_coefficients(const ROW_SOURCE *source, uint32_t width, uint32_t height, DCT_METHOD method,
+                             const KERNEL_TABLE *kernels, float *workspace, DCT_COEFFICIENTS *out) {
+    uint32_t blocks_w = (width + 7) / 8;
+    uint32_t blocks_h = (height + 7) / 8;
+    uint32_t padded_w = blocks_w * 8;
+    int int_dct = method == DCT_METHOD_ISLOW || method == DCT_METHOD_IFAST;
+
+    out->method = method;
+    out->blocks_w = blocks_w;
+    out->blocks_h = blocks_h;
+    out->block_count = blocks_w * blocks_h;
+
+    float block[64];
+    int16_t samples[64];
+
+    for (uint32_t by = 0; by < blocks_h; by++) {
+        if (load_y_rows(source, by, width, kernels, workspace) != 0) {
+            return -1;
+        }
+
+        for (uint32_t bx = 0; bx < blocks_w; bx++) {
+            size_t b = (size_t)by * blocks_w + bx;
+            for (uint32_t y = 0; y < 8; y++) {
+                for (uint32_t x = 0; x < 8; x++) {
+                    block[y * 8 + x] = workspace[y * padded_w + bx * 8 + x];
+                }
+            }
+
+            // Same transforms as the fused pipeline, so both produce identical scans
+            if (int_dct) {
+                for (int i = 0; i < 64; i++) {
+                    samples[i] = (int16_t)roundf(block[i]);
+                }
+                if (method == DCT_METHOD_IFAST) {
+                    perform_dct_one_block_ifast(samples, out->coeffs_int + b * 64);
+                } else {
+                    perform_dct_one_block_islow(samples, out->coeffs_int + b * 64);
+                }
+            } else if (method == DCT_METHOD_EXACT) {
+                perform_dct_one_block(block, out->coeffs + b * 64);
+            } else {
+                kernels->dct_float(block, out->coeffs + b * 64);
+            }
+        }
+    }
+    return 0;
+}
+
+void free_dct_coefficients(DCT_COEFFICIENTS *coeffs) {
+    free(coeffs->coeffs);
+    free(coeffs->coeffs_int);
+    coeffs->coeffs = NULL;
+    coeffs->coeffs_int = NULL;
+}
+
+typedef struct {
+    const KERNEL_TABLE *kernels;
+    const DCT_COEFFICIENTS *coeffs;
+    const QUANT_TABLE *qt;
+    const INT_QUANT_TABLE *int_qt;      // set for integer DCT methods
+    int16_t *zigzag_blocks;
+} QUANTIZE_JOB;
+
+/*
+* Quantizes and zigzag-orders one chunk of DCT blocks.
+*/
+static void quantize_chunk_task(void *ctx, uint32_t chunk) {
+    const QUANTIZE_JOB *job = (const QUANTIZE_JOB*)ctx;
+    uint32_t first = chunk * QUANTIZE_CHUNK_BLOCKS;
+    uint32_t last = first + QUANTIZE_CHUNK_BLOCKS;
+    if (last > job->coeffs->block_count) last = job->coeffs->block_count;
+
+    int16_t quantized_block[64];
+
+    for (uint32_t i = first; i < last; i++) {
+        if (job->int_qt) {
+            job->kernels->quantize_int(&job->coeffs->coeffs_int[(size_t)i * 64], job->int_qt, quantized_block);
+        } else {
+            job->kernels->quantize(&job->coeffs->coeffs[(size_t)i * 64], job->qt, quantized_block);
+        }
+
+        job->kernels->zigzag(quantized_block, &job->zigzag_blocks[(size_t)i * 64]);
+    }
+}
+
+void quantize_coefficients(const DCT_COEFFICIENTS *coeffs, const QUANT_TABLE *qt, const KERNEL_TABLE *kernels,
+                           int threads, int16_t *out_zigzag_blocks) {
+    INT_QUANT_TABLE int_qt;
+    QUANTIZE_JOB job = { kernels, coeffs, qt, NULL, out_zigzag_blocks };
+
+    if (coeffs->coeffs_int != NULL) {
+        init_int_quant_table(&int_qt, qt->natural, coeffs->method);
+        job.int_qt = &int_qt;
+    }
+
+    uint32_t chunk_count = (coeffs->block_count + QUANTIZE_CHUNK_BLOCKS - 1) / QUANTIZE_CHUNK_BLOCKS;
+    parallel_for(chunk_count, threads, quantize_chunk_task, &job);
+}
+
+int select_huffman_tables(const int16_t *zigzag_blocks, uint32_t block_count, const SCAN_SETTINGS *settings,
+                          HUFFMAN_TABLE_DATA *huffman_data, HUFFMAN_TABLES *tables) {
+    if (!settings->optimize_huffman) {
+        *tables = std_lum_huffman;
+        return 0;
+    }
+
+    // Two-pass coding: symbol statistics from the quantized blocks, then tables built for this image
+    uint32_t dc_freq[16];
+    uint32_t ac_freq[256];
+
+    if (gather_block_statistics(zigzag_blocks, block_count, settings->restart_interval, settings->threads,
+                                settings->entropy, dc_freq, ac_freq) != 0) {
+        return -1;
+    }
+    build_optimal_huffman_tables(dc_freq, ac_freq, huffman_data, tables);
+    return 0;
+}
@@ -0,0 +1,380 @@
+#include "dct.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+/*
+* Host entropy coder, following the C7x encoding.c design:
+*   - 64-bit bit accumulator, flushed 32 bits at a time
+*   - Huffman code and VLI bits written with a single call
+*   - AC scan driven by a nonzero bitmask walked with count-trailing-zeros
+*/
+
+// Non-zero if any byte of x is 0xFF (zero-byte test on ~x)
+#define HAS_FF_BYTE(x) ((((~(x)) - 0x01010101u) & (x) & 0x80808080u) != 0)
+
+// Bytes one accumulator word can produce (4, each possibly followed by a stuffed 0x00)
+#define BW_WORD_BYTES 8
+
+void bw_init(BitWriter *bw, uint8_t *buffer, uint32_t capacity) {
+    bw->buffer = buffer;
+    bw->byte_pos = 0;
+    bw->capacity = capacity;
+    bw->bit_pos = 0;
+    bw->current = 0;
+    bw->stuffing = 1;
+    bw->failed = 0;
+    bw->drained = 0;
+    bw->sink = NULL;
+}
+
+void bw_init_raw(BitWriter *bw, uint8_t *buffer, uint32_t capacity) {
+    bw_init(bw, buffer, capacity);
+    bw->stuffing = 0;
+}
+
+void bw_init_sink(BitWriter *bw, const BW_SINK *sink) {
+    bw_init(bw, NULL, 0);
+    bw->sink = sink;
+    bw_reserve(bw, BW_MIN_CAPACITY);
+}
+
+/*
+* Slow path of bw_reserve: asks the sink for room, and drops the buffered bytes if there is none.
+*/
+static int bw_make_room(BitWriter *bw, uint32_t needed) {
+    if (bw->sink != NULL && bw->sink->drain(bw->sink->ctx, bw, needed) == 0 &&
+        bw->capacity - bw->byte_pos >= needed) {
+        return 0;
+    }
+
+    bw->failed = 1;
+    bw->drained += bw->byte_pos;
+    bw->byte_pos = 0;
+    if (bw->capacity < needed) {
+        bw->buffer = bw->spill;
+        bw->capacity = sizeof(bw->spill);
+    }
+    return -1;
+}
+
+int bw_reserve(BitWriter *bw, uint32_t bytes) {
+    if (bw->capacity - bw->byte_pos >= bytes) {
+        return 0;
+    }
+    return bw_make_room(bw, bytes);
+}
+
+static inline void bw_store_byte(BitWriter *bw, uint8_t val) {
+    bw->buffer[bw->byte_pos++] = val;
+
+    if(val == 0xFF && bw->stuffing)
+        bw->buffer[bw->byte_pos++] = 0x00;              // byte stuff so decoder can distinguish markers and payload
+}
+
+void bw_put_byte(BitWriter *bw, uint8_t val) {
+    bw_reserve(bw, 2);
+    bw_store_byte(bw, val);
+}
+
+void bw_write_bytes(BitWriter *bw, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        if (bw->byte_pos == bw->capacity) {
+            bw_reserve(bw, BW_MIN_CAPACITY);
+        }
+
+        size_t part = bw->capacity - bw->byte_pos;
+        if (part > length) part = length;
+
+        memcpy(bw->buffer + bw->byte_pos, data, part);
+        bw->byte_pos += (uint32_t)part;
+        data += part;
+        length -= part;
+    }
+}
+
+/*
+* Moves the upper 32 bits of the accumulator to the buffer.
+* The common case (no 0xFF byte) is 4 plain stores; stuffing takes the byte-wise path.
+*/
+static inline void bw_emit_word(BitWriter *bw) {
+    uint32_t word = (uint32_t)(bw->current >> 32);
+
+    if (bw->capacity - bw->byte_pos < BW_WORD_BYTES) {
+        bw_make_room(bw, BW_WORD_BYTES);
+    }
+    uint8_t *out = bw->buffer + bw->byte_pos;
+
+    if (!HAS_FF_BYTE(word) || !bw->stuffing) {
+        out[0] = (uint8_t)(word >> 24);
+        out[1] = (uint8_t)(word >> 16);
+        out[2] = (uint8_t)(word >> 8);
+        out[3] = (uint8_t)word;
+        bw->byte_pos += 4;
+    } else {
+        bw_store_byte(bw, (uint8_t)(word >> 24));
+        bw_store_byte(bw, (uint8_t)(word >> 16));
+        bw_store_byte(bw, (uint8_t)(word >> 8));
+        bw_store_byte(bw, (uint8_t)word);
+    }
+
+    bw->current <<= 32;
+    bw->bit_pos -= 32;
+}
+
+/*
+* Appends 'length' (0-32) bits, MSB first. Bits are kept left-aligned in the accumulator;
+* fewer than 32 are pending between calls, so a write never overflows 64 bits.
+*/
+static inline void bw_write_bits(BitWriter *bw, uint32_t code, int length) {
+    uint64_t bits = (uint64_t)code & (((uint64_t)1 << length) - 1);
+
+    bw->current |= bits << (64 - bw->bit_pos - length);
+    bw->bit_pos += length;
+
+    if (bw->bit_pos >= 32) {
+        bw_emit_word(bw);
+    }
+}
+
+void bw_write(BitWriter *bw, uint32_t code, int length) {
+    bw_write_bits(bw, code, length);
+}
+
+void bw_flush(BitWriter *bw) {
+    // Fewer than 32 bits are pending: at most 4 bytes, each possibly stuffed
+    bw_reserve(bw, BW_WORD_BYTES);
+
+    while (bw->bit_pos >= 8) {
+        bw_store_byte(bw, (uint8_t)(bw->current >> 56));
+        bw->current <<= 8;
+        bw->bit_pos -= 8;
+    }
+
+    // Remaining bits are padded with zeros
+    if (bw->bit_pos > 0) {
+        bw_store_byte(bw, (uint8_t)(bw->current >> 56));
+    }
+
+    bw->current = 0;
+    bw->bit_pos = 0;
+}
+
+int bw_finish(BitWriter *bw) {
+    bw_flush(bw);
+
+    if (bw->sink != NULL && bw->sink->drain(bw->sink->ctx, bw, 0) != 0) {
+        bw->failed = 1;
+    }
+    return bw->failed ? -1 : 0;
+}
+
+uint64_t bw_total_bytes(const BitWriter *bw) {
+    return bw->drained + bw->byte_pos;
+}
+
+void bw_restart(BitWriter *bw, uint32_t index) {
+    // Pad with 1-bits (F.1.2.3), the accumulator is then byte aligned and flushes without zero padding
+    // Skipped when already aligned: a zero-length write at bit_pos 0 would shift the accumulator by 64
+    int pad = (8 - (bw->bit_pos & 7)) & 7;
+    if (pad > 0) {
+        bw_write_bits(bw, (1u << pad) - 1, pad);
+    }
+    bw_flush(bw);
+
+    // Markers are not stuffed
+    bw_reserve(bw, 2);
+    bw->buffer[bw->byte_pos++] = 0xFF;
+    bw->buffer[bw->byte_pos++] = (uint8_t)(0xD0 + (index & 7));
+}
+
+VLI get_vli(int16_t value) {
+    VLI vli;
+    int32_t v = value;
+    uint32_t magnitude = (uint32_t)(v < 0 ? -v : v);
+
+    // Category = number of bits of the magnitude, bits = value in one's complement for negatives
+    vli.len = magnitude ? (uint8_t)(32 - __builtin_clz(magnitude)) : 0;
+    vli.bits = (uint16_t)((v + (v >> 31)) & ((1 << vli.len) - 1));
+    return vli;
+}
+
+/*
+* Bitmask with bit i set when block[i] != 0.
+*/
+static inline uint64_t nonzero_mask(const int16_t *block) {
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t zero_mask = 0;
+
+    // Compare 16 coefficients at a time, narrow the 16-bit results to bytes, collect one bit per coefficient
+    for (int i = 0; i < 64; i += 16) {
+        __m128i eq0 = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(block + i)), zero);
+        __m128i eq1 = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(block + i + 8)), zero);
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(eq0, eq1));
+        zero_mask |= (uint64_t)bits << i;
+    }
+
+    return ~zero_mask;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i++) {
+        mask |= (uint64_t)(block[i] != 0) << i;
+    }
+    return mask;
+#endif
+}
+
+/*
+* Walks one zigzag block and hands every (Huffman code << value length | value bits) to 'emit'.
+* Shared by the encoder and the dry-run counter; always inlined so 'emit' is a direct call.
+*/
+static inline __attribute__((always_inline))
+int16_t walk_coefficients(const int16_t *dct_block, int16_t prev_dc, const HUFFMAN_TABLES *tables,
+                          void (*emit)(void *sink, uint32_t code, int length), void *sink) {
+    const HuffmanCode *huff_dc = tables->dc;
+    const HuffmanCode *huff_ac = tables->ac;
+    
+    // Predictive DC encoding: category code and difference bits in one write
+    int32_t diff = (int32_t)dct_block[0] - prev_dc;
+    uint32_t magnitude = (uint32_t)(diff < 0 ? -diff : diff);
+    int len = magnitude ? 32 - __builtin_clz(magnitude) : 0;
+    uint32_t bits = (uint32_t)(diff + (diff >> 31)) & ((1u << len) - 1);
+
+    HuffmanCode hc = huff_dc[len];
+    emit(sink, ((uint32_t)hc.code << len) | bits, hc.len + len);
+
+    // Walk the nonzero AC coefficients only
+    uint64_t nz = nonzero_mask(dct_block) & ~1ULL;
+    const HuffmanCode huff_zrl = huff_ac[0xF0];
+    int last_k = 0;
+
+    while (nz != 0) {
+        int k = __builtin_ctzll(nz);
+        nz &= nz - 1;
+
+        int zero_run = k - last_k - 1;
+        while (zero_run > 15) {
+            // ZRL (Zero Run Length): 16 continuous zeros, symbol 0xF0
+            emit(sink, huff_zrl.code, huff_zrl.len);
+            zero_run -= 16;
+        }
+
+        int32_t val = dct_block[k];
+        magnitude = (uint32_t)(val < 0 ? -val : val);
+        len = 32 - __builtin_clz(magnitude);
+        bits = (uint32_t)(val + (val >> 31)) & ((1u << len) - 1);
+
+        // Symbol (RUNLENGTH << 4) | SIZE, Huffman code followed by the value bits
+        HuffmanCode ac_hc = huff_ac[(zero_run << 4) | len];
+        emit(sink, ((uint32_t)ac_hc.code << len) | bits, ac_hc.len + len);
+
+        last_k = k;
+    }
+
+    // EOB (symbol 0x00) if the block ends with zeros
+    if (last_k < 63) {
+        emit(sink, huff_ac[0x00].code, huff_ac[0x00].len);
+    }
+
+    return dct_block[0];                       // Return current DC for next block's prediction       
+}
+
+static inline __attribute__((always_inline)) void emit_to_writer(void *sink, uint32_t code, int length) {
+    bw_write_bits((BitWriter*)sink, code, length);
+}
+
+int16_t encode_coefficients(const int16_t *dct_block, int16_t prev_dc, const HUFFMAN_TABLES *tables, BitWriter* bw) {
+    return walk_coefficients(dct_block, prev_dc, tables, emit_to_writer, bw);
+}
+
+int16_t count_coefficient_symbols(const int16_t *dct_block, int16_t prev_dc, uint32_t *dc_freq, uint32_t *ac_freq) {
+    int32_t diff = (int32_t)dct_block[0] - prev_dc;
+    uint32_t magnitude = (uint32_t)(diff < 0 ? -diff : diff);
+    dc_freq[magnitude ? 32 - __builtin_clz(magnitude) : 0]++;
+
+    // Same walk as encode_coefficients, counting symbols instead of writing them
+    uint64_t nz = nonzero_mask(dct_block) & ~1ULL;
+    int last_k = 0;
+
+    while (nz != 0) {
+        int k = __builtin_ctzll(nz);
+        nz &= nz - 1;
+
+        int zero_run = k - last_k - 1;
+        while (zero_run > 15) {
+            ac_freq[0xF0]++;
+            zero_run -= 16;
+        }
+
+        int32_t val = dct_block[k];
+        magnitude = (uint32_t)(val < 0 ? -val : val);
+        ac_freq[(zero_run << 4) | (32 - __builtin_clz(magnitude))]++;
+
+        last_k = k;
+    }
+
+    if (last_k < 63) {
+        ac_freq[0x00]++;
+    }
+
+    return dct_block[0];
+}
+
+/*
+* Dry-run counterpart of the BitWriter: same accumulator and flushing, but a 32-bit word
+* only adds 4 bytes plus one per 0xFF byte it contains.
+*/
+void bc_init(BitCounter *bc) {
+    bc->bytes = 0;
+    bc->bit_pos = 0;
+    bc->current = 0;
+}
+
+static inline __attribute__((always_inline)) void bc_write_bits(BitCounter *bc, uint32_t code, int length) {
+    uint64_t bits = (uint64_t)code & (((uint64_t)1 << length) - 1);
+
+    bc->current |= bits << (64 - bc->bit_pos - length);
+    bc->bit_pos += length;
+
+    if (bc->bit_pos >= 32) {
+        uint32_t word = (uint32_t)(bc->current >> 32);
+        bc->bytes += 4;
+        if (HAS_FF_BYTE(word)) {
+            bc->bytes += ((word >> 24) == 0xFF) + (((word >> 16) & 0xFF) == 0xFF)
+                       + (((word >> 8) & 0xFF) == 0xFF) + ((word & 0xFF) == 0xFF);
+        }
+        bc->current <<= 32;
+        bc->bit_pos -= 32;
+    }
+}
+
+void bc_flush(BitCounter *bc) {
+    // Same as bw_flush: whole bytes, then a zero-padded partial byte
+    while (bc->bit_pos > 0) {
+        uint8_t byte = (uint8_t)(bc->current >> 56);
+        bc->bytes += 1 + (byte == 0xFF);
+        bc->current <<= 8;
+        bc->bit_pos = bc->bit_pos > 8 ? bc->bit_pos - 8 : 0;
+    }
+    bc->current = 0;
+}
+
+void bc_restart(BitCounter *bc) {
+    int pad = (8 - (bc->bit_pos & 7)) & 7;
+    if (pad > 0) {
+        bc_write_bits(bc, (1u << pad) - 1, pad);
+    }
+    bc_flush(bc);
+    bc->bytes += 2;                            // RSTn marker
+}
+
+static inline __attribute__((always_inline)) void emit_to_counter(void *sink, uint32_t code, int length) {
+    bc_write_bits((BitCounter*)sink, code, length);
+}
+
+int16_t dry_run_coefficients(const int16_t *dct_block, int16_t prev_dc, const HUFFMAN_TABLES *tables, BitCounter *bc) {
+    return walk_coefficients(dct_block, prev_dc, tables, emit_to_counter, bc);
+}
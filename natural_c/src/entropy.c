@@ -0,0 +1,425 @@
+#include "entropy.h"
+#include "parallel.h"
+#include "output_sink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Chunks per thread, so intervals of uneven cost still balance out
+#define CHUNKS_PER_THREAD 4
+
+// Marker-free slices are not split below this many blocks; smaller images are coded serially
+#define MIN_SLICE_BLOCKS 256
+
+// Blocks per symbol counting task
+#define STATISTICS_CHUNK_BLOCKS 4096
+
+typedef struct {
+    const int16_t *blocks;
+    uint32_t block_count;
+    uint32_t restart_interval;
+    uint32_t interval_count;
+    uint32_t intervals_per_chunk;
+    const HUFFMAN_TABLES *tables;
+    ENTROPY_CHUNK *chunks;
+} RESTART_JOB;
+
+typedef struct {
+    const int16_t *blocks;
+    uint32_t block_count;
+    uint32_t blocks_per_slice;
+    const HUFFMAN_TABLES *tables;
+    ENTROPY_CHUNK *slices;
+    uint64_t *slice_bits;       // number of valid bits in each slice
+} SLICE_JOB;
+
+int entropy_workspace_reserve(ENTROPY_WORKSPACE *workspace, uint32_t block_count, int threads) {
+    uint32_t chunk_count = (uint32_t)(threads > 1 ? threads : 1) * CHUNKS_PER_THREAD;
+    uint32_t freq_count = (block_count + STATISTICS_CHUNK_BLOCKS - 1) / STATISTICS_CHUNK_BLOCKS;
+
+    if (chunk_count > workspace->chunk_capacity) {
+        uint64_t *chunk_bits = (uint64_t*)realloc(workspace->chunk_bits, chunk_count * sizeof(uint64_t));
+        if (chunk_bits == NULL) {
+            printf("Error: Not enough memory for entropy coding chunks.\n");
+            return -1;
+        }
+        workspace->chunk_bits = chunk_bits;
+
+        ENTROPY_CHUNK *chunks = (ENTROPY_CHUNK*)realloc(workspace->chunks, chunk_count * sizeof(ENTROPY_CHUNK));
+        if (chunks == NULL) {
+            printf("Error: Not enough memory for entropy coding chunks.\n");
+            return -1;
+        }
+        // New chunks start without a buffer, the existing ones keep theirs
+        memset(chunks + workspace->chunk_capacity, 0, (chunk_count - workspace->chunk_capacity) * sizeof(ENTROPY_CHUNK));
+        workspace->chunks = chunks;
+        workspace->chunk_capacity = chunk_count;
+    }
+
+    if (freq_count > workspace->freq_capacity) {
+        uint32_t (*dc_freq)[16] = realloc(workspace->dc_freq, freq_count * sizeof(*dc_freq));
+        if (dc_freq != NULL) workspace->dc_freq = dc_freq;
+        uint32_t (*ac_freq)[256] = realloc(workspace->ac_freq, freq_count * sizeof(*ac_freq));
+        if (ac_freq != NULL) workspace->ac_freq = ac_freq;
+        if (dc_freq == NULL || ac_freq == NULL) {
+            printf("Error: Not enough memory for symbol statistics.\n");
+            return -1;
+        }
+        workspace->freq_capacity = freq_count;
+    }
+    return 0;
+}
+
+void entropy_workspace_free(ENTROPY_WORKSPACE *workspace) {
+    for (uint32_t c = 0; c < workspace->chunk_capacity; c++) {
+        growable_buffer_free(&workspace->chunks[c].buffer);
+    }
+    free(workspace->chunks);
+    free(workspace->chunk_bits);
+    free(workspace->dc_freq);
+    free(workspace->ac_freq);
+    memset(workspace, 0, sizeof(*workspace));
+}
+
+/*
+* Encodes restart interval 'index'. Every interval but the last one of the image is closed with RSTn.
+*/
+static void encode_interval(const RESTART_JOB *job, uint32_t index, BitWriter *bw) {
+    uint32_t first = index * job->restart_interval;
+    uint32_t last = first + job->restart_interval;
+    if (last > job->block_count) last = job->block_count;
+
+    int16_t prev_dc = 0;
+    for (uint32_t i = first; i < last; i++) {
+        prev_dc = encode_coefficients(&job->blocks[(size_t)i * 64], prev_dc, job->tables, bw);
+    }
+
+    if (index + 1 < job->interval_count) {
+        bw_restart(bw, index);
+    }
+}
+
+static void encode_chunk_task(void *ctx, uint32_t chunk_index) {
+    RESTART_JOB *job = (RESTART_JOB*)ctx;
+    ENTROPY_CHUNK *chunk = &job->chunks[chunk_index];
+
+    uint32_t first = chunk_index * job->intervals_per_chunk;
+    uint32_t last = first + job->intervals_per_chunk;
+    if (last > job->interval_count) last = job->interval_count;
+
+    BW_SINK sink;
+    BitWriter bw;
+    init_growable_sink(&sink, &chunk->buffer);
+    bw_init_sink(&bw, &sink);
+
+    for (uint32_t i = first; i < last; i++) {
+        encode_interval(job, i, &bw);
+    }
+
+    // Only the image's last interval leaves bits pending; they are zero padded as in the serial path
+    chunk->failed = bw_finish(&bw) != 0;
+    chunk->size = bw.byte_pos;
+}
+
+/*
+* Huffman-codes one slice into a raw (unstuffed) bit buffer.
+* The only dependency on the previous slice is the DC prediction, taken from its last block.
+*/
+static void encode_slice_task(void *ctx, uint32_t slice_index) {
+    SLICE_JOB *job = (SLICE_JOB*)ctx;
+    ENTROPY_CHUNK *slice = &job->slices[slice_index];
+
+    uint32_t first = slice_index * job->blocks_per_slice;
+    uint32_t last = first + job->blocks_per_slice;
+    if (last > job->block_count) last = job->block_count;
+
+    int16_t prev_dc = first == 0 ? 0 : job->blocks[(size_t)(first - 1) * 64];
+
+    BW_SINK sink;
+    BitWriter bw;
+    init_growable_sink(&sink, &slice->buffer);
+    bw_init_sink(&bw, &sink);
+    bw.stuffing = 0;            // raw bits, stuffing is done when the slices are stitched
+
+    for (uint32_t i = first; i < last; i++) {
+        prev_dc = encode_coefficients(&job->blocks[(size_t)i * 64], prev_dc, job->tables, &bw);
+    }
+
+    job->slice_bits[slice_index] = (uint64_t)bw.byte_pos * 8 + bw.bit_pos;
+    bw_flush(&bw);
+
+    // The stitcher reads up to 3 bytes past the padded tail byte
+    bw_reserve(&bw, 3);
+    slice->failed = bw.failed;
+    slice->size = bw.byte_pos;
+}
+
+/*
+* Appends 'bit_count' raw bits to a stuffing BitWriter, 32 bits per write.
+* The destination can be at any bit offset, so every byte is re-aligned and
+* 0xFF stuffing is redone by the writer across the slice boundaries.
+*/
+static void stitch_bits(BitWriter *bw, const uint8_t *data, uint64_t bit_count) {
+    uint64_t words = bit_count / 32;
+
+    for (uint64_t w = 0; w < words; w++) {
+        const uint8_t *p = data + w * 4;
+        uint32_t word = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        bw_write(bw, word, 32);
+    }
+
+    int rest = (int)(bit_count % 32);
+    if (rest > 0) {
+        const uint8_t *p = data + words * 4;
+        uint32_t word = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        bw_write(bw, word >> (32 - rest), rest);
+    }
+}
+
+/*
+* Marker-free parallel path: the block range is split into slices coded on worker threads
+* into raw bit buffers, then stitched into 'bw' at bit granularity.
+* The result is bit-identical to coding the blocks serially.
+*/
+static int encode_blocks_sliced(const int16_t *zigzag_blocks, uint32_t block_count, const HUFFMAN_TABLES *tables,
+                                int threads, ENTROPY_WORKSPACE *workspace, BitWriter *bw) {
+    uint32_t slice_count = (uint32_t)threads * CHUNKS_PER_THREAD;
+    if (slice_count > block_count / MIN_SLICE_BLOCKS) slice_count = block_count / MIN_SLICE_BLOCKS;
+
+    SLICE_JOB job;
+    job.blocks = zigzag_blocks;
+    job.block_count = block_count;
+    job.blocks_per_slice = (block_count + slice_count - 1) / slice_count;
+    job.tables = tables;
+    job.slices = workspace->chunks;
+    job.slice_bits = workspace->chunk_bits;
+    slice_count = (block_count + job.blocks_per_slice - 1) / job.blocks_per_slice;
+
+    parallel_for(slice_count, threads, encode_slice_task, &job);
+
+    for (uint32_t s = 0; s < slice_count; s++) {
+        if (job.slices[s].failed) {
+            printf("Error: Not enough memory for entropy coding buffers.\n");
+            return -1;
+        }
+    }
+
+    for (uint32_t s = 0; s < slice_count; s++) {
+        stitch_bits(bw, job.slices[s].buffer.data, job.slice_bits[s]);
+    }
+    return 0;
+}
+
+/*
+* Restart interval parallel path: chunks of whole intervals coded on worker threads and concatenated.
+*/
+static int encode_blocks_chunked(RESTART_JOB *job, int threads, ENTROPY_WORKSPACE *workspace, BitWriter *bw) {
+    uint32_t chunk_count = (uint32_t)threads * CHUNKS_PER_THREAD;
+    if (chunk_count > job->interval_count) chunk_count = job->interval_count;
+    job->intervals_per_chunk = (job->interval_count + chunk_count - 1) / chunk_count;
+    chunk_count = (job->interval_count + job->intervals_per_chunk - 1) / job->intervals_per_chunk;
+    job->chunks = workspace->chunks;
+
+    parallel_for(chunk_count, threads, encode_chunk_task, job);
+
+    // Concatenate in order; every chunk ends byte aligned (after RSTn or the final padding)
+    for (uint32_t c = 0; c < chunk_count; c++) {
+        if (job->chunks[c].failed) {
+            printf("Error: Not enough memory for entropy coding buffers.\n");
+            return -1;
+        }
+    }
+    for (uint32_t c = 0; c < chunk_count; c++) {
+        bw_write_bytes(bw, job->chunks[c].buffer.data, job->chunks[c].size);
+    }
+    return 0;
+}
+
+int encode_blocks(const int16_t *zigzag_blocks, uint32_t block_count, uint32_t restart_interval,
+                  const HUFFMAN_TABLES *tables, int threads, ENTROPY_WORKSPACE *workspace, BitWriter *bw) {
+    RESTART_JOB job;
+    job.blocks = zigzag_blocks;
+    job.block_count = block_count;
+    job.restart_interval = restart_interval;
+    job.interval_count = restart_interval ? (block_count + restart_interval - 1) / restart_interval : 0;
+    job.tables = tables;
+
+    int sliced = restart_interval == 0 && threads > 1 && block_count >= 2 * MIN_SLICE_BLOCKS;
+    int chunked = restart_interval != 0 && threads > 1 && job.interval_count > 1 && bw->bit_pos == 0;
+
+    if (sliced || chunked) {
+        ENTROPY_WORKSPACE local = { 0 };
+        ENTROPY_WORKSPACE *scratch = workspace ? workspace : &local;
+
+        int status = entropy_workspace_reserve(scratch, block_count, threads);
+        if (status == 0) {
+            status = sliced ? encode_blocks_sliced(zigzag_blocks, block_count, tables, threads, scratch, bw)
+                            : encode_blocks_chunked(&job, threads, scratch, bw);
+        }
+        if (workspace == NULL) entropy_workspace_free(&local);
+        return status;
+    }
+
+    if (restart_interval == 0) {
+        int16_t prev_dc = 0;
+        for (uint32_t i = 0; i < block_count; i++) {
+            prev_dc = encode_coefficients(&zigzag_blocks[(size_t)i * 64], prev_dc, tables, bw);
+        }
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < job.interval_count; i++) {
+        encode_interval(&job, i, bw);
+    }
+    return 0;
+}
+
+typedef struct {
+    const int16_t *blocks;
+    uint32_t block_count;
+    uint32_t restart_interval;
+    uint32_t (*dc_freq)[16];        // per chunk histograms, summed afterwards
+    uint32_t (*ac_freq)[256];
+} STATISTICS_JOB;
+
+static void count_chunk_task(void *ctx, uint32_t chunk_index) {
+    STATISTICS_JOB *job = (STATISTICS_JOB*)ctx;
+    uint32_t first = chunk_index * STATISTICS_CHUNK_BLOCKS;
+    uint32_t last = first + STATISTICS_CHUNK_BLOCKS;
+    if (last > job->block_count) last = job->block_count;
+
+    for (uint32_t i = first; i < last; i++) {
+        // DC prediction restarts at zero at the image start and at every restart interval
+        int restart = i == 0 || (job->restart_interval && i % job->restart_interval == 0);
+        int16_t prev_dc = restart ? 0 : job->blocks[(size_t)(i - 1) * 64];
+
+        count_coefficient_symbols(&job->blocks[(size_t)i * 64], prev_dc,
+                                  job->dc_freq[chunk_index], job->ac_freq[chunk_index]);
+    }
+}
+
+int gather_block_statistics(const int16_t *zigzag_blocks, uint32_t block_count, uint32_t restart_interval,
+                            int threads, ENTROPY_WORKSPACE *workspace, uint32_t *dc_freq, uint32_t *ac_freq) {
+    uint32_t chunk_count = (block_count + STATISTICS_CHUNK_BLOCKS - 1) / STATISTICS_CHUNK_BLOCKS;
+    ENTROPY_WORKSPACE local = { 0 };
+    ENTROPY_WORKSPACE *scratch = workspace ? workspace : &local;
+
+    if (entropy_workspace_reserve(scratch, block_count, threads) != 0) {
+        if (workspace == NULL) entropy_workspace_free(&local);
+        return -1;
+    }
+
+    STATISTICS_JOB job;
+    job.blocks = zigzag_blocks;
+    job.block_count = block_count;
+    job.restart_interval = restart_interval;
+    job.dc_freq = scratch->dc_freq;
+    job.ac_freq = scratch->ac_freq;
+    memset(job.dc_freq, 0, chunk_count * sizeof(*job.dc_freq));
+    memset(job.ac_freq, 0, chunk_count * sizeof(*job.ac_freq));
+
+    parallel_for(chunk_count, threads, count_chunk_task, &job);
+
+    memset(dc_freq, 0, 16 * sizeof(uint32_t));
+    memset(ac_freq, 0, 256 * sizeof(uint32_t));
+    for (uint32_t c = 0; c < chunk_count; c++) {
+        for (int i = 0; i < 16; i++) dc_freq[i] += job.dc_freq[c][i];
+        for (int i = 0; i < 256; i++) ac_freq[i] += job.ac_freq[c][i];
+    }
+
+    if (workspace == NULL) entropy_workspace_free(&local);
+    return 0;
+}
+
+typedef struct {
+    const int16_t *blocks;
+    uint32_t block_count;
+    uint32_t restart_interval;
+    uint32_t intervals_per_task;
+    const HUFFMAN_TABLES *tables;
+    uint64_t *task_bytes;
+} SIZE_JOB;
+
+/*
+* Dry run over whole restart intervals, mirroring encode_interval.
+* Every task starts byte aligned, since each interval but the last ends with RSTn.
+*/
+static void dry_run_task(void *ctx, uint32_t task_index) {
+    SIZE_JOB *job = (SIZE_JOB*)ctx;
+    uint32_t interval_count = (job->block_count + job->restart_interval - 1) / job->restart_interval;
+    uint32_t first = task_index * job->intervals_per_task;
+    uint32_t last = first + job->intervals_per_task;
+    if (last > interval_count) last = interval_count;
+
+    BitCounter bc;
+    bc_init(&bc);
+
+    for (uint32_t interval = first; interval < last; interval++) {
+        uint32_t first_block = interval * job->restart_interval;
+        uint32_t last_block = first_block + job->restart_interval;
+        if (last_block > job->block_count) last_block = job->block_count;
+
+        int16_t prev_dc = 0;
+        for (uint32_t i = first_block; i < last_block; i++) {
+            prev_dc = dry_run_coefficients(&job->blocks[(size_t)i * 64], prev_dc, job->tables, &bc);
+        }
+
+        if (interval + 1 < interval_count) {
+            bc_restart(&bc);
+        }
+    }
+
+    bc_flush(&bc);
+    job->task_bytes[task_index] = bc.bytes;
+}
+
+uint64_t dry_run_scan_size(const int16_t *zigzag_blocks, uint32_t block_count, uint32_t restart_interval,
+                           const HUFFMAN_TABLES *tables, int threads, ENTROPY_WORKSPACE *workspace) {
+    if (restart_interval == 0 || threads <= 1) {
+        // One continuous bit string: stuffing depends on the exact bit alignment, so this runs serially
+        BitCounter bc;
+        bc_init(&bc);
+
+        int16_t prev_dc = 0;
+        for (uint32_t i = 0; i < block_count; i++) {
+            if (restart_interval && i > 0 && i % restart_interval == 0) {
+                bc_restart(&bc);
+                prev_dc = 0;
+            }
+            prev_dc = dry_run_coefficients(&zigzag_blocks[(size_t)i * 64], prev_dc, tables, &bc);
+        }
+
+        bc_flush(&bc);
+        return bc.bytes;
+    }
+
+    SIZE_JOB job;
+    job.blocks = zigzag_blocks;
+    job.block_count = block_count;
+    job.restart_interval = restart_interval;
+    job.tables = tables;
+
+    uint32_t interval_count = (block_count + restart_interval - 1) / restart_interval;
+    uint32_t task_count = (uint32_t)threads * CHUNKS_PER_THREAD;
+    if (task_count > interval_count) task_count = interval_count;
+    job.intervals_per_task = (interval_count + task_count - 1) / task_count;
+    task_count = (interval_count + job.intervals_per_task - 1) / job.intervals_per_task;
+
+    ENTROPY_WORKSPACE local = { 0 };
+    ENTROPY_WORKSPACE *scratch = workspace ? workspace : &local;
+    if (entropy_workspace_reserve(scratch, block_count, threads) != 0) {
+        if (workspace == NULL) entropy_workspace_free(&local);
+        return dry_run_scan_size(zigzag_blocks, block_count, restart_interval, tables, 1, NULL);
+    }
+    job.task_bytes = scratch->chunk_bits;
+
+    parallel_for(task_count, threads, dry_run_task, &job);
+
+    uint64_t total = 0;
+    for (uint32_t t = 0; t < task_count; t++) {
+        total += job.task_bytes[t];
+    }
+
+    if (workspace == NULL) entropy_workspace_free(&local);
+    return total;
+}
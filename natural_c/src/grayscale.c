@@ -1,4 +1,5 @@
 #include "grayscale.h"
+#include "simd.h"
 #include <stdlib.h>
 
 float* convert_to_grayscale(RGB* pixels, uint32_t width, uint32_t height) {
@@ -8,11 +9,8 @@ float* convert_to_grayscale(RGB* pixels, uint32_t width, uint32_t height) {
         return NULL; 
     }
 
-    for (uint32_t i = 0; i < width * height; i++) {
-
-        // Using standard luminance calculation - ITU-R BT.601
-        grayscale_values[i] = 0.299f * pixels[i].r + 0.587f * pixels[i].g + 0.114f * pixels[i].b;
-    }
+    // Using standard luminance calculation - ITU-R BT.601 (scalar or SIMD kernel)
+    get_kernels()->rgb_to_y(pixels, grayscale_values, width * height);
 
     return grayscale_values;
 }
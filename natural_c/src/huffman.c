@@ -0,0 +1,131 @@
+#include "huffman.h"
+#include <string.h>
+
+// Bound on code lengths before limiting: depth d needs a total weight of at least Fib(d),
+// and 256 uint32_t frequencies stay below Fib(64)
+#define MAX_CODE_LENGTH 64
+
+void build_optimal_huffman_spec(const uint32_t *freq, int symbol_count, HUFFMAN_SPEC *spec) {
+    uint64_t weight[257];
+    int code_size[257];
+    int others[257];
+    int bits[MAX_CODE_LENGTH + 1];
+
+    memset(weight, 0, sizeof(weight));
+    for (int i = 0; i < symbol_count; i++) {
+        weight[i] = freq[i];
+    }
+    weight[256] = 1;        // reserved symbol, guarantees no code consists of all 1-bits
+
+    for (int i = 0; i < 257; i++) {
+        code_size[i] = 0;
+        others[i] = -1;
+    }
+
+    // Repeatedly merge the two least frequent subtrees (K.2, figure K.1)
+    for (;;) {
+        int c1 = -1, c2 = -1;
+        uint64_t v = UINT64_MAX;
+
+        // Ties go to the larger symbol value, so the reserved symbol gets the longest code
+        for (int i = 0; i < 257; i++) {
+            if (weight[i] && weight[i] <= v) {
+                v = weight[i];
+                c1 = i;
+            }
+        }
+        v = UINT64_MAX;
+        for (int i = 0; i < 257; i++) {
+            if (weight[i] && weight[i] <= v && i != c1) {
+                v = weight[i];
+                c2 = i;
+            }
+        }
+
+        if (c2 < 0) break;
+
+        weight[c1] += weight[c2];
+        weight[c2] = 0;
+
+        // Every symbol in both subtrees moves one level down
+        code_size[c1]++;
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            code_size[c1]++;
+        }
+        others[c1] = c2;
+
+        code_size[c2]++;
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            code_size[c2]++;
+        }
+    }
+
+    memset(bits, 0, sizeof(bits));
+    for (int i = 0; i < 257; i++) {
+        if (code_size[i]) bits[code_size[i]]++;
+    }
+
+    // Limit code lengths to 16 bits (K.2, figure K.3)
+    for (int i = MAX_CODE_LENGTH; i > 16; i--) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) j--;
+
+            bits[i] -= 2;
+            bits[i - 1]++;
+            bits[j + 1] += 2;
+            bits[j]--;
+        }
+    }
+
+    // Drop the reserved symbol, it has the longest code
+    int longest = 16;
+    while (bits[longest] == 0) longest--;
+    bits[longest]--;
+
+    spec->count = 0;
+    for (int len = 1; len <= 16; len++) {
+        spec->bits[len - 1] = (uint8_t)bits[len];
+    }
+
+    // Symbols sorted by code length (K.2, figure K.4)
+    for (int len = 1; len <= MAX_CODE_LENGTH; len++) {
+        for (int i = 0; i < symbol_count; i++) {
+            if (code_size[i] == len) {
+                spec->vals[spec->count++] = (uint8_t)i;
+            }
+        }
+    }
+}
+
+void build_huffman_codes(const HUFFMAN_SPEC *spec, HuffmanCode *codes) {
+    uint32_t code = 0;
+    int k = 0;
+
+    for (int len = 1; len <= 16; len++) {
+        for (int i = 0; i < spec->bits[len - 1]; i++) {
+            codes[spec->vals[k]].code = (uint16_t)code;
+            codes[spec->vals[k]].len = (uint8_t)len;
+            code++;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+void build_optimal_huffman_tables(const uint32_t *dc_freq, const uint32_t *ac_freq,
+                                  HUFFMAN_TABLE_DATA *data, HUFFMAN_TABLES *tables) {
+    memset(data, 0, sizeof(*data));
+
+    build_optimal_huffman_spec(dc_freq, 16, &data->dc_spec);
+    build_optimal_huffman_spec(ac_freq, 256, &data->ac_spec);
+    build_huffman_codes(&data->dc_spec, data->dc);
+    build_huffman_codes(&data->ac_spec, data->ac);
+
+    tables->dc = data->dc;
+    tables->ac = data->ac;
+    tables->dc_spec = &data->dc_spec;
+    tables->ac_spec = &data->ac_spec;
+}
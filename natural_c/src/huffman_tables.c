@@ -215,3 +215,305 @@ const HuffmanCode huff_ac_lum[256] = {
     [0xF9] = {0xFFFD, 16}, 
     [0xFA] = {0xFFFE, 16}
 };
+
+/*
+* The same tables in DHT form (Annex K.3, tables K.3 and K.5).
+*/
+const HUFFMAN_SPEC std_dc_lum_spec = {
+    {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11},
+    12
+};
+
+const HUFFMAN_SPEC std_ac_lum_spec = {
+    {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D},
+    {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+        0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08,
+        0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16,
+        0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+        0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+        0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+        0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+        0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+        0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6,
+        0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+        0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4,
+        0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+        0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA,
+        0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA
+    },
+    162
+};
+
+const HUFFMAN_TABLES std_lum_huffman = {
+    huff_dc_lum,
+    huff_ac_lum,
+    &std_dc_lum_spec,
+    &std_ac_lum_spec
+};
+
+/*
+* Predefined Huffman tables for chrominance DC and AC coefficients (Cb and Cr).
+* ISO/IEC 10918-1 (JPEG Standard, Annex K.3, tables K.4 and K.6)
+*/
+
+const HuffmanCode huff_dc_chrom[16] = {
+    {0x00, 2},  // Size 0
+    {0x01, 2},  // Size 1
+    {0x02, 2},  // Size 2
+    {0x06, 3},  // Size 3
+    {0x0E, 4},  // Size 4
+    {0x1E, 5},  // Size 5
+    {0x3E, 6},  // Size 6
+    {0x7E, 7},  // Size 7
+    {0xFE, 8},  // Size 8
+    {0x1FE, 9}, // Size 9
+    {0x3FE, 10}, // Size 10
+    {0x7FE, 11}, // Size 11
+    {0,0}, {0,0}, {0,0}, {0,0} // 12-15 not used in standard DC chrom
+};
+
+// Standard AC Chrominance Table
+const HuffmanCode huff_ac_chrom[256] = {
+    // --- Length 2 ---
+    [0x00] = {0x0000, 2}, // EOB (End of Block)
+    [0x01] = {0x0001, 2},
+
+    // --- Length 3 ---
+    [0x02] = {0x0004, 3},
+
+    // --- Length 4 ---
+    [0x03] = {0x000A, 4},
+    [0x11] = {0x000B, 4},
+
+    // --- Length 5 ---
+    [0x04] = {0x0018, 5},
+    [0x05] = {0x0019, 5},
+    [0x21] = {0x001A, 5},
+    [0x31] = {0x001B, 5},
+
+    // --- Length 6 ---
+    [0x06] = {0x0038, 6},
+    [0x12] = {0x0039, 6},
+    [0x41] = {0x003A, 6},
+    [0x51] = {0x003B, 6},
+
+    // --- Length 7 ---
+    [0x07] = {0x0078, 7},
+    [0x61] = {0x0079, 7},
+    [0x71] = {0x007A, 7},
+
+    // --- Length 8 ---
+    [0x13] = {0x00F6, 8},
+    [0x22] = {0x00F7, 8},
+    [0x32] = {0x00F8, 8},
+    [0x81] = {0x00F9, 8},
+
+    // --- Length 9 ---
+    [0x08] = {0x01F4, 9},
+    [0x14] = {0x01F5, 9},
+    [0x42] = {0x01F6, 9},
+    [0x91] = {0x01F7, 9},
+    [0xA1] = {0x01F8, 9},
+    [0xB1] = {0x01F9, 9},
+    [0xC1] = {0x01FA, 9},
+
+    // --- Length 10 ---
+    [0x09] = {0x03F6, 10},
+    [0x23] = {0x03F7, 10},
+    [0x33] = {0x03F8, 10},
+    [0x52] = {0x03F9, 10},
+    [0xF0] = {0x03FA, 10}, // ZRL
+
+    // --- Length 11 ---
+    [0x15] = {0x07F6, 11},
+    [0x62] = {0x07F7, 11},
+    [0x72] = {0x07F8, 11},
+    [0xD1] = {0x07F9, 11},
+
+    // --- Length 12 ---
+    [0x0A] = {0x0FF4, 12},
+    [0x16] = {0x0FF5, 12},
+    [0x24] = {0x0FF6, 12},
+    [0x34] = {0x0FF7, 12},
+
+    // --- Length 14 ---
+    [0xE1] = {0x3FE0, 14},
+
+    // --- Length 15 ---
+    [0x25] = {0x7FC2, 15},
+    [0xF1] = {0x7FC3, 15},
+
+    // --- Length 16 ---
+    [0x17] = {0xFF88, 16},
+    [0x18] = {0xFF89, 16},
+    [0x19] = {0xFF8A, 16},
+    [0x1A] = {0xFF8B, 16},
+    [0x26] = {0xFF8C, 16},
+    [0x27] = {0xFF8D, 16},
+    [0x28] = {0xFF8E, 16},
+    [0x29] = {0xFF8F, 16},
+    [0x2A] = {0xFF90, 16},
+    [0x35] = {0xFF91, 16},
+    [0x36] = {0xFF92, 16},
+    [0x37] = {0xFF93, 16},
+    [0x38] = {0xFF94, 16},
+    [0x39] = {0xFF95, 16},
+    [0x3A] = {0xFF96, 16},
+    [0x43] = {0xFF97, 16},
+    [0x44] = {0xFF98, 16},
+    [0x45] = {0xFF99, 16},
+    [0x46] = {0xFF9A, 16},
+    [0x47] = {0xFF9B, 16},
+    [0x48] = {0xFF9C, 16},
+    [0x49] = {0xFF9D, 16},
+    [0x4A] = {0xFF9E, 16},
+    [0x53] = {0xFF9F, 16},
+    [0x54] = {0xFFA0, 16},
+    [0x55] = {0xFFA1, 16},
+    [0x56] = {0xFFA2, 16},
+    [0x57] = {0xFFA3, 16},
+    [0x58] = {0xFFA4, 16},
+    [0x59] = {0xFFA5, 16},
+    [0x5A] = {0xFFA6, 16},
+    [0x63] = {0xFFA7, 16},
+    [0x64] = {0xFFA8, 16},
+    [0x65] = {0xFFA9, 16},
+    [0x66] = {0xFFAA, 16},
+    [0x67] = {0xFFAB, 16},
+    [0x68] = {0xFFAC, 16},
+    [0x69] = {0xFFAD, 16},
+    [0x6A] = {0xFFAE, 16},
+    [0x73] = {0xFFAF, 16},
+    [0x74] = {0xFFB0, 16},
+    [0x75] = {0xFFB1, 16},
+    [0x76] = {0xFFB2, 16},
+    [0x77] = {0xFFB3, 16},
+    [0x78] = {0xFFB4, 16},
+    [0x79] = {0xFFB5, 16},
+    [0x7A] = {0xFFB6, 16},
+    [0x82] = {0xFFB7, 16},
+    [0x83] = {0xFFB8, 16},
+    [0x84] = {0xFFB9, 16},
+    [0x85] = {0xFFBA, 16},
+    [0x86] = {0xFFBB, 16},
+    [0x87] = {0xFFBC, 16},
+    [0x88] = {0xFFBD, 16},
+    [0x89] = {0xFFBE, 16},
+    [0x8A] = {0xFFBF, 16},
+    [0x92] = {0xFFC0, 16},
+    [0x93] = {0xFFC1, 16},
+    [0x94] = {0xFFC2, 16},
+    [0x95] = {0xFFC3, 16},
+    [0x96] = {0xFFC4, 16},
+    [0x97] = {0xFFC5, 16},
+    [0x98] = {0xFFC6, 16},
+    [0x99] = {0xFFC7, 16},
+    [0x9A] = {0xFFC8, 16},
+    [0xA2] = {0xFFC9, 16},
+    [0xA3] = {0xFFCA, 16},
+    [0xA4] = {0xFFCB, 16},
+    [0xA5] = {0xFFCC, 16},
+    [0xA6] = {0xFFCD, 16},
+    [0xA7] = {0xFFCE, 16},
+    [0xA8] = {0xFFCF, 16},
+    [0xA9] = {0xFFD0, 16},
+    [0xAA] = {0xFFD1, 16},
+    [0xB2] = {0xFFD2, 16},
+    [0xB3] = {0xFFD3, 16},
+    [0xB4] = {0xFFD4, 16},
+    [0xB5] = {0xFFD5, 16},
+    [0xB6] = {0xFFD6, 16},
+    [0xB7] = {0xFFD7, 16},
+    [0xB8] = {0xFFD8, 16},
+    [0xB9] = {0xFFD9, 16},
+    [0xBA] = {0xFFDA, 16},
+    [0xC2] = {0xFFDB, 16},
+    [0xC3] = {0xFFDC, 16},
+    [0xC4] = {0xFFDD, 16},
+    [0xC5] = {0xFFDE, 16},
+    [0xC6] = {0xFFDF, 16},
+    [0xC7] = {0xFFE0, 16},
+    [0xC8] = {0xFFE1, 16},
+    [0xC9] = {0xFFE2, 16},
+    [0xCA] = {0xFFE3, 16},
+    [0xD2] = {0xFFE4, 16},
+    [0xD3] = {0xFFE5, 16},
+    [0xD4] = {0xFFE6, 16},
+    [0xD5] = {0xFFE7, 16},
+    [0xD6] = {0xFFE8, 16},
+    [0xD7] = {0xFFE9, 16},
+    [0xD8] = {0xFFEA, 16},
+    [0xD9] = {0xFFEB, 16},
+    [0xDA] = {0xFFEC, 16},
+    [0xE2] = {0xFFED, 16},
+    [0xE3] = {0xFFEE, 16},
+    [0xE4] = {0xFFEF, 16},
+    [0xE5] = {0xFFF0, 16},
+    [0xE6] = {0xFFF1, 16},
+    [0xE7] = {0xFFF2, 16},
+    [0xE8] = {0xFFF3, 16},
+    [0xE9] = {0xFFF4, 16},
+    [0xEA] = {0xFFF5, 16},
+    [0xF2] = {0xFFF6, 16},
+    [0xF3] = {0xFFF7, 16},
+    [0xF4] = {0xFFF8, 16},
+    [0xF5] = {0xFFF9, 16},
+    [0xF6] = {0xFFFA, 16},
+    [0xF7] = {0xFFFB, 16},
+    [0xF8] = {0xFFFC, 16},
+    [0xF9] = {0xFFFD, 16},
+    [0xFA] = {0xFFFE, 16}
+};
+
+/*
+* The same tables in DHT form (Annex K.3, tables K.4 and K.6).
+*/
+const HUFFMAN_SPEC std_dc_chrom_spec = {
+    {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11},
+    12
+};
+
+const HUFFMAN_SPEC std_ac_chrom_spec = {
+    {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77},
+    {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+        0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+        0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+        0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34,
+        0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+        0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38,
+        0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+        0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+        0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96,
+        0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+        0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4,
+        0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+        0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2,
+        0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+        0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9,
+        0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA
+    },
+    162
+};
+
+const HUFFMAN_TABLES std_chrom_huffman = {
+    huff_dc_chrom,
+    huff_ac_chrom,
+    &std_dc_chrom_spec,
+    &std_ac_chrom_spec
+};
@@ -1,175 +1,256 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
 #include "jfif_handler.h"
 
-void write_word(FILE *f, uint16_t v) {
-    fputc((v >> 8) & 0xFF, f);
-    fputc(v & 0xFF, f);
+/*
+* Every segment is serialized into memory by a put_* function that returns the advanced write
+* position. Headers are only built in memory; jfif_writev sends them to file descriptors.
+*/
+
+static uint8_t* put_word(uint8_t *p, uint16_t v) {
+    *p++ = (v >> 8) & 0xFF;
+    *p++ = v & 0xFF;
+    return p;
 }
 
-void write_soi(FILE *f) {
-    fputc(0xFF, f); 
-    fputc(0xD8, f);     // SOI marker
+static uint8_t* put_soi(uint8_t *p) {
+    *p++ = 0xFF;
+    *p++ = 0xD8;        // SOI marker
+    return p;
 }
 
-void write_app0(FILE *f) {
-    fputc(0xFF, f);
-    fputc(0xEE, f);
+static uint8_t* put_app0(uint8_t *p) {
+    *p++ = 0xFF;
+    *p++ = 0xEE;
 
-    write_word(f, 16);          // length of this segment (16 for standard JFIF)
+    p = put_word(p, 16);        // length of this segment (16 for standard JFIF)
 
-    fputc('J', f);
-    fputc('F', f);
-    fputc('I', f);
-    fputc('F', f);
-    fputc(0x00, f);         // Write 'JFIF' ending with 0x00
+    *p++ = 'J';
+    *p++ = 'F';
+    *p++ = 'I';
+    *p++ = 'F';
+    *p++ = 0x00;            // Write 'JFIF' ending with 0x00
 
-    fputc(0x01, f);
-    fputc(0x01, f);         // version: 1.01
+    *p++ = 0x01;
+    *p++ = 0x01;            // version: 1.01
 
-    fputc(0x00, f);         // ones (0 = none)
+    *p++ = 0x00;            // ones (0 = none)
 
-    write_word(f, 1);       // X density (1 pixel aspect ratio)
-    write_word(f, 1);       // Y density (1 pixel aspect ratio)
+    p = put_word(p, 1);     // X density (1 pixel aspect ratio)
+    p = put_word(p, 1);     // Y density (1 pixel aspect ratio)
 
-    fputc(0x00, f);         // thumbnail width (0 = no thumbnail)
-    fputc(0x00, f);         // thumbnail height (0 = no thumbnail)
+    *p++ = 0x00;            // thumbnail width (0 = no thumbnail)
+    *p++ = 0x00;            // thumbnail height (0 = no thumbnail)
+    return p;
 }
 
-void write_dqt(FILE *f) {
-    fputc(0xFF, f);
-    fputc(0xDB, f);         // DQT marker
+static uint8_t* put_dqt_table(uint8_t *p, uint8_t table_id, const QUANT_TABLE *qt) {
+    *p++ = 0xFF;
+    *p++ = 0xDB;            // DQT marker
 
-    write_word(f, 67);      // Length: 2 bytes length data + 1 byte info + 64 bytes quantization table
+    p = put_word(p, 67);    // Length: 2 bytes length data + 1 byte info + 64 bytes quantization table
 
-    fputc(0x00, f);         // info byte: 
+    *p++ = table_id;        // info byte:
                             // upper 4 bits represent precision (0 = 8-bit)
-                            // lower 4 bits represent table ID (0 = Luminance)
-
-    fwrite(std_lum_qt_zigzagged, 1, 64, f);
-}
-
-void write_sof0(FILE *f, uint16_t width, uint16_t height) {
-    fputc(0xFF, f);
-    fputc(0xC0, f); // SOF0 marker
-    
-    write_word(f, 11);      // length: 8 + 3 * number_of_components (grayscale, so there is only one component)
-    
-    fputc(8, f);            // Precision: 8 bits per sample
-    write_word(f, height);  // picture height 
-    write_word(f, width);   // picture width
-    fputc(1, f);            // number of componenets (1 = Grayscale)
-    
-    // For each component (there is only 1)
-    fputc(1, f);    // Component ID (1 = Y / Luminance)
-    fputc(0x11, f); // Sampling factors. 1x1 is the standard value.
-    fputc(0, f);    // Quantization Table ID (0 for the table we used)
-}
-
-void write_dht(FILE *f) {
-    // --- DC Table (Luminance) ---
-    uint8_t dc_lum_bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
-    // symbols sorted by frequency
-    uint8_t dc_lum_vals[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
-    
-    fputc(0xFF, f);
-    fputc(0xC4, f);     // DHT marker
-    
-    // Segment length: 2 (length bytes) + 1 (info) + 16 (bits) + 12 (vals) = 31
-    write_word(f, 2 + 1 + 16 + sizeof(dc_lum_vals));
-    
+                            // lower 4 bits represent table ID (0 = Luminance, 1 = Chrominance)
+
+    memcpy(p, qt->zigzag, 64);
+    return p + 64;
+}
+
+/*
+* Number of components in a frame: Y only, or Y, Cb and Cr.
+*/
+static int frame_components(const JFIF_FRAME *frame) {
+    return frame->color_mode == COLOR_MODE_GRAY ? 1 : 3;
+}
+
+static uint8_t* put_sof0(uint8_t *p, const JFIF_FRAME *frame) {
+    int components = frame_components(frame);
+
+    *p++ = 0xFF;
+    *p++ = 0xC0;    // SOF0 marker
+
+    p = put_word(p, 8 + 3 * components);    // length: 8 + 3 * number_of_components
+
+    *p++ = 8;                       // Precision: 8 bits per sample
+    p = put_word(p, frame->height); // picture height
+    p = put_word(p, frame->width);  // picture width
+    *p++ = components;              // number of componenets (1 = Grayscale, 3 = YCbCr)
+
+    // Component 1 (Y / Luminance)
+    *p++ = 1;       // Component ID
+    // Sampling factors (upper 4 bits horizontal, lower 4 bits vertical). 1x1 is the standard value,
+    // subsampled chroma is expressed by sampling Y more often than Cb and Cr.
+    *p++ = (color_mode_h_factor(frame->color_mode) << 4) | color_mode_v_factor(frame->color_mode);
+    *p++ = 0;       // Quantization Table ID (0 = Luminance)
+
+    // Components 2 and 3 (Cb, Cr) - one sample per MCU each, chrominance table
+    for (int c = 2; c <= components; c++) {
+        *p++ = c;
+        *p++ = 0x11;
+        *p++ = 1;
+    }
+    return p;
+}
+
+static uint8_t* put_dht_table(uint8_t *p, uint8_t table_class_id, const HUFFMAN_SPEC *spec) {
+    *p++ = 0xFF;
+    *p++ = 0xC4;        // DHT marker
+
+    // Segment length: 2 (length bytes) + 1 (info) + 16 (bits) + symbols
+    p = put_word(p, 2 + 1 + 16 + spec->count);
+
     // Info byte:
     // 4th bit: class (0 = DC, 1 = AC)
     // Bits 0-3: table ID (0 = Luminance)
-    fputc(0x00, f); // 00 = DC Table 0
-    
-    fwrite(dc_lum_bits, 1, 16, f);
-    fwrite(dc_lum_vals, 1, sizeof(dc_lum_vals), f);
-    
-    // --- AC table (Luminance) ---
-    uint8_t ac_lum_bits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
-    uint8_t ac_lum_vals[] = { 
-        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
-        0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
-        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08,
-        0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
-        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16,
-        0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
-        0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
-        0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
-        0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
-        0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
-        0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
-        0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
-        0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
-        0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
-        0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6,
-        0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
-        0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4,
-        0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
-        0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA,
-        0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
-        0xF9, 0xFA
-    };
-    
-    fputc(0xFF, f);
-    fputc(0xC4, f); // DHT marker
-    
-    // Segment length
-    write_word(f, 2 + 1 + 16 + sizeof(ac_lum_vals));
-    
-    // Info byte:
-    // 4th bit: class (1 = AC)
-    // Bits 0-3: table ID (0 = Luminance)
-    fputc(0x10, f); // 10 = AC Table 0
-    
-    fwrite(ac_lum_bits, 1, 16, f);
-    fwrite(ac_lum_vals, 1, sizeof(ac_lum_vals), f);
+    *p++ = table_class_id;
+
+    memcpy(p, spec->bits, 16);
+    memcpy(p + 16, spec->vals, spec->count);
+    return p + 16 + spec->count;
+}
+
+static uint8_t* put_dri(uint8_t *p, uint16_t restart_interval) {
+    *p++ = 0xFF;
+    *p++ = 0xDD;        // DRI marker
+
+    p = put_word(p, 4);                 // length: 2 bytes length data + 2 bytes interval
+    return put_word(p, restart_interval);   // number of MCUs per restart interval
 }
 
-void write_sos(FILE *f) {
-    fputc(0xFF, f);
-    fputc(0xDA, f); // SOS marker
-    
+static uint8_t* put_sos(uint8_t *p, const JFIF_FRAME *frame) {
+    int components = frame_components(frame);
+
+    *p++ = 0xFF;
+    *p++ = 0xDA;    // SOS marker
+
     // Length: 6 + 2 * number_of_components
-    // Grayscale: 6 + 2 = 8
-    write_word(f, 8);
-    
-    fputc(1, f); // Num of components in this scan
-    
-    // Component 1 (Y)
-    fputc(1, f); // Component ID
-    // Defines which Huffman table to use
-    // Upper 4 bits: DC table ID (0)
-    // Lower 4 bits: AC table ID (0)
-    fputc(0x00, f); 
-    
+    p = put_word(p, 6 + 2 * components);
+
+    *p++ = components;  // Num of components in this scan
+
+    for (int c = 1; c <= components; c++) {
+        *p++ = c;       // Component ID
+        // Defines which Huffman table to use
+        // Upper 4 bits: DC table ID (0 = Luminance, 1 = Chrominance)
+        // Lower 4 bits: AC table ID (0 = Luminance, 1 = Chrominance)
+        *p++ = c == 1 ? 0x00 : 0x11;
+    }
+
     // 3 bytes for spectral selection (Baseline standard):
-    fputc(0x00, f); // Start of spectral selection
-    fputc(0x3F, f); // End of spectral selection (63)
-    fputc(0x00, f); // Successive approximation
+    *p++ = 0x00;    // Start of spectral selection
+    *p++ = 0x3F;    // End of spectral selection (63)
+    *p++ = 0x00;    // Successive approximation
+    return p;
 }
 
-void write_eoi(FILE *f) {
-    fputc(0xFF, f);
-    fputc(0xD9, f);     // EOI marker
+static uint8_t* put_eoi(uint8_t *p) {
+    *p++ = 0xFF;
+    *p++ = 0xD9;        // EOI marker
+    return p;
 }
 
-void write_bitstream(FILE *f, uint8_t *buffer, int length) {
-    fwrite(buffer, 1, length, f);
+uint32_t jfif_frame_header_size(const JFIF_FRAME *frame) {
+    int components = frame_components(frame);
+    int tables = components == 1 ? 1 : 2;
+
+    uint32_t size = 2                                   // SOI
+                  + 2 + 16                              // APP0
+                  + tables * (2 + 67)                   // DQT
+                  + 2 + 8 + 3 * components              // SOF0
+                  + 2 + 6 + 2 * components              // SOS
+                  + 2;                                  // EOI
+    for (int t = 0; t < tables; t++) {
+        size += 2 * (2 + 2 + 1 + 16)                    // DHT headers (DC and AC)
+              + frame->tables[t]->dc_spec->count + frame->tables[t]->ac_spec->count;
+    }
+    if (frame->restart_interval > 0) {
+        size += 2 + 4;                                  // DRI
+    }
+    return size;
+}
+
+uint32_t jfif_header_size(uint16_t restart_interval, const HUFFMAN_TABLES *tables) {
+    JFIF_FRAME frame = { 0, 0, restart_interval, COLOR_MODE_GRAY, { NULL, NULL }, { tables, NULL } };
+    return jfif_frame_header_size(&frame);
 }
 
-void write_to_jfif(FILE *f, uint8_t *buffer, int length, uint16_t width, uint16_t height) {
-    write_soi(f);
-    write_app0(f);
-    write_dqt(f);      
-    write_sof0(f, width, height);
-    write_dht(f);      
-    write_sos(f);
+void jfif_header_init(JFIF_HEADER *header, const JFIF_FRAME *frame) {
+    int color = frame->color_mode != COLOR_MODE_GRAY;
+    uint8_t *p = header->bytes;
+
+    p = put_soi(p);
+    p = put_app0(p);
+    p = put_dqt_table(p, 0x00, frame->qt[0]);
+    if (color) {
+        p = put_dqt_table(p, 0x01, frame->qt[1]);
+    }
+
+    header->size_pos = (uint32_t)(p - header->bytes) + 5;      // SOF0 marker, length, precision
+    p = put_sof0(p, frame);
 
-    // --- processed data --- 
-    write_bitstream(f, buffer, length);
+    p = put_dht_table(p, 0x00, frame->tables[0]->dc_spec);    // 00 = DC Table 0
+    p = put_dht_table(p, 0x10, frame->tables[0]->ac_spec);    // 10 = AC Table 0
+    if (color) {
+        p = put_dht_table(p, 0x01, frame->tables[1]->dc_spec);     // 01 = DC Table 1
+        p = put_dht_table(p, 0x11, frame->tables[1]->ac_spec);     // 11 = AC Table 1
+    }
+    if (frame->restart_interval > 0) {
+        p = put_dri(p, frame->restart_interval);
+    }
+    p = put_sos(p, frame);
+
+    header->size = (uint32_t)(p - header->bytes);
+}
+
+void jfif_header_set_size(JFIF_HEADER *header, uint16_t width, uint16_t height) {
+    uint8_t *p = header->bytes + header->size_pos;
+    p = put_word(p, height);
+    put_word(p, width);
+}
+
+uint8_t* jfif_begin(const JFIF_HEADER *header, uint8_t *out) {
+    memcpy(out, header->bytes, header->size);
+    return out + header->size;
+}
+
+size_t jfif_finish(const JFIF_HEADER *header, uint8_t *out, uint32_t scan_length) {
+    put_eoi(out + header->size + scan_length);
+    return header->size + scan_length + 2;
+}
+
+int jfif_writev(int fd, const JFIF_HEADER *header, const uint8_t *scan, uint32_t length) {
+    static const uint8_t eoi[2] = { 0xFF, 0xD9 };
+    struct iovec parts[3] = {
+        { (void*)header->bytes, header->size },
+        { (void*)scan, length },
+        { (void*)eoi, sizeof(eoi) }
+    };
+    struct iovec *iov = parts;
+    int count = 3;
 
-    write_eoi(f);
+    // One call in the common case; sockets and pipes may accept only part of it
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            printf("Error: Cannot write the JPEG (errno %d).\n", errno);
+            return -1;
+        }
 
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    return 0;
 }
@@ -0,0 +1,576 @@
+#include "jpegenc.h"
+#include "jfif_handler.h"
+#include "output_sink.h"
+#include "encoder.h"
+#include "entropy.h"
+#include "rate_control.h"
+#include "parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* Output of one encode: slot 0 serves the single-image entry points, jpegenc_encode_variants
+* uses one slot per quality.
+*/
+typedef struct {
+    GROWABLE_BUFFER output;     // JFIF header, then scan data, then EOI
+    BW_SINK output_sink;        // grows 'output' when a scan outgrows it
+    int quality;                // quality of the current encode
+
+    // Staged pipeline: quantized blocks and the header built for their tables
+    int16_t *zigzag_blocks;
+    size_t zigzag_capacity;     // blocks 'zigzag_blocks' holds
+    QUANT_TABLE qt;
+    HUFFMAN_TABLE_DATA huffman_data;
+    HUFFMAN_TABLES tables;
+    JFIF_HEADER header;
+    ENTROPY_WORKSPACE entropy;  // scratch of the entropy coding threads
+    float *metrics_rows;        // MCU row buffer for measuring a staged scan
+    size_t metrics_rows_size;
+
+    QUALITY_METRICS metrics;    // luminance quality of the current encode
+} ENCODE_SLOT;
+
+struct JPEGENC_CONTEXT {
+    JPEGENC_OPTIONS options;
+    QUANT_TABLE qt;
+    QUANT_TABLE chroma_qt;
+    JFIF_HEADER header;         // SOI through SOS of the fused pipeline, copied in front of every scan
+    const KERNEL_TABLE *kernels;    // resolved from options.isa, private to this context
+
+    float *workspace;           // MCU row buffers (fused pipeline and the staged front half)
+    size_t workspace_size;
+
+    DCT_COEFFICIENTS coeffs;    // staged pipeline: front half output, shared by all variants
+    void *coeff_data;           // float or int32_t coefficients, depending on the DCT method
+    size_t coeff_capacity;      // blocks 'coeff_data' holds
+
+    ENCODE_SLOT slots[JPEGENC_MAX_VARIANTS];
+};
+
+void jpegenc_default_options(JPEGENC_OPTIONS *options, uint32_t width, uint32_t height) {
+    options->width = width;
+    options->height = height;
+    options->quality = 50;
+    options->color_mode = COLOR_MODE_GRAY;
+    options->dct_method = DCT_METHOD_FLOAT;
+    options->restart_interval = 0;
+    options->isa = SIMD_ISA_AUTO;
+    options->quality_metrics = 0;
+    options->pipeline = PIPELINE_FUSED;
+    options->threads = 1;
+    options->optimize_huffman = 0;
+    options->target_size = 0;
+}
+
+static int validate_options(const JPEGENC_OPTIONS *options) {
+    if (options->width == 0 || options->height == 0 || options->width > 65535 || options->height > 65535) {
+        printf("Error: Frame size must be 1-65535 in both dimensions.\n");
+        return -1;
+    }
+    if (options->quality < 1 || options->quality > 100) {
+        printf("Error: Quality must be 1-100.\n");
+        return -1;
+    }
+    if (options->restart_interval > 65535) {
+        printf("Error: Restart interval must be 0-65535.\n");
+        return -1;
+    }
+    if (options->color_mode < COLOR_MODE_GRAY || options->color_mode > COLOR_MODE_420) {
+        printf("Error: Unknown color mode.\n");
+        return -1;
+    }
+    if (options->pipeline != PIPELINE_STAGED && options->pipeline != PIPELINE_FUSED) {
+        printf("Error: Unknown pipeline.\n");
+        return -1;
+    }
+    if (options->threads < 0) {
+        printf("Error: Thread count must not be negative.\n");
+        return -1;
+    }
+    if (options->pipeline == PIPELINE_STAGED && options->color_mode != COLOR_MODE_GRAY) {
+        printf("Error: The staged pipeline encodes grayscale only.\n");
+        return -1;
+    }
+    if (options->pipeline == PIPELINE_FUSED && (options->optimize_huffman || options->target_size)) {
+        printf("Error: Optimized Huffman tables and target sizes need the staged pipeline.\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* Threads the staged back half runs on, 0 in the options meaning one per core.
+*/
+static int staged_threads(const JPEGENC_OPTIONS *options) {
+    return options->threads > 0 ? options->threads : cpu_count();
+}
+
+/*
+* Grows (never shrinks) a slot's output buffer and, for the staged pipeline, its quantized blocks,
+* entropy coding scratch and metrics row buffer.
+*/
+static int reserve_slot(ENCODE_SLOT *slot, const JPEGENC_OPTIONS *options) {
+    size_t output_size = JFIF_HEADER_MAX + scan_buffer_estimate(options->width, options->height, options->color_mode) + 2;
+    if (growable_buffer_reserve(&slot->output, output_size) != 0) {
+        printf("Error: Not enough memory for the output buffer.\n");
+        return -1;
+    }
+
+    size_t block_count = (size_t)((options->width + 7) / 8) * ((options->height + 7) / 8);
+    if (options->pipeline == PIPELINE_STAGED && block_count > slot->zigzag_capacity) {
+        int16_t *zigzag_blocks = (int16_t*)realloc(slot->zigzag_blocks, block_count * 64 * sizeof(int16_t));
+        if (zigzag_blocks == NULL) {
+            printf("Error: Not enough memory for quantized blocks.\n");
+            return -1;
+        }
+        slot->zigzag_blocks = zigzag_blocks;
+        slot->zigzag_capacity = block_count;
+    }
+    if (options->pipeline == PIPELINE_STAGED &&
+        entropy_workspace_reserve(&slot->entropy, (uint32_t)block_count, staged_threads(options)) != 0) {
+        return -1;
+    }
+
+    size_t rows_size = fused_workspace_size(options->width, COLOR_MODE_GRAY);
+    if (options->pipeline == PIPELINE_STAGED && options->quality_metrics && rows_size > slot->metrics_rows_size) {
+        float *rows = (float*)realloc(slot->metrics_rows, rows_size);
+        if (rows == NULL) {
+            printf("Error: Not enough memory for the MCU row workspace.\n");
+            return -1;
+        }
+        slot->metrics_rows = rows;
+        slot->metrics_rows_size = rows_size;
+    }
+    return 0;
+}
+
+/*
+* Builds tables, header and buffers for 'options'. On failure the context keeps its previous options.
+*/
+static int configure(JPEGENC_CONTEXT *ctx, const JPEGENC_OPTIONS *options) {
+    if (validate_options(options) != 0) {
+        return -1;
+    }
+
+    // Grow (never shrink) the owned buffers first, so a failure leaves the options untouched
+    size_t workspace_size = fused_workspace_size(options->width, options->color_mode);
+
+    if (workspace_size > ctx->workspace_size) {
+        float *workspace = (float*)realloc(ctx->workspace, workspace_size);
+        if (workspace == NULL) {
+            printf("Error: Not enough memory for the MCU row workspace.\n");
+            return -1;
+        }
+        ctx->workspace = workspace;
+        ctx->workspace_size = workspace_size;
+    }
+    if (reserve_slot(&ctx->slots[0], options) != 0) {
+        return -1;
+    }
+
+    // float and int32_t coefficients have the same size, so one array serves every DCT method
+    size_t block_count = (size_t)((options->width + 7) / 8) * ((options->height + 7) / 8);
+    if (options->pipeline == PIPELINE_STAGED && block_count > ctx->coeff_capacity) {
+        void *coeff_data = realloc(ctx->coeff_data, block_count * 64 * sizeof(float));
+        if (coeff_data == NULL) {
+            printf("Error: Not enough memory for DCT coefficients.\n");
+            return -1;
+        }
+        ctx->coeff_data = coeff_data;
+        ctx->coeff_capacity = block_count;
+    }
+
+    // Resolve the kernels before touching the context, an unsupported set falls back to the best one
+    const KERNEL_TABLE *kernels = options->isa == SIMD_ISA_AUTO ? get_kernels() : get_kernel_table(options->isa);
+    if (kernels == NULL) {
+        kernels = get_kernel_table(SIMD_ISA_AUTO);
+        printf("Warning: Requested instruction set is not supported by this CPU, using '%s'.\n", kernels->name);
+    }
+    ctx->kernels = kernels;
+
+    int same_tables = ctx->header.size > 0 && options->quality == ctx->options.quality &&
+                      options->color_mode == ctx->options.color_mode &&
+                      options->restart_interval == ctx->options.restart_interval;
+    ctx->options = *options;
+
+    if (same_tables) {
+        // Only the frame size changed: patch SOF0 of the existing header
+        jfif_header_set_size(&ctx->header, (uint16_t)options->width, (uint16_t)options->height);
+    } else {
+        init_quant_table(&ctx->qt, options->quality);
+        init_chroma_quant_table(&ctx->chroma_qt, options->quality);
+
+        JFIF_FRAME frame = { (uint16_t)options->width, (uint16_t)options->height, (uint16_t)options->restart_interval,
+                             options->color_mode, { &ctx->qt, &ctx->chroma_qt }, { &std_lum_huffman, &std_chrom_huffman } };
+        jfif_header_init(&ctx->header, &frame);
+    }
+    jfif_begin(&ctx->header, ctx->slots[0].output.data);
+    ctx->slots[0].output.offset = ctx->header.size;
+    return 0;
+}
+
+JPEGENC_CONTEXT* jpegenc_create(const JPEGENC_OPTIONS *options) {
+    JPEGENC_CONTEXT *ctx = (JPEGENC_CONTEXT*)calloc(1, sizeof(JPEGENC_CONTEXT));
+    if (ctx == NULL) {
+        printf("Error: Not enough memory for the encoder context.\n");
+        return NULL;
+    }
+    for (int i = 0; i < JPEGENC_MAX_VARIANTS; i++) {
+        init_growable_sink(&ctx->slots[i].output_sink, &ctx->slots[i].output);
+    }
+
+    if (configure(ctx, options) != 0) {
+        jpegenc_destroy(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+int jpegenc_reset(JPEGENC_CONTEXT *ctx, const JPEGENC_OPTIONS *options) {
+    return configure(ctx, options);
+}
+
+void jpegenc_destroy(JPEGENC_CONTEXT *ctx) {
+    if (ctx == NULL) return;
+    free(ctx->workspace);
+    free(ctx->coeff_data);
+    for (int i = 0; i < JPEGENC_MAX_VARIANTS; i++) {
+        growable_buffer_free(&ctx->slots[i].output);
+        free(ctx->slots[i].zigzag_blocks);
+        entropy_workspace_free(&ctx->slots[i].entropy);
+        free(ctx->slots[i].metrics_rows);
+    }
+    free(ctx);
+}
+
+const JPEGENC_OPTIONS* jpegenc_options(const JPEGENC_CONTEXT *ctx) {
+    return &ctx->options;
+}
+
+/*
+* Returns the slot's metrics, reset for a new encode, or NULL when they are not measured.
+*/
+static QUALITY_METRICS* begin_metrics(JPEGENC_CONTEXT *ctx, ENCODE_SLOT *slot) {
+    if (!ctx->options.quality_metrics) {
+        return NULL;
+    }
+    quality_metrics_init(&slot->metrics);
+    return &slot->metrics;
+}
+
+static void report_metrics(const JPEGENC_CONTEXT *ctx, const ENCODE_SLOT *slot, JPEGENC_OUTPUT *out) {
+    int measured = ctx->options.quality_metrics;
+    out->quality = slot->quality;
+    out->psnr = measured ? quality_metrics_psnr(&slot->metrics) : 0.0;
+    out->ssim = measured ? quality_metrics_ssim(&slot->metrics) : 0.0;
+}
+
+/*
+* Flushes the scan written after 'header', appends EOI and describes the finished file.
+*/
+static int finish_output(const JPEGENC_CONTEXT *ctx, ENCODE_SLOT *slot, const JFIF_HEADER *header, BitWriter *bw,
+                         JPEGENC_OUTPUT *out) {
+    bw_flush(bw);
+    bw_reserve(bw, 2);                  // EOI
+    if (bw_finish(bw) != 0) {
+        return -1;
+    }
+
+    out->data = slot->output.data;
+    out->size = jfif_finish(header, slot->output.data, bw->byte_pos);
+    out->scan_size = bw->byte_pos;
+    report_metrics(ctx, slot, out);
+    return 0;
+}
+
+/*
+* Staged front half: DCT coefficients of the whole image into the context.
+*/
+static int staged_transform(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source) {
+    const JPEGENC_OPTIONS *o = &ctx->options;
+    int int_dct = o->dct_method == DCT_METHOD_ISLOW || o->dct_method == DCT_METHOD_IFAST;
+
+    // Metrics compare the quantized blocks with the source once the whole image is transformed
+    if (o->quality_metrics && source->single_pass) {
+        printf("Error: Staged quality metrics read the source twice, a single-pass source cannot be used.\n");
+        return -1;
+    }
+
+    ctx->coeffs.coeffs = int_dct ? NULL : (float*)ctx->coeff_data;
+    ctx->coeffs.coeffs_int = int_dct ? (int32_t*)ctx->coeff_data : NULL;
+    return compute_dct_coefficients(source, o->width, o->height, o->dct_method, ctx->kernels, ctx->workspace,
+                                    &ctx->coeffs);
+}
+
+/*
+* Staged back half up to the scan: quantization at 'quality', Huffman tables and the slot's header.
+*/
+static int staged_prepare(const JPEGENC_CONTEXT *ctx, ENCODE_SLOT *slot, int quality, const SCAN_SETTINGS *settings) {
+    const JPEGENC_OPTIONS *o = &ctx->options;
+
+    slot->quality = quality;
+    init_quant_table(&slot->qt, quality);
+    quantize_coefficients(&ctx->coeffs, &slot->qt, ctx->kernels, settings->threads, slot->zigzag_blocks);
+
+    if (select_huffman_tables(slot->zigzag_blocks, ctx->coeffs.block_count, settings, &slot->huffman_data,
+                              &slot->tables) != 0) {
+        return -1;
+    }
+
+    JFIF_FRAME frame = { (uint16_t)o->width, (uint16_t)o->height, (uint16_t)o->restart_interval,
+                         COLOR_MODE_GRAY, { &slot->qt, NULL }, { &slot->tables, NULL } };
+    jfif_header_init(&slot->header, &frame);
+    return 0;
+}
+
+/*
+* Staged scan of a prepared slot, measured against the source with quality_metrics.
+*/
+static int staged_scan(JPEGENC_CONTEXT *ctx, ENCODE_SLOT *slot, const ROW_SOURCE *source,
+                       const SCAN_SETTINGS *settings, BitWriter *bw) {
+    const JPEGENC_OPTIONS *o = &ctx->options;
+
+    if (encode_blocks(slot->zigzag_blocks, ctx->coeffs.block_count, o->restart_interval, &slot->tables,
+                      settings->threads, settings->entropy, bw) != 0) {
+        return -1;
+    }
+
+    QUALITY_METRICS *metrics = begin_metrics(ctx, slot);
+    if (metrics != NULL) {
+        return measure_quality_rows(source, o->width, o->height, slot->zigzag_blocks, &slot->qt, ctx->kernels,
+                                    slot->metrics_rows, metrics);
+    }
+    return 0;
+}
+
+/*
+* Staged pipeline up to the scan of slot 0: front half, quality (searched with target_size) and tables.
+*/
+static int staged_begin(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source, SCAN_SETTINGS *settings) {
+    const JPEGENC_OPTIONS *o = &ctx->options;
+    ENCODE_SLOT *slot = &ctx->slots[0];
+
+    settings->restart_interval = o->restart_interval;
+    settings->optimize_huffman = o->optimize_huffman;
+    settings->threads = staged_threads(o);
+    settings->entropy = &slot->entropy;
+
+    if (staged_transform(ctx, source) != 0) {
+        return -1;
+    }
+
+    // Rate control bisects over the cached coefficients, using the slot's blocks as scratch
+    int quality = o->quality;
+    if (o->target_size) {
+        quality = find_quality_for_size(&ctx->coeffs, ctx->kernels, settings, o->target_size, slot->zigzag_blocks);
+
+        if (quality == 1 && predict_file_size(&ctx->coeffs, quality, ctx->kernels, settings, slot->zigzag_blocks) >
+                            o->target_size) {
+            printf("Warning: Target size of %u bytes cannot be reached.\n", o->target_size);
+        }
+    }
+
+    return staged_prepare(ctx, slot, quality, settings);
+}
+
+/*
+* Runs the fused pipeline for the context's color mode.
+*/
+static int encode_rows_scan(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source, BitWriter *bw) {
+    const JPEGENC_OPTIONS *o = &ctx->options;
+    ENCODE_SLOT *slot = &ctx->slots[0];
+
+    slot->quality = o->quality;
+    if (o->color_mode == COLOR_MODE_GRAY) {
+        return encode_fused(source, o->width, o->height, o->dct_method, ctx->kernels, &ctx->qt, o->restart_interval,
+                            ctx->workspace, begin_metrics(ctx, slot), bw);
+    }
+    return encode_fused_color(source, o->width, o->height, o->dct_method, o->color_mode, ctx->kernels,
+                              &ctx->qt, &ctx->chroma_qt, o->restart_interval, ctx->workspace,
+                              begin_metrics(ctx, slot), bw);
+}
+
+int jpegenc_encode_rows(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source, JPEGENC_OUTPUT *out) {
+    ENCODE_SLOT *slot = &ctx->slots[0];
+    BitWriter bw;
+
+    if (ctx->options.pipeline == PIPELINE_STAGED) {
+        // The header depends on the chosen quality and tables, so it is written per image
+        SCAN_SETTINGS settings;
+        if (staged_begin(ctx, source, &settings) != 0) {
+            return -1;
+        }
+        jfif_begin(&slot->header, slot->output.data);
+        slot->output.offset = slot->header.size;
+
+        bw_init_sink(&bw, &slot->output_sink);
+        if (staged_scan(ctx, slot, source, &settings, &bw) != 0) {
+            return -1;
+        }
+        return finish_output(ctx, slot, &slot->header, &bw, out);
+    }
+
+    // The scan is written in place right after the header
+    bw_init_sink(&bw, &slot->output_sink);
+
+    if (encode_rows_scan(ctx, source, &bw) != 0) {
+        return -1;
+    }
+    return finish_output(ctx, slot, &ctx->header, &bw, out);
+}
+
+int jpegenc_stream_rows(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source, int fd, JPEGENC_OUTPUT *out) {
+    static const uint8_t eoi[2] = { 0xFF, 0xD9 };
+    int staged = ctx->options.pipeline == PIPELINE_STAGED;
+    const JFIF_HEADER *header = staged ? &ctx->slots[0].header : &ctx->header;
+    SCAN_SETTINGS settings;
+    FD_SINK ring;
+    BW_SINK sink;
+    BitWriter bw;
+
+    // The staged pipeline needs its tables (the whole image) before the header can go out
+    if (staged && staged_begin(ctx, source, &settings) != 0) {
+        return -1;
+    }
+
+    if (fd_sink_open(&ring, fd, FD_SINK_CHUNK_SIZE, FD_SINK_CHUNK_COUNT) != 0) {
+        return -1;
+    }
+    init_fd_sink(&sink, &ring);
+    bw_init_sink(&bw, &sink);
+
+    // Header, scan and EOI all go through the ring, in order
+    bw_write_bytes(&bw, header->bytes, header->size);
+    int status = staged ? staged_scan(ctx, &ctx->slots[0], source, &settings, &bw) : encode_rows_scan(ctx, source, &bw);
+    bw_flush(&bw);
+
+    uint64_t scan_size = bw_total_bytes(&bw) - header->size;
+    bw_write_bytes(&bw, eoi, sizeof(eoi));
+
+    if (bw_finish(&bw) != 0) status = -1;
+    if (fd_sink_close(&ring) != 0) status = -1;
+    if (status != 0) {
+        return -1;
+    }
+
+    out->data = NULL;
+    out->size = (size_t)bw_total_bytes(&bw);
+    out->scan_size = (size_t)scan_size;
+    report_metrics(ctx, &ctx->slots[0], out);
+    return 0;
+}
+
+int jpegenc_encode_bgr(JPEGENC_CONTEXT *ctx, const uint8_t *bgr, size_t stride, JPEGENC_OUTPUT *out) {
+    ROW_SOURCE source;
+    BMP_MEMORY_SOURCE state;
+
+    init_bmp_memory_source(&source, &state, bgr, ctx->options.width, ctx->options.height, 0);
+    state.row_stride = stride ? (uint32_t)stride : ctx->options.width * 3;
+
+    return jpegenc_encode_rows(ctx, &source, out);
+}
+
+int jpegenc_encode_yuv(JPEGENC_CONTEXT *ctx, const YUV_IMAGE *image, JPEGENC_OUTPUT *out) {
+    if (ctx->options.pipeline != PIPELINE_FUSED) {
+        printf("Error: YUV input needs the fused pipeline.\n");
+        return -1;
+    }
+    if (image->width != ctx->options.width || image->height != ctx->options.height) {
+        printf("Error: Image is %ux%u, the encoder is set up for %ux%u.\n",
+               image->width, image->height, ctx->options.width, ctx->options.height);
+        return -1;
+    }
+
+    // The frame header has to describe the planes' own sampling
+    if (ctx->options.color_mode != COLOR_MODE_GRAY && ctx->options.color_mode != image->sampling) {
+        JPEGENC_OPTIONS options = ctx->options;
+        options.color_mode = image->sampling;
+        if (configure(ctx, &options) != 0) {
+            return -1;
+        }
+    }
+
+    ENCODE_SLOT *slot = &ctx->slots[0];
+    BitWriter bw;
+    bw_init_sink(&bw, &slot->output_sink);
+
+    slot->quality = ctx->options.quality;
+    if (encode_planes(image, ctx->options.dct_method, ctx->kernels, ctx->options.color_mode, &ctx->qt, &ctx->chroma_qt,
+                      ctx->options.restart_interval, begin_metrics(ctx, slot), &bw) != 0) {
+        return -1;
+    }
+    return finish_output(ctx, slot, &ctx->header, &bw, out);
+}
+
+typedef struct {
+    JPEGENC_CONTEXT *ctx;
+    const ROW_SOURCE *source;
+    const int *qualities;
+    JPEGENC_OUTPUT *outs;
+    SCAN_SETTINGS settings;     // threads per variant, each variant codes with its slot's entropy scratch
+    int failed;
+} VARIANT_JOB;
+
+/*
+* Back half for one variant: quantize the shared coefficients at the variant's quality and
+* entropy code them into the variant's slot.
+*/
+static void encode_variant_task(void *ctx, uint32_t index) {
+    VARIANT_JOB *job = (VARIANT_JOB*)ctx;
+    ENCODE_SLOT *slot = &job->ctx->slots[index];
+    SCAN_SETTINGS settings = job->settings;
+    BitWriter bw;
+
+    settings.entropy = &slot->entropy;
+    int status = staged_prepare(job->ctx, slot, job->qualities[index], &settings);
+    if (status == 0) {
+        jfif_begin(&slot->header, slot->output.data);
+        slot->output.offset = slot->header.size;
+
+        bw_init_sink(&bw, &slot->output_sink);
+        status = staged_scan(job->ctx, slot, job->source, &settings, &bw);
+    }
+    if (status == 0) {
+        status = finish_output(job->ctx, slot, &slot->header, &bw, &job->outs[index]);
+    }
+    if (status != 0) job->failed = 1;
+}
+
+int jpegenc_encode_variants(JPEGENC_CONTEXT *ctx, const ROW_SOURCE *source, const int *qualities, uint32_t count,
+                            JPEGENC_OUTPUT *outs) {
+    const JPEGENC_OPTIONS *o = &ctx->options;
+
+    if (o->pipeline != PIPELINE_STAGED) {
+        printf("Error: Variants need the staged pipeline.\n");
+        return -1;
+    }
+    if (count < 1 || count > JPEGENC_MAX_VARIANTS) {
+        printf("Error: Variant count must be 1-%d.\n", JPEGENC_MAX_VARIANTS);
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (qualities[i] < 1 || qualities[i] > 100) {
+            printf("Error: Quality must be 1-100.\n");
+            return -1;
+        }
+        if (reserve_slot(&ctx->slots[i], o) != 0) {
+            return -1;
+        }
+    }
+
+    if (staged_transform(ctx, source) != 0) {
+        return -1;
+    }
+
+    // Variants run concurrently and split the threads between them
+    int threads = staged_threads(o);
+    int variant_threads = threads < (int)count ? threads : (int)count;
+
+    VARIANT_JOB job = { ctx, source, qualities, outs,
+                        { o->restart_interval, o->optimize_huffman, threads / variant_threads, NULL }, 0 };
+    parallel_for(count, variant_threads, encode_variant_task, &job);
+
+    return job.failed ? -1 : 0;
+}
@@ -1,88 +1,556 @@
 #include "dct.h"
 #include "bmp_handler.h"
-#include "grayscale.h"
-#include "jfif_handler.h"
-#include "color_spaces.h"
+#include "pipeline.h"
+#include "bmp_stream.h"
+#include "simd.h"
+#include "yuv_input.h"
+#include "mjpeg.h"
+#include "jpegenc.h"
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-int main(int argc, char **argv) {
-    PARAMETERS params = parse_parameters(argc, argv);
+/*
+* Encoder context options, taken from the command line.
+*/
+static void init_context_options(JPEGENC_OPTIONS *options, const PARAMETERS *params, uint32_t width, uint32_t height) {
+    jpegenc_default_options(options, width, height);
+    options->quality = params->quality;
+    options->color_mode = params->color_mode;
+    options->dct_method = params->dct_method;
+    options->restart_interval = params->restart_interval;
+    options->isa = get_kernels()->isa;         // the set main selected, so an unsupported -isa only warns once
+    options->quality_metrics = params->quality_metrics;
+    options->pipeline = params->pipeline;
+    options->threads = params->threads;
+    options->optimize_huffman = params->optimize_huffman;
+    options->target_size = params->target_size;
+}
 
-    BMP_IMAGE image = load_bmp_image(params.inputFile); 
+static void print_size_report(const PARAMETERS *params, uint32_t width, uint32_t height, size_t scan_size) {
+    printf("Encoding completed.\n");
+    if (params->color_mode == COLOR_MODE_GRAY) {
+        printf("Original size (Raw Y): %u bytes\n", width * height);
+    } else {
+        printf("Original size (Raw RGB): %u bytes\n", width * height * 3);
+    }
+    printf("Compressed size (Scan Data): %zu bytes\n", scan_size);
+}
 
-    // pixels is dyn. allocated - needs to be freed
-    RGB* pixels = read_pixels(image.buffer, image.info.width, image.info.height, image.info.height <= 0);
+/*
+* Prints the luminance quality measured during encoding (-metrics).
+*/
+static void print_quality_report(double psnr, double ssim) {
+    printf("Quality (Y): PSNR %.2f dB, block-SSIM %.4f\n", psnr, ssim);
+}
 
-    printf("BMP image imported.\n");
+/*
+* Prints the size report and writes a complete JPEG produced by an encoder context.
+*/
+static void write_jpeg_output(const PARAMETERS *params, const JPEGENC_OUTPUT *jpeg, uint32_t width, uint32_t height) {
+    print_size_report(params, width, height, jpeg->scan_size);
+    if (params->quality_metrics) {
+        print_quality_report(jpeg->psnr, jpeg->ssim);
+    }
 
-    // grayscale_y is dyn. allocated - needs to be freed
-    float* grayscale_y = convert_to_grayscale(pixels, image.info.width, image.info.height);
-    free(pixels);
+    FILE *f_out = fopen(params->outputFile, "wb");
+    if(f_out) {
+        fwrite(jpeg->data, 1, jpeg->size, f_out);
+        fclose(f_out);
+        printf("JFIF serialization completed.\n");
+    }
+}
 
-    // In-place transformation
-    center_around_zero(grayscale_y, image.info.width, image.info.height);
+/*
+* Encodes one image from a row source with a single-use encoder context and writes it.
+* Streamed input is also streamed out: the JPEG goes to the file through the output ring
+* instead of being assembled in memory first.
+*/
+static int encode_rows_to_file(const PARAMETERS *params, const ROW_SOURCE *source, uint32_t width, uint32_t height) {
+    JPEGENC_OPTIONS options;
+    JPEGENC_OUTPUT jpeg;
 
-    printf("Pixels converted to Y and centered around zero.\n");
+    init_context_options(&options, params, width, height);
+    JPEGENC_CONTEXT *ctx = jpegenc_create(&options);
+    if (ctx == NULL) {
+        return -1;
+    }
 
-    uint32_t blocks_w;           
-    uint32_t blocks_h;
-    float* blocks;
-    image_to_blocks(grayscale_y, image.info.width, image.info.height, &blocks_h, &blocks_w, &blocks);
-    free(grayscale_y);
+    int status;
+    if (params->input_mode == INPUT_LOAD) {
+        status = jpegenc_encode_rows(ctx, source, &jpeg);
+        if (status == 0) {
+            if (params->target_size) {
+                printf("Quality %d selected for a target of %u bytes.\n", jpeg.quality, params->target_size);
+            }
+            write_jpeg_output(params, &jpeg, width, height);
+        }
+    } else {
+        int fd = open(params->outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            printf("Error: Cannot open output file '%s'.\n", params->outputFile);
+            jpegenc_destroy(ctx);
+            return -1;
+        }
+        status = jpegenc_stream_rows(ctx, source, fd, &jpeg);
+        if (close(fd) != 0) status = -1;
+        if (status == 0) {
+            print_size_report(params, width, height, jpeg.scan_size);
+            if (params->quality_metrics) {
+                print_quality_report(jpeg.psnr, jpeg.ssim);
+            }
+            printf("JFIF serialization completed.\n");
+        }
+    }
 
-    printf("Image segmantation completed.\n");
-    
-    float *dct_coeffs = (float*)calloc(1, blocks_w * blocks_h * 64 * sizeof(float));
-    perform_dct(blocks, blocks_w, blocks_h, dct_coeffs);
-    free(blocks);
+    jpegenc_destroy(ctx);
+    return status;
+}
 
-    printf("DCT completed.\n");
+/*
+* Multi-quality mode: color conversion and DCT run once, then every -variant gets its own
+* quantization, entropy coding and file. With more threads than one the variants are encoded
+* concurrently and share the threads between them.
+*/
+static int encode_variants(const PARAMETERS *params, const ROW_SOURCE *source, uint32_t width, uint32_t height) {
+    JPEGENC_OPTIONS options;
+    JPEGENC_OUTPUT jpegs[MAX_VARIANTS];
 
-    uint32_t buffer_size = image.info.width * image.info.height * 2; 
-    if (buffer_size < 4096) buffer_size = 4096; // Minimum 4KB
+    init_context_options(&options, params, width, height);
+    JPEGENC_CONTEXT *ctx = jpegenc_create(&options);
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    int status = jpegenc_encode_variants(ctx, source, params->variant_quality, (uint32_t)params->variant_count, jpegs);
 
-    uint8_t *encoded_buffer = (uint8_t*)malloc(buffer_size);
-    
-    BitWriter bw;
-    bw.buffer = encoded_buffer;
-    bw.byte_pos = 0;
-    bw.bit_pos = 0;
-    bw.current = 0;
+    for (int i = 0; status == 0 && i < params->variant_count; i++) {
+        const char *path = params->variant_output[i];
+        FILE *f_out = fopen(path, "wb");
+        if (f_out == NULL || fwrite(jpegs[i].data, 1, jpegs[i].size, f_out) != jpegs[i].size) {
+            printf("Error: Cannot write '%s'.\n", path);
+            status = -1;
+        }
+        if (f_out != NULL && fclose(f_out) != 0) status = -1;
+        if (status != 0) break;
 
-    int16_t prev_dc = 0;
-    uint32_t total_blocks = blocks_w * blocks_h;
+        if (params->quality_metrics) {
+            printf("Variant quality %d: %zu bytes of scan data written to %s (Y: PSNR %.2f dB, block-SSIM %.4f).\n",
+                   jpegs[i].quality, jpegs[i].scan_size, path, jpegs[i].psnr, jpegs[i].ssim);
+        } else {
+            printf("Variant quality %d: %zu bytes of scan data written to %s.\n", jpegs[i].quality, jpegs[i].scan_size, path);
+        }
+    }
 
-    int16_t quantized_block[64];
-    int16_t zigzag_block[64];
+    jpegenc_destroy(ctx);
+    if (status == 0) {
+        printf("Encoding of %d variants completed.\n", params->variant_count);
+    }
+    return status;
+}
 
-    for (uint32_t i = 0; i < total_blocks; i++) {
-        float *current_dct_ptr = &dct_coeffs[i * 64];
+/*
+* Streaming modes feeding the fused pipeline without loading the pixel array:
+*   - strip reader: BMP strips are read on a separate thread, memory use does not depend on image height
+*   - mmap: BGR bytes are read straight from the mapped file (zero copy)
+*/
+static int encode_streaming(PARAMETERS *params) {
+    BMP_STRIP_READER reader;
+    BMP_MAPPED_IMAGE mapped;
+    ROW_SOURCE source;
+    uint32_t width, height;
 
-        quantize_block(current_dct_ptr, quantized_block);
+    if (params->input_mode == INPUT_MMAP) {
+        if (bmp_mmap_open(&mapped, params->inputFile) != 0) {
+            return -1;
+        }
+        init_bmp_mmap_source(&source, &mapped);
+        width = mapped.width;
+        height = mapped.height;
+    } else {
+        if (bmp_strip_open(&reader, params->inputFile) != 0) {
+            return -1;
+        }
+        init_bmp_strip_source(&source, &reader);
+        width = reader.width;
+        height = reader.height;
+    }
 
-        zigzag_order(quantized_block, zigzag_block);
+    int status = encode_rows_to_file(params, &source, width, height);
 
-        prev_dc = encode_coefficients(zigzag_block, prev_dc, &bw);
+    if (params->input_mode == INPUT_MMAP) {
+        bmp_mmap_close(&mapped);
+    } else {
+        bmp_strip_close(&reader);
     }
 
-    if (bw.bit_pos > 0) {
-        bw_put_byte(&bw, bw.current);
+    return status;
+}
+
+/*
+* Raw YUV input: the planes of the first frame go straight to the block stage.
+* The JPEG keeps the source's chroma sampling, or only its Y plane with -color gray.
+*/
+static int encode_yuv(PARAMETERS *params) {
+    YUV_READER reader;
+    YUV_IMAGE image;
+
+    if (yuv_open(&reader, params->inputFile, params->input_format, params->input_width, params->input_height) != 0) {
+        return -1;
     }
 
-    printf("Encoding completed.\n");
-    printf("Original size (Raw Y): %u bytes\n", image.info.width * image.info.height);
-    printf("Compressed size (Scan Data): %u bytes\n", bw.byte_pos);
+    int status = yuv_read_frame(&reader, &image);
+    if (status != 0) {
+        if (status == 1) {
+            printf("Error: Input contains no frame.\n");
+        }
+        yuv_close(&reader);
+        return -1;
+    }
+    printf("YUV frame imported (%ux%u, %s).\n", image.width, image.height, color_mode_name(image.sampling));
 
-    FILE *f_out = fopen(params.outputFile, "wb");
-    if(f_out) {
-        write_to_jfif(f_out, bw.buffer, bw.byte_pos, image.info.width, image.info.height);
-        fclose(f_out);
-        printf("JFIF serialization completed.\n");
+    if (params->color_mode != COLOR_MODE_GRAY && params->color_mode != image.sampling) {
+        printf("Warning: Input is sampled %s, encoding with its sampling instead of %s.\n",
+               color_mode_name(image.sampling), color_mode_name(params->color_mode));
+    }
+    if (params->color_mode != COLOR_MODE_GRAY) {
+        params->color_mode = image.sampling;
     }
 
-    free(dct_coeffs);
-    free(encoded_buffer);
-    free(image.buffer);
+    JPEGENC_OPTIONS options;
+    JPEGENC_OUTPUT jpeg;
+    init_context_options(&options, params, image.width, image.height);
 
+    JPEGENC_CONTEXT *ctx = jpegenc_create(&options);
+    status = ctx != NULL ? jpegenc_encode_yuv(ctx, &image, &jpeg) : -1;
+    if (status == 0) {
+        write_jpeg_output(params, &jpeg, image.width, image.height);
+    }
+
+    jpegenc_destroy(ctx);
+    yuv_close(&reader);
+    return status;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+* Nearest-rank percentile (1-100) of 'count' > 0 sorted samples, as in bench_stats.c.
+*/
+static uint64_t percentile_u64(const uint64_t *sorted, uint32_t count, uint32_t p) {
+    uint64_t rank = ((uint64_t)p * count + 99) / 100;
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+/*
+* Frame source of an MJPEG sequence: frames of a YUV file, or BMP files named by a printf
+* pattern with one integer conversion (e.g. frame_%04d.bmp, numbered from 0 or 1).
+* A BMP name without '%' is a sequence of one frame.
+*/
+typedef struct {
+    int yuv;
+    YUV_READER reader;
+    YUV_IMAGE image;
+
+    const char *pattern;
+    uint32_t next_index;
+    char path[4096];
+    BMP_MAPPED_IMAGE mapped;
+    int mapped_open;
+} FRAME_SOURCE;
+
+static int frame_path(FRAME_SOURCE *frames, uint32_t index) {
+    if (strchr(frames->pattern, '%') == NULL) {
+        if (index > 0) return -1;
+        snprintf(frames->path, sizeof(frames->path), "%s", frames->pattern);
+        return 0;
+    }
+    int length = snprintf(frames->path, sizeof(frames->path), frames->pattern, (int)index);
+    return length < 0 || (size_t)length >= sizeof(frames->path) ? -1 : 0;
+}
+
+static int file_exists(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return 0;
+    fclose(f);
+    return 1;
+}
+
+static int open_frames(FRAME_SOURCE *frames, const PARAMETERS *params) {
+    memset(frames, 0, sizeof(*frames));
+
+    if (params->input_format != INPUT_FORMAT_BMP) {
+        frames->yuv = 1;
+        return yuv_open(&frames->reader, params->inputFile, params->input_format,
+                        params->input_width, params->input_height);
+    }
+
+    // Numbering starts at 0, or at 1 when there is no frame 0
+    frames->pattern = params->inputFile;
+    if (frame_path(frames, 0) == 0 && !file_exists(frames->path)) {
+        frames->next_index = 1;
+    }
+    return 0;
+}
+
+/*
+* Makes the next frame available: a YUV image, or a mapped BMP with a row source over it.
+* Returns 0 on success, 1 when the sequence ends, -1 on error.
+*/
+static int next_frame(FRAME_SOURCE *frames, ROW_SOURCE *source) {
+    if (frames->yuv) {
+        return yuv_read_frame(&frames->reader, &frames->image);
+    }
+
+    if (frames->mapped_open) {
+        bmp_mmap_close(&frames->mapped);
+        frames->mapped_open = 0;
+    }
+
+    if (frame_path(frames, frames->next_index) != 0 || !file_exists(frames->path)) {
+        return 1;
+    }
+    frames->next_index++;
+
+    if (bmp_mmap_open(&frames->mapped, frames->path) != 0) {
+        return -1;
+    }
+    frames->mapped_open = 1;
+    init_bmp_mmap_source(source, &frames->mapped);
     return 0;
 }
+
+static void close_frames(FRAME_SOURCE *frames) {
+    if (frames->yuv) {
+        yuv_close(&frames->reader);
+    } else if (frames->mapped_open) {
+        bmp_mmap_close(&frames->mapped);
+    }
+}
+
+/*
+* MJPEG mode: encodes every frame of the input into one stream.
+* One encoder context is set up for the first frame (quantization tables, JFIF header bytes,
+* workspace and output buffer) and reused by all the others; later frames must have the same size.
+* Reports sustained throughput (everything, reading included) and per-frame latency (encode + write).
+*/
+static int encode_sequence(PARAMETERS *params) {
+    FRAME_SOURCE frames;
+    ROW_SOURCE source;
+
+    if (open_frames(&frames, params) != 0) {
+        return -1;
+    }
+
+    uint64_t start = now_ns();
+    int status = next_frame(&frames, &source);
+    if (status != 0) {
+        if (status == 1) {
+            printf("Error: Input contains no frame.\n");
+        }
+        close_frames(&frames);
+        return -1;
+    }
+
+    uint32_t width = frames.yuv ? frames.image.width : frames.mapped.width;
+    uint32_t height = frames.yuv ? frames.image.height : frames.mapped.height;
+    if (frames.yuv && params->color_mode != COLOR_MODE_GRAY) {
+        params->color_mode = frames.image.sampling;         // YUV input keeps its own sampling
+    }
+
+    uint32_t fps_num = params->fps ? params->fps : 25;
+    uint32_t fps_den = 1;
+    if (!params->fps && frames.yuv && frames.reader.fps_num) {
+        fps_num = frames.reader.fps_num;
+        fps_den = frames.reader.fps_den;
+    }
+
+    JPEGENC_OPTIONS options;
+    init_context_options(&options, params, width, height);
+
+    MJPEG_WRITER writer;
+    JPEGENC_CONTEXT *ctx = jpegenc_create(&options);
+    uint32_t latency_capacity = 1024;
+    uint64_t *latency = (uint64_t*)malloc(latency_capacity * sizeof(uint64_t));
+    if (ctx == NULL || latency == NULL) {
+        printf("Error: Not enough memory for the frame buffers.\n");
+        jpegenc_destroy(ctx);
+        free(latency);
+        close_frames(&frames);
+        return -1;
+    }
+    if (mjpeg_open(&writer, params->outputFile, params->container, width, height, fps_num, fps_den) != 0) {
+        jpegenc_destroy(ctx);
+        free(latency);
+        close_frames(&frames);
+        return -1;
+    }
+
+    uint32_t count = 0;
+    JPEGENC_OUTPUT jpeg;
+    double psnr_sum = 0.0, psnr_min = 0.0, ssim_sum = 0.0;
+
+    while (status == 0) {
+        uint32_t frame_w = frames.yuv ? frames.image.width : frames.mapped.width;
+        uint32_t frame_h = frames.yuv ? frames.image.height : frames.mapped.height;
+        if (frame_w != width || frame_h != height) {
+            printf("Error: Frame %u is %ux%u, the sequence is %ux%u.\n", count, frame_w, frame_h, width, height);
+            status = -1;
+            break;
+        }
+
+        uint64_t frame_start = now_ns();
+        if (frames.yuv) {
+            status = jpegenc_encode_yuv(ctx, &frames.image, &jpeg);
+        } else {
+            status = jpegenc_encode_rows(ctx, &source, &jpeg);
+        }
+        if (status != 0) break;
+
+        status = mjpeg_write_frame(&writer, jpeg.data, (uint32_t)jpeg.size);
+        if (status != 0) break;
+
+        if (count == latency_capacity) {
+            uint64_t *grown = (uint64_t*)realloc(latency, 2 * latency_capacity * sizeof(uint64_t));
+            if (grown == NULL) {
+                printf("Error: Not enough memory for frame statistics.\n");
+                status = -1;
+                break;
+            }
+            latency = grown;
+            latency_capacity *= 2;
+        }
+
+        latency[count++] = now_ns() - frame_start;
+        psnr_sum += jpeg.psnr;
+        ssim_sum += jpeg.ssim;
+        if (count == 1 || jpeg.psnr < psnr_min) psnr_min = jpeg.psnr;
+
+        if (params->max_frames && count == params->max_frames) break;
+        status = next_frame(&frames, &source);
+    }
+
+    if (mjpeg_close(&writer) != 0) status = -1;
+    close_frames(&frames);
+    jpegenc_destroy(ctx);
+
+    if (status < 0) {
+        free(latency);
+        return -1;
+    }
+
+    double seconds = (double)(now_ns() - start) / 1e9;
+    qsort(latency, count, sizeof(uint64_t), compare_u64);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++) total += latency[i];
+
+    printf("Encoded %u frames (%ux%u, %s) in %.3f s: %.1f fps sustained.\n",
+           count, width, height, color_mode_name(params->color_mode), seconds, count / seconds);
+    printf("Frame latency: min %.3f ms, avg %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms\n",
+           latency[0] / 1e6, (double)total / count / 1e6, percentile_u64(latency, count, 50) / 1e6,
+           percentile_u64(latency, count, 95) / 1e6, latency[count - 1] / 1e6);
+    if (params->quality_metrics) {
+        printf("Quality (Y): mean PSNR %.2f dB (min %.2f dB), mean block-SSIM %.4f\n",
+               psnr_sum / count, psnr_min, ssim_sum / count);
+    }
+    printf("%s stream written to %s.\n", params->container == OUTPUT_MJPEG_AVI ? "AVI" : "MJPEG", params->outputFile);
+
+    free(latency);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    PARAMETERS params = parse_parameters(argc, argv);
+
+    const KERNEL_TABLE *kernels = select_kernels(params.isa);
+    printf("Using %s kernels.\n", kernels->name);
+
+    // Streaming input feeds the fused pipeline, whatever the order of -stream / -mmap and -pipeline
+    if (params.input_mode != INPUT_LOAD && params.pipeline == PIPELINE_STAGED) {
+        printf("Warning: Streaming input uses the fused pipeline.\n");
+        params.pipeline = PIPELINE_FUSED;
+    }
+
+    if (params.input_format != INPUT_FORMAT_BMP || params.container != OUTPUT_JPEG) {
+        if (params.variant_count > 0) {
+            printf("Warning: Variants need single BMP input, ignoring them.\n");
+            params.variant_count = 0;
+        }
+        params.pipeline = PIPELINE_FUSED;          // YUV planes and MJPEG frames are encoded in a single pass
+    }
+
+    if (params.color_mode != COLOR_MODE_GRAY) {
+        if (params.variant_count > 0) {
+            printf("Warning: Variants are encoded in grayscale, ignoring the color mode.\n");
+            params.color_mode = COLOR_MODE_GRAY;
+        } else {
+            params.pipeline = PIPELINE_FUSED;      // color conversion and downsampling are fused with the DCT
+        }
+    }
+
+    if (params.variant_count > 0 && (params.pipeline == PIPELINE_FUSED || params.target_size)) {
+        printf("Warning: Variants use the staged pipeline and their own qualities.\n");
+        params.pipeline = PIPELINE_STAGED;
+        params.input_mode = INPUT_LOAD;
+        params.target_size = 0;
+    }
+
+    if (params.optimize_huffman && params.pipeline == PIPELINE_FUSED) {
+        printf("Warning: Optimized Huffman tables need the staged pipeline, using standard tables.\n");
+        params.optimize_huffman = 0;
+    }
+
+    if (params.target_size && params.pipeline == PIPELINE_FUSED) {
+        printf("Warning: Target size needs the staged pipeline, using quality %d.\n", params.quality);
+        params.target_size = 0;
+    }
+
+    if (params.container != OUTPUT_JPEG) {
+        return encode_sequence(&params);
+    }
+
+    if (params.input_format != INPUT_FORMAT_BMP) {
+        return encode_yuv(&params);
+    }
+
+    if (params.input_mode != INPUT_LOAD) {
+        return encode_streaming(&params);
+    }
+
+    BMP_IMAGE image = load_bmp_image(params.inputFile); 
+    if (image.buffer == NULL) {
+        printf("Error: Failed to load image data.\n");
+        return -1;
+    }
+
+    // Negative height marks a top-down BMP
+    uint32_t width = (uint32_t)image.info.width;
+    uint32_t height = (uint32_t)(image.info.height < 0 ? -image.info.height : image.info.height);
+
+    ROW_SOURCE source;
+    BMP_MEMORY_SOURCE source_state;
+    init_bmp_memory_source(&source, &source_state, image.buffer, width, height, image.info.height > 0);
+
+    int status;
+    if (params.variant_count > 0) {
+        status = encode_variants(&params, &source, width, height);
+    } else {
+        status = encode_rows_to_file(&params, &source, width, height);
+    }
+
+    free(image.buffer);
+    return status;
+}
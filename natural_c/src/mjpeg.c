@@ -0,0 +1,225 @@
+#include "mjpeg.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* Fixed AVI layout written by mjpeg_open (byte offsets from the start of the file):
+*   0   RIFF <size> AVI
+*   12  LIST <size> hdrl
+*   24      avih (56 bytes)
+*   88      LIST <size> strl
+*   100         strh (56 bytes)
+*   164         strf (40 bytes, BITMAPINFOHEADER)
+*   212 LIST <size> movi
+*   224     00dc chunks ...
+*       idx1
+* Fields that depend on the frame count are patched by mjpeg_close.
+*/
+#define AVI_RIFF_SIZE_POS       4
+#define AVI_HDRL_SIZE           192
+#define AVI_STRL_SIZE           116
+#define AVI_TOTAL_FRAMES_POS    48
+#define AVI_AVIH_BUFFER_POS     60
+#define AVI_STRH_LENGTH_POS     140
+#define AVI_STRH_BUFFER_POS     144
+#define AVI_MOVI_SIZE_POS       216
+
+#define AVIF_HASINDEX           0x10
+#define AVIIF_KEYFRAME          0x10
+
+static void put_le16(FILE *f, uint16_t v) {
+    fputc(v & 0xFF, f);
+    fputc((v >> 8) & 0xFF, f);
+}
+
+static void put_le32(FILE *f, uint32_t v) {
+    fputc(v & 0xFF, f);
+    fputc((v >> 8) & 0xFF, f);
+    fputc((v >> 16) & 0xFF, f);
+    fputc((v >> 24) & 0xFF, f);
+}
+
+static void put_fourcc(FILE *f, const char *fourcc) {
+    fwrite(fourcc, 1, 4, f);
+}
+
+static void patch_le32(FILE *f, long pos, uint32_t v) {
+    fseek(f, pos, SEEK_SET);
+    put_le32(f, v);
+}
+
+static void write_avi_headers(FILE *f, uint32_t width, uint32_t height, uint32_t fps_num, uint32_t fps_den) {
+    put_fourcc(f, "RIFF");
+    put_le32(f, 0);                                 // patched at close
+    put_fourcc(f, "AVI ");
+
+    put_fourcc(f, "LIST");
+    put_le32(f, AVI_HDRL_SIZE);
+    put_fourcc(f, "hdrl");
+
+    // Main AVI header
+    put_fourcc(f, "avih");
+    put_le32(f, 56);
+    put_le32(f, (uint32_t)((uint64_t)1000000 * fps_den / fps_num));  // microseconds per frame
+    put_le32(f, 0);                                 // max bytes per second (unknown)
+    put_le32(f, 0);                                 // padding granularity
+    put_le32(f, AVIF_HASINDEX);
+    put_le32(f, 0);                                 // total frames, patched at close
+    put_le32(f, 0);                                 // initial frames
+    put_le32(f, 1);                                 // streams
+    put_le32(f, 0);                                 // suggested buffer size, patched at close
+    put_le32(f, width);
+    put_le32(f, height);
+    for (int i = 0; i < 4; i++) {
+        put_le32(f, 0);                             // reserved
+    }
+
+    put_fourcc(f, "LIST");
+    put_le32(f, AVI_STRL_SIZE);
+    put_fourcc(f, "strl");
+
+    // Video stream header
+    put_fourcc(f, "strh");
+    put_le32(f, 56);
+    put_fourcc(f, "vids");
+    put_fourcc(f, "MJPG");
+    put_le32(f, 0);                                 // flags
+    put_le16(f, 0);                                 // priority
+    put_le16(f, 0);                                 // language
+    put_le32(f, 0);                                 // initial frames
+    put_le32(f, fps_den);                           // scale
+    put_le32(f, fps_num);                           // rate (rate / scale = fps)
+    put_le32(f, 0);                                 // start
+    put_le32(f, 0);                                 // length in frames, patched at close
+    put_le32(f, 0);                                 // suggested buffer size, patched at close
+    put_le32(f, 0xFFFFFFFF);                        // quality (default)
+    put_le32(f, 0);                                 // sample size (0 = variable, one frame per chunk)
+    put_le16(f, 0);                                 // frame rectangle
+    put_le16(f, 0);
+    put_le16(f, width);
+    put_le16(f, height);
+
+    // Stream format: BITMAPINFOHEADER
+    put_fourcc(f, "strf");
+    put_le32(f, 40);
+    put_le32(f, 40);
+    put_le32(f, width);
+    put_le32(f, height);
+    put_le16(f, 1);                                 // planes
+    put_le16(f, 24);                                // bit count
+    put_fourcc(f, "MJPG");
+    put_le32(f, (uint32_t)width * height * 3);
+    for (int i = 0; i < 4; i++) {
+        put_le32(f, 0);                             // resolution and palette
+    }
+
+    put_fourcc(f, "LIST");
+    put_le32(f, 0);                                 // patched at close
+    put_fourcc(f, "movi");
+}
+
+int mjpeg_open(MJPEG_WRITER *writer, const char *outputFile, OUTPUT_CONTAINER container,
+               uint32_t width, uint32_t height, uint32_t fps_num, uint32_t fps_den) {
+    memset(writer, 0, sizeof(*writer));
+    writer->container = container;
+
+    writer->file = fopen(outputFile, "wb");
+    if (writer->file == NULL) {
+        printf("Error: Cannot open '%s' for writing.\n", outputFile);
+        return -1;
+    }
+
+    if (container == OUTPUT_MJPEG_AVI) {
+        write_avi_headers(writer->file, width, height, fps_num, fps_den);
+        writer->movi_pos = ftell(writer->file) - 4;
+    }
+
+    return 0;
+}
+
+int mjpeg_write_frame(MJPEG_WRITER *writer, const uint8_t *jpeg, uint32_t frame_size) {
+    if (writer->container == OUTPUT_MJPEG_AVI) {
+        // AVI 1.0 offsets and sizes are 32-bit: the file must still fit with this chunk and the final idx1
+        long pos = ftell(writer->file);
+        uint64_t end = (uint64_t)pos + 8 + frame_size + (frame_size & 1) + 8 + 16 * ((uint64_t)writer->frame_count + 1);
+        if (pos < 0 || end > 0xFFFFFFFFu) {
+            printf("Warning: AVI output would exceed 4 GB, stopping after %u frames.\n", writer->frame_count);
+            return 1;
+        }
+
+        if (writer->frame_count == writer->index_capacity) {
+            uint32_t capacity = writer->index_capacity ? writer->index_capacity * 2 : 1024;
+            MJPEG_INDEX_ENTRY *index = (MJPEG_INDEX_ENTRY*)realloc(writer->index, capacity * sizeof(MJPEG_INDEX_ENTRY));
+            if (index == NULL) {
+                printf("Error: Not enough memory for the AVI index.\n");
+                return -1;
+            }
+            writer->index = index;
+            writer->index_capacity = capacity;
+        }
+
+        writer->index[writer->frame_count].offset = (uint32_t)(pos - writer->movi_pos);
+        writer->index[writer->frame_count].size = frame_size;
+
+        put_fourcc(writer->file, "00dc");
+        put_le32(writer->file, frame_size);
+    }
+
+    fwrite(jpeg, 1, frame_size, writer->file);
+
+    // RIFF chunks are word aligned
+    if (writer->container == OUTPUT_MJPEG_AVI && (frame_size & 1)) {
+        fputc(0, writer->file);
+    }
+
+    if (ferror(writer->file)) {
+        printf("Error: Cannot write frame %u.\n", writer->frame_count);
+        return -1;
+    }
+
+    if (frame_size > writer->max_frame_size) writer->max_frame_size = frame_size;
+    writer->frame_count++;
+    return 0;
+}
+
+int mjpeg_close(MJPEG_WRITER *writer) {
+    int status = 0;
+
+    if (writer->file != NULL && writer->container == OUTPUT_MJPEG_AVI) {
+        FILE *f = writer->file;
+        long idx1_pos = ftell(f);
+
+        put_fourcc(f, "idx1");
+        put_le32(f, writer->frame_count * 16);
+        for (uint32_t i = 0; i < writer->frame_count; i++) {
+            put_fourcc(f, "00dc");
+            put_le32(f, AVIIF_KEYFRAME);
+            put_le32(f, writer->index[i].offset);
+            put_le32(f, writer->index[i].size);
+        }
+
+        long end = ftell(f);
+        if (end < 0 || (uint64_t)end > 0xFFFFFFFFu) {
+            printf("Error: AVI output exceeds 4 GB.\n");
+            status = -1;
+        }
+
+        uint32_t buffer_size = writer->max_frame_size + 8;
+        patch_le32(f, AVI_RIFF_SIZE_POS, (uint32_t)(end - 8));
+        patch_le32(f, AVI_TOTAL_FRAMES_POS, writer->frame_count);
+        patch_le32(f, AVI_AVIH_BUFFER_POS, buffer_size);
+        patch_le32(f, AVI_STRH_LENGTH_POS, writer->frame_count);
+        patch_le32(f, AVI_STRH_BUFFER_POS, buffer_size);
+        patch_le32(f, AVI_MOVI_SIZE_POS, (uint32_t)(idx1_pos - writer->movi_pos));
+    }
+
+    if (writer->file != NULL) {
+        if (ferror(writer->file)) status = -1;
+        if (fclose(writer->file) != 0) status = -1;
+        writer->file = NULL;
+    }
+
+    free(writer->index);
+    writer->index = NULL;
+    return status;
+}
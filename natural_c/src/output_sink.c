@@ -0,0 +1,195 @@
+#include "output_sink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+int growable_buffer_reserve(GROWABLE_BUFFER *buffer, size_t size) {
+    if (buffer->capacity >= size) {
+        return 0;
+    }
+
+    size_t capacity = buffer->capacity * 2;
+    if (capacity < size) capacity = size;
+
+    uint8_t *data = (uint8_t*)realloc(buffer->data, capacity);
+    if (data == NULL) {
+        return -1;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+void growable_buffer_free(GROWABLE_BUFFER *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->capacity = 0;
+}
+
+static int growable_drain(void *ctx, BitWriter *bw, uint32_t needed) {
+    GROWABLE_BUFFER *buffer = (GROWABLE_BUFFER*)ctx;
+
+    // Everything stays in memory; bw_finish (needed = 0) has nothing to hand on
+    if (growable_buffer_reserve(buffer, buffer->offset + bw->byte_pos + needed) != 0) {
+        printf("Error: Not enough memory for the scan data.\n");
+        return -1;
+    }
+
+    // The writer's byte positions index 32-bit, so it sees at most 4 GB of the buffer
+    size_t room = buffer->capacity - buffer->offset;
+    bw->buffer = buffer->data + buffer->offset;
+    bw->capacity = room > UINT32_MAX ? UINT32_MAX : (uint32_t)room;
+    return 0;
+}
+
+void init_growable_sink(BW_SINK *sink, GROWABLE_BUFFER *buffer) {
+    sink->ctx = buffer;
+    sink->drain = growable_drain;
+}
+
+/*
+* Writes a whole chunk, continuing after partial writes (pipes, sockets) and signals.
+*/
+static int write_all(int fd, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+static void* fd_writer_thread(void *arg) {
+    FD_SINK *fd_sink = (FD_SINK*)arg;
+
+    pthread_mutex_lock(&fd_sink->lock);
+    for (;;) {
+        while (fd_sink->queued == 0 && !fd_sink->stop) {
+            pthread_cond_wait(&fd_sink->changed, &fd_sink->lock);
+        }
+        if (fd_sink->queued == 0) break;            // stopped and drained
+
+        uint32_t chunk = fd_sink->next_write;
+        int skip = fd_sink->error;
+        pthread_mutex_unlock(&fd_sink->lock);
+
+        // The write runs unlocked, overlapping with the encoder filling the next chunk.
+        // After an error the remaining chunks are only released.
+        uint32_t length = fd_sink->lengths[chunk];
+        int status = skip ? 0 : write_all(fd_sink->fd, fd_sink->chunks + (size_t)chunk * fd_sink->chunk_size, length);
+
+        pthread_mutex_lock(&fd_sink->lock);
+        if (status != 0) {
+            fd_sink->error = 1;
+        } else if (!skip) {
+            fd_sink->written += length;
+        }
+        fd_sink->next_write = (chunk + 1) % fd_sink->chunk_count;
+        fd_sink->queued--;
+        pthread_cond_broadcast(&fd_sink->changed);
+    }
+    pthread_mutex_unlock(&fd_sink->lock);
+
+    return NULL;
+}
+
+int fd_sink_open(FD_SINK *fd_sink, int fd, uint32_t chunk_size, uint32_t chunk_count) {
+    memset(fd_sink, 0, sizeof(*fd_sink));
+    pthread_mutex_init(&fd_sink->lock, NULL);
+    pthread_cond_init(&fd_sink->changed, NULL);
+
+    if (chunk_size < BW_MIN_CAPACITY || chunk_count < 2) {
+        printf("Error: Output ring needs at least 2 chunks of %d bytes.\n", BW_MIN_CAPACITY);
+        fd_sink_close(fd_sink);
+        return -1;
+    }
+
+    fd_sink->fd = fd;
+    fd_sink->chunk_size = chunk_size;
+    fd_sink->chunk_count = chunk_count;
+    fd_sink->chunks = (uint8_t*)malloc((size_t)chunk_size * chunk_count);
+    fd_sink->lengths = (uint32_t*)calloc(chunk_count, sizeof(uint32_t));
+    if (fd_sink->chunks == NULL || fd_sink->lengths == NULL) {
+        printf("Error: Not enough memory for the output ring.\n");
+        fd_sink_close(fd_sink);
+        return -1;
+    }
+
+    if (pthread_create(&fd_sink->writer, NULL, fd_writer_thread, fd_sink) != 0) {
+        printf("Error: Cannot start output writer thread.\n");
+        fd_sink_close(fd_sink);
+        return -1;
+    }
+    fd_sink->writer_started = 1;
+
+    return 0;
+}
+
+int fd_sink_close(FD_SINK *fd_sink) {
+    if (fd_sink->writer_started) {
+        pthread_mutex_lock(&fd_sink->lock);
+        fd_sink->stop = 1;
+        pthread_cond_broadcast(&fd_sink->changed);
+        pthread_mutex_unlock(&fd_sink->lock);
+
+        pthread_join(fd_sink->writer, NULL);
+        fd_sink->writer_started = 0;
+    }
+
+    free(fd_sink->chunks);
+    free(fd_sink->lengths);
+    fd_sink->chunks = NULL;
+    fd_sink->lengths = NULL;
+
+    pthread_mutex_destroy(&fd_sink->lock);
+    pthread_cond_destroy(&fd_sink->changed);
+
+    if (fd_sink->error) {
+        printf("Error: Cannot write the output.\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int fd_drain(void *ctx, BitWriter *bw, uint32_t needed) {
+    FD_SINK *fd_sink = (FD_SINK*)ctx;
+
+    if (needed > fd_sink->chunk_size) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&fd_sink->lock);
+
+    // Queue the chunk being filled (nothing to queue when the writer attaches)
+    if (bw->buffer != NULL && bw->byte_pos > 0) {
+        fd_sink->lengths[fd_sink->filling] = bw->byte_pos;
+        fd_sink->queued++;
+        fd_sink->filling = (fd_sink->filling + 1) % fd_sink->chunk_count;
+        bw->drained += bw->byte_pos;
+        bw->byte_pos = 0;
+        pthread_cond_broadcast(&fd_sink->changed);
+    }
+
+    // Wait for the writer thread to free the next chunk
+    while (fd_sink->queued == fd_sink->chunk_count) {
+        pthread_cond_wait(&fd_sink->changed, &fd_sink->lock);
+    }
+    int error = fd_sink->error;
+
+    pthread_mutex_unlock(&fd_sink->lock);
+
+    bw->buffer = fd_sink->chunks + (size_t)fd_sink->filling * fd_sink->chunk_size;
+    bw->capacity = fd_sink->chunk_size;
+    return error ? -1 : 0;
+}
+
+void init_fd_sink(BW_SINK *sink, FD_SINK *fd_sink) {
+    sink->ctx = fd_sink;
+    sink->drain = fd_drain;
+}
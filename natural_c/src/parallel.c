@@ -0,0 +1,56 @@
+#include "parallel.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256
+
+typedef struct {
+    uint32_t task_count;
+    uint32_t next;                          // next task index, taken with an atomic increment
+    void (*task)(void *ctx, uint32_t index);
+    void *ctx;
+} PARALLEL_JOB;
+
+static void* parallel_worker(void *arg) {
+    PARALLEL_JOB *job = (PARALLEL_JOB*)arg;
+
+    for (;;) {
+        uint32_t index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (index >= job->task_count) break;
+        job->task(job->ctx, index);
+    }
+    return NULL;
+}
+
+void parallel_for(uint32_t task_count, int threads, void (*task)(void *ctx, uint32_t index), void *ctx) {
+    PARALLEL_JOB job = { task_count, 0, task, ctx };
+
+    if (threads > (int)task_count) threads = (int)task_count;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    if (threads <= 1) {
+        parallel_worker(&job);
+        return;
+    }
+
+    // The calling thread is one of the workers
+    pthread_t workers[MAX_THREADS];
+    int started = 0;
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&workers[started], NULL, parallel_worker, &job) == 0) {
+            started++;
+        }
+    }
+
+    parallel_worker(&job);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+}
+
+int cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
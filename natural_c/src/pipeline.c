@@ -0,0 +1,412 @@
+#include "pipeline.h"
+#include "simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+uint32_t bmp_row_stride(uint32_t width) {
+    // Each row is padded to be a multiple of 4 bytes
+    return (width * 3 + 3) & ~3u;
+}
+
+static int bmp_memory_fetch_rows(void *ctx, uint32_t mcu_row, const uint8_t *rows[8]) {
+    BMP_MEMORY_SOURCE *src = (BMP_MEMORY_SOURCE*)ctx;
+
+    for (uint32_t i = 0; i < 8; i++) {
+        uint32_t y = mcu_row * 8 + i;
+        if (y >= src->height) y = src->height - 1;                      // clamp to the last row
+
+        uint32_t bmp_row = src->bottom_up ? src->height - 1 - y : y;
+        rows[i] = src->pixel_data + (size_t)bmp_row * src->row_stride;
+    }
+    return 0;
+}
+
+void init_bmp_memory_source(ROW_SOURCE *source, BMP_MEMORY_SOURCE *state, const uint8_t *pixel_data,
+                            uint32_t width, uint32_t height, int bottom_up) {
+    state->pixel_data = pixel_data;
+    state->width = width;
+    state->height = height;
+    state->row_stride = bmp_row_stride(width);
+    state->bottom_up = bottom_up;
+
+    source->ctx = state;
+    source->fetch_rows = bmp_memory_fetch_rows;
+    source->single_pass = 0;
+}
+
+/*
+* DCT, quantization and zigzag of one block of centered samples.
+* 'int_qt' is only read for the integer DCT methods and must be built from 'qt' for 'method'.
+*/
+static inline void transform_block(const KERNEL_TABLE *kernels, DCT_METHOD method, float *block,
+                                   const QUANT_TABLE *qt, const INT_QUANT_TABLE *int_qt, int16_t *zigzag_block) {
+    float dct_block[64];
+    int16_t samples[64];
+    int32_t dct_block_int[64];
+    int16_t quantized_block[64];
+
+    if (method == DCT_METHOD_ISLOW || method == DCT_METHOD_IFAST) {
+        for (int i = 0; i < 64; i++) {
+            samples[i] = (int16_t)roundf(block[i]);
+        }
+        if (method == DCT_METHOD_IFAST) {
+            perform_dct_one_block_ifast(samples, dct_block_int);
+        } else {
+            perform_dct_one_block_islow(samples, dct_block_int);
+        }
+        kernels->quantize_int(dct_block_int, int_qt, quantized_block);
+    } else {
+        if (method == DCT_METHOD_EXACT) {
+            perform_dct_one_block(block, dct_block);
+        } else {
+            kernels->dct_float(block, dct_block);
+        }
+        kernels->quantize(dct_block, qt, quantized_block);
+    }
+
+    kernels->zigzag(quantized_block, zigzag_block);
+}
+
+/*
+* Copies the 8x8 block at column 'x' out of 8 rows of a plane with 'stride' floats per row.
+*/
+static inline void load_block(const float *rows, uint32_t stride, uint32_t x, float *block) {
+    for (uint32_t y = 0; y < 8; y++) {
+        const float *src = rows + y * stride + x;
+        for (uint32_t i = 0; i < 8; i++) {
+            block[y * 8 + i] = src[i];
+        }
+    }
+}
+
+/*
+* Number of rows or columns of a block starting at 'start' that lie inside an image of 'size'.
+*/
+static inline uint32_t valid_extent(uint32_t start, uint32_t size) {
+    if (start >= size) return 0;
+    return size - start < 8 ? size - start : 8;
+}
+
+int load_y_rows(const ROW_SOURCE *source, uint32_t mcu_row, uint32_t width, const KERNEL_TABLE *kernels,
+                float *y_rows) {
+    uint32_t padded_w = (width + 7) / 8 * 8;
+    const uint8_t *rows[8];
+
+    if (source->fetch_rows(source->ctx, mcu_row, rows) != 0) {
+        printf("Error: Cannot read MCU row %u.\n", mcu_row);
+        return -1;
+    }
+
+    // Y conversion, then replicate the last column into the padding (same as image_to_blocks clamping)
+    for (uint32_t y = 0; y < 8; y++) {
+        float *y_row = y_rows + y * padded_w;
+        kernels->bgr_to_y(rows[y], y_row, width);
+        for (uint32_t x = width; x < padded_w; x++) {
+            y_row[x] = y_row[width - 1];
+        }
+    }
+    return 0;
+}
+
+size_t fused_workspace_size(uint32_t width, COLOR_MODE mode) {
+    uint32_t h_factor = color_mode_h_factor(mode);
+    uint32_t v_factor = color_mode_v_factor(mode);
+    size_t mcus_w = (width + 8 * h_factor - 1) / (8 * h_factor);
+    size_t padded_w = mcus_w * 8 * h_factor;
+
+    if (mode == COLOR_MODE_GRAY) {
+        return padded_w * 8 * sizeof(float);
+    }
+    return (padded_w * 8 * v_factor + 2 * mcus_w * 8 * 8) * sizeof(float);
+}
+
+size_t scan_buffer_estimate(uint32_t width, uint32_t height, COLOR_MODE mode) {
+    size_t luma = (size_t)width * height;
+    size_t chroma = 0;
+    if (mode != COLOR_MODE_GRAY) {
+        chroma = 2 * luma / (color_mode_h_factor(mode) * color_mode_v_factor(mode));
+    }
+
+    size_t buffer_size = (luma + chroma) / 2;
+    if (buffer_size < 4096) buffer_size = 4096; // Minimum 4KB
+    return buffer_size;
+}
+
+int encode_fused(const ROW_SOURCE *source, uint32_t width, uint32_t height, DCT_METHOD method,
+                 const KERNEL_TABLE *kernels, const QUANT_TABLE *qt, uint32_t restart_interval, float *workspace, QUALITY_METRICS *metrics,
+                 BitWriter *bw) {
+    uint32_t blocks_w = (width + 7) / 8;
+    uint32_t blocks_h = (height + 7) / 8;
+    uint32_t padded_w = blocks_w * 8;
+    int int_dct = method == DCT_METHOD_ISLOW || method == DCT_METHOD_IFAST;
+
+    // The only image-sized state: 8 rows of centered Y, padded to whole blocks
+    float *y_rows = workspace ? workspace : (float*)malloc(fused_workspace_size(width, COLOR_MODE_GRAY));
+    if (y_rows == NULL) {
+        printf("Error: Not enough memory for MCU row buffer.\n");
+        return -1;
+    }
+
+    INT_QUANT_TABLE int_qt;
+    if (int_dct) {
+        init_int_quant_table(&int_qt, qt->natural, method);
+    }
+
+    float block[64];
+    int16_t zigzag_block[64];
+    int16_t prev_dc = 0;
+    uint32_t block_index = 0;
+    uint32_t total_blocks = blocks_w * blocks_h;
+
+    for (uint32_t by = 0; by < blocks_h; by++) {
+        if (load_y_rows(source, by, width, kernels, y_rows) != 0) {
+            if (workspace == NULL) free(y_rows);
+            return -1;
+        }
+
+        for (uint32_t bx = 0; bx < blocks_w; bx++) {
+            load_block(y_rows, padded_w, bx * 8, block);
+            transform_block(kernels, method, block, qt, &int_qt, zigzag_block);
+            prev_dc = encode_coefficients(zigzag_block, prev_dc, &std_lum_huffman, bw);
+            if (metrics) {
+                quality_metrics_add_block(metrics, block, zigzag_block, qt, valid_extent(bx * 8, width),
+                                          valid_extent(by * 8, height));
+            }
+
+            // Close the restart interval (not after the last block) and reset the DC prediction
+            block_index++;
+            if (restart_interval && block_index % restart_interval == 0 && block_index < total_blocks) {
+                bw_restart(bw, block_index / restart_interval - 1);
+                prev_dc = 0;
+            }
+        }
+    }
+
+    if (workspace == NULL) free(y_rows);
+    return 0;
+}
+
+int encode_fused_color(const ROW_SOURCE *source, uint32_t width, uint32_t height, DCT_METHOD method, COLOR_MODE mode,
+                       const KERNEL_TABLE *kernels, const QUANT_TABLE *qt, const QUANT_TABLE *chroma_qt, uint32_t restart_interval,
+                       float *workspace, QUALITY_METRICS *metrics, BitWriter *bw) {
+    uint32_t h_factor = color_mode_h_factor(mode);
+    uint32_t v_factor = color_mode_v_factor(mode);
+    uint32_t mcu_w = 8 * h_factor;
+    uint32_t mcu_h = 8 * v_factor;
+    uint32_t mcus_w = (width + mcu_w - 1) / mcu_w;
+    uint32_t mcus_h = (height + mcu_h - 1) / mcu_h;
+    uint32_t strips = (height + 7) / 8;             // 8-row strips the source can deliver
+    uint32_t padded_w = mcus_w * mcu_w;
+    uint32_t chroma_w = mcus_w * 8;
+    float weight = 1.0f / (float)(h_factor * v_factor);
+    int int_dct = method == DCT_METHOD_ISLOW || method == DCT_METHOD_IFAST;
+
+    // One MCU row of centered Y at full resolution, Cb and Cr already downsampled
+    float *y_rows = workspace ? workspace : (float*)malloc(fused_workspace_size(width, mode));
+    if (y_rows == NULL) {
+        printf("Error: Not enough memory for MCU row buffer.\n");
+        return -1;
+    }
+    float *cb_rows = y_rows + (size_t)padded_w * mcu_h;
+    float *cr_rows = cb_rows + (size_t)chroma_w * 8;
+
+    INT_QUANT_TABLE int_qt;
+    INT_QUANT_TABLE int_chroma_qt;
+    if (int_dct) {
+        init_int_quant_table(&int_qt, qt->natural, method);
+        init_int_quant_table(&int_chroma_qt, chroma_qt->natural, method);
+    }
+
+    float block[64];
+    int16_t zigzag_block[64];
+    int16_t prev_dc[3] = { 0, 0, 0 };
+    uint32_t mcu_index = 0;
+    uint32_t total_mcus = mcus_w * mcus_h;
+    const uint8_t *rows[8];
+
+    for (uint32_t my = 0; my < mcus_h; my++) {
+        // Color conversion with the chroma downsampling folded in: every BGR row is read once,
+        // Y goes to its full resolution row and Cb/Cr are summed into their subsampled row
+        for (uint32_t s = 0; s < v_factor; s++) {
+            uint32_t strip = my * v_factor + s;
+            if (strip < strips) {
+                if (source->fetch_rows(source->ctx, strip, rows) != 0) {
+                    printf("Error: Cannot read MCU row %u.\n", my);
+                    if (workspace == NULL) free(y_rows);
+                    return -1;
+                }
+            } else {
+                // Past the bottom edge: repeat the last scanline of the previous strip (still valid)
+                for (uint32_t y = 0; y < 8; y++) {
+                    rows[y] = rows[7];
+                }
+            }
+
+            for (uint32_t y = 0; y < 8; y++) {
+                uint32_t row = s * 8 + y;
+                float *y_row = y_rows + row * padded_w;
+                kernels->bgr_to_y(rows[y], y_row, width);
+                for (uint32_t x = width; x < padded_w; x++) {
+                    y_row[x] = y_row[width - 1];
+                }
+
+                uint32_t chroma_row = row / v_factor;
+                bgr_to_cbcr_row(rows[y], width, chroma_w, h_factor, weight, row % v_factor != 0,
+                                cb_rows + chroma_row * chroma_w, cr_rows + chroma_row * chroma_w);
+            }
+        }
+
+        for (uint32_t mx = 0; mx < mcus_w; mx++) {
+            // Y blocks of the MCU in raster order, then one Cb and one Cr block
+            for (uint32_t v = 0; v < v_factor; v++) {
+                for (uint32_t h = 0; h < h_factor; h++) {
+                    load_block(y_rows + v * 8 * padded_w, padded_w, mx * mcu_w + h * 8, block);
+                    transform_block(kernels, method, block, qt, &int_qt, zigzag_block);
+                    prev_dc[0] = encode_coefficients(zigzag_block, prev_dc[0], &std_lum_huffman, bw);
+                    if (metrics) {
+                        quality_metrics_add_block(metrics, block, zigzag_block, qt, valid_extent(mx * mcu_w + h * 8, width),
+                                                  valid_extent(my * mcu_h + v * 8, height));
+                    }
+                }
+            }
+
+            load_block(cb_rows, chroma_w, mx * 8, block);
+            transform_block(kernels, method, block, chroma_qt, &int_chroma_qt, zigzag_block);
+            prev_dc[1] = encode_coefficients(zigzag_block, prev_dc[1], &std_chrom_huffman, bw);
+
+            load_block(cr_rows, chroma_w, mx * 8, block);
+            transform_block(kernels, method, block, chroma_qt, &int_chroma_qt, zigzag_block);
+            prev_dc[2] = encode_coefficients(zigzag_block, prev_dc[2], &std_chrom_huffman, bw);
+
+            // Close the restart interval (not after the last MCU) and reset every DC prediction
+            mcu_index++;
+            if (restart_interval && mcu_index % restart_interval == 0 && mcu_index < total_mcus) {
+                bw_restart(bw, mcu_index / restart_interval - 1);
+                prev_dc[0] = prev_dc[1] = prev_dc[2] = 0;
+            }
+        }
+    }
+
+    if (workspace == NULL) free(y_rows);
+    return 0;
+}
+
+/*
+* Copies the 8x8 block with top left sample (x, y) out of a plane, centered around zero.
+* Samples past the right or bottom edge repeat the last column / row.
+*/
+static inline void load_plane_block(const YUV_PLANE *plane, uint32_t x, uint32_t y, float *block) {
+    if (x + 8 <= plane->width && y + 8 <= plane->height && plane->step == 1) {
+        for (uint32_t r = 0; r < 8; r++) {
+            const uint8_t *src = plane->data + (size_t)(y + r) * plane->stride + x;
+            for (uint32_t i = 0; i < 8; i++) {
+                block[r * 8 + i] = (float)src[i] - 128.0f;
+            }
+        }
+        return;
+    }
+
+    for (uint32_t r = 0; r < 8; r++) {
+        uint32_t row = y + r < plane->height ? y + r : plane->height - 1;
+        const uint8_t *src = plane->data + (size_t)row * plane->stride;
+        for (uint32_t i = 0; i < 8; i++) {
+            uint32_t col = x + i < plane->width ? x + i : plane->width - 1;
+            block[r * 8 + i] = (float)src[(size_t)col * plane->step] - 128.0f;
+        }
+    }
+}
+
+int encode_planes(const YUV_IMAGE *image, DCT_METHOD method, const KERNEL_TABLE *kernels, COLOR_MODE mode,
+                  const QUANT_TABLE *qt, const QUANT_TABLE *chroma_qt, uint32_t restart_interval,
+                  QUALITY_METRICS *metrics, BitWriter *bw) {
+    int color = mode != COLOR_MODE_GRAY && image->sampling != COLOR_MODE_GRAY;
+    uint32_t h_factor = color ? color_mode_h_factor(image->sampling) : 1;
+    uint32_t v_factor = color ? color_mode_v_factor(image->sampling) : 1;
+    uint32_t mcus_w = (image->width + 8 * h_factor - 1) / (8 * h_factor);
+    uint32_t mcus_h = (image->height + 8 * v_factor - 1) / (8 * v_factor);
+    int int_dct = method == DCT_METHOD_ISLOW || method == DCT_METHOD_IFAST;
+
+    INT_QUANT_TABLE int_qt;
+    INT_QUANT_TABLE int_chroma_qt;
+    if (int_dct) {
+        init_int_quant_table(&int_qt, qt->natural, method);
+        if (color) {
+            init_int_quant_table(&int_chroma_qt, chroma_qt->natural, method);
+        }
+    }
+
+    float block[64];
+    int16_t zigzag_block[64];
+    int16_t prev_dc[3] = { 0, 0, 0 };
+    uint32_t mcu_index = 0;
+    uint32_t total_mcus = mcus_w * mcus_h;
+
+    for (uint32_t my = 0; my < mcus_h; my++) {
+        for (uint32_t mx = 0; mx < mcus_w; mx++) {
+            // Y blocks of the MCU in raster order, then one Cb and one Cr block
+            for (uint32_t v = 0; v < v_factor; v++) {
+                for (uint32_t h = 0; h < h_factor; h++) {
+                    uint32_t x = (mx * h_factor + h) * 8;
+                    uint32_t y = (my * v_factor + v) * 8;
+                    load_plane_block(&image->planes[0], x, y, block);
+                    transform_block(kernels, method, block, qt, &int_qt, zigzag_block);
+                    prev_dc[0] = encode_coefficients(zigzag_block, prev_dc[0], &std_lum_huffman, bw);
+                    if (metrics) {
+                        quality_metrics_add_block(metrics, block, zigzag_block, qt, valid_extent(x, image->planes[0].width),
+                                                  valid_extent(y, image->planes[0].height));
+                    }
+                }
+            }
+
+            if (color) {
+                for (int c = 1; c < 3; c++) {
+                    load_plane_block(&image->planes[c], mx * 8, my * 8, block);
+                    transform_block(kernels, method, block, chroma_qt, &int_chroma_qt, zigzag_block);
+                    prev_dc[c] = encode_coefficients(zigzag_block, prev_dc[c], &std_chrom_huffman, bw);
+                }
+            }
+
+            // Close the restart interval (not after the last MCU) and reset every DC prediction
+            mcu_index++;
+            if (restart_interval && mcu_index % restart_interval == 0 && mcu_index < total_mcus) {
+                bw_restart(bw, mcu_index / restart_interval - 1);
+                prev_dc[0] = prev_dc[1] = prev_dc[2] = 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int measure_quality_rows(const ROW_SOURCE *source, uint32_t width, uint32_t height, const int16_t *zigzag_blocks,
+                         const QUANT_TABLE *qt, const KERNEL_TABLE *kernels, float *workspace, QUALITY_METRICS *metrics) {
+    uint32_t blocks_w = (width + 7) / 8;
+    uint32_t blocks_h = (height + 7) / 8;
+    uint32_t padded_w = blocks_w * 8;
+
+    float *y_rows = workspace ? workspace : (float*)malloc(fused_workspace_size(width, COLOR_MODE_GRAY));
+    if (y_rows == NULL) {
+        printf("Error: Not enough memory for MCU row buffer.\n");
+        return -1;
+    }
+
+    float block[64];
+
+    for (uint32_t by = 0; by < blocks_h; by++) {
+        // Same Y samples the staged front half transformed
+        if (load_y_rows(source, by, width, kernels, y_rows) != 0) {
+            if (workspace == NULL) free(y_rows);
+            return -1;
+        }
+
+        for (uint32_t bx = 0; bx < blocks_w; bx++) {
+            load_block(y_rows, padded_w, bx * 8, block);
+            quality_metrics_add_block(metrics, block, &zigzag_blocks[((size_t)by * blocks_w + bx) * 64], qt,
+                                      valid_extent(bx * 8, width), valid_extent(by * 8, height));
+        }
+    }
+
+    if (workspace == NULL) free(y_rows);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "quality_metrics.h"
+#include <math.h>
+
+// SSIM stabilizers for 8-bit samples: (0.01 * 255)^2 and (0.03 * 255)^2
+#define SSIM_C1 6.5025
+#define SSIM_C2 58.5225
+
+/*
+* Centered sample -> 8-bit pixel, as a decoder outputs it.
+*/
+static inline int to_pixel(float sample) {
+    int pixel = (int)lroundf(sample + 128.0f);
+    if (pixel < 0) return 0;
+    if (pixel > 255) return 255;
+    return pixel;
+}
+
+void quality_metrics_init(QUALITY_METRICS *metrics) {
+    metrics->squared_error = 0.0;
+    metrics->pixels = 0;
+    metrics->ssim_sum = 0.0;
+    metrics->blocks = 0;
+}
+
+void quality_metrics_add_block(QUALITY_METRICS *metrics, const float *block, const int16_t *zigzag_block,
+                               const QUANT_TABLE *qt, uint32_t valid_w, uint32_t valid_h) {
+    float coefficients[64];
+    float reconstructed[64];
+
+    if (valid_w == 0 || valid_h == 0) {
+        return;
+    }
+
+    // Dequantize into natural order, as a decoder reads the DQT values
+    for (int k = 0; k < 64; k++) {
+        uint8_t index = zigzag_map[k];
+        coefficients[index] = (float)zigzag_block[k] * (float)qt->natural[index];
+    }
+    perform_idct_one_block(coefficients, reconstructed);
+
+    double sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_yy = 0.0, sum_xy = 0.0;
+    uint32_t error = 0;
+
+    for (uint32_t y = 0; y < valid_h; y++) {
+        for (uint32_t x = 0; x < valid_w; x++) {
+            int source = to_pixel(block[y * 8 + x]);
+            int decoded = to_pixel(reconstructed[y * 8 + x]);
+            int diff = source - decoded;
+
+            error += (uint32_t)(diff * diff);
+            sum_x += source;
+            sum_y += decoded;
+            sum_xx += (double)source * source;
+            sum_yy += (double)decoded * decoded;
+            sum_xy += (double)source * decoded;
+        }
+    }
+
+    double n = (double)(valid_w * valid_h);
+    double mean_x = sum_x / n;
+    double mean_y = sum_y / n;
+    double var_x = sum_xx / n - mean_x * mean_x;
+    double var_y = sum_yy / n - mean_y * mean_y;
+    double cov_xy = sum_xy / n - mean_x * mean_y;
+
+    metrics->squared_error += error;
+    metrics->pixels += valid_w * valid_h;
+    metrics->ssim_sum += ((2.0 * mean_x * mean_y + SSIM_C1) * (2.0 * cov_xy + SSIM_C2)) /
+                         ((mean_x * mean_x + mean_y * mean_y + SSIM_C1) * (var_x + var_y + SSIM_C2));
+    metrics->blocks++;
+}
+
+double quality_metrics_psnr(const QUALITY_METRICS *metrics) {
+    if (metrics->pixels == 0) return 0.0;
+    if (metrics->squared_error == 0.0) return 100.0;   // perfect match, same convention as analyze_jpeg.py
+
+    double mse = metrics->squared_error / (double)metrics->pixels;
+    return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+double quality_metrics_ssim(const QUALITY_METRICS *metrics) {
+    if (metrics->blocks == 0) return 0.0;
+    return metrics->ssim_sum / metrics->blocks;
+}
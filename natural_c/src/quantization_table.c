@@ -27,4 +27,20 @@ const uint8_t std_lum_qt_zigzagged[64] = {
     87, 69, 55, 56, 80, 109, 81, 87,
     95, 98, 103, 104, 103, 62, 77, 113,
     121, 112, 100, 120, 92, 101, 103, 99
-};
\ No newline at end of file
+};
+
+/*
+* Predefined chrominance quantization table.
+* ISO/IEC 10918-1 (Annex K, table K.2)
+*/
+
+const uint8_t std_chrom_qt[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
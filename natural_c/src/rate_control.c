@@ -0,0 +1,43 @@
+#include "rate_control.h"
+#include "entropy.h"
+#include "jfif_handler.h"
+
+uint64_t predict_file_size(const DCT_COEFFICIENTS *coeffs, int quality, const KERNEL_TABLE *kernels,
+                            const SCAN_SETTINGS *settings, int16_t *zigzag_blocks) {
+    QUANT_TABLE qt;
+    HUFFMAN_TABLE_DATA huffman_data;
+    HUFFMAN_TABLES tables;
+
+    init_quant_table(&qt, quality);
+    quantize_coefficients(coeffs, &qt, kernels, settings->threads, zigzag_blocks);
+
+    if (select_huffman_tables(zigzag_blocks, coeffs->block_count, settings, &huffman_data, &tables) != 0) {
+        return UINT64_MAX;
+    }
+
+    return dry_run_scan_size(zigzag_blocks, coeffs->block_count, settings->restart_interval, &tables,
+                             settings->threads, settings->entropy)
+         + jfif_header_size(settings->restart_interval, &tables);
+}
+
+int find_quality_for_size(const DCT_COEFFICIENTS *coeffs, const KERNEL_TABLE *kernels, const SCAN_SETTINGS *settings,
+                          uint32_t target_size, int16_t *zigzag_blocks) {
+    int low = 1;
+    int high = 100;
+    int best = 1;
+
+    // File size grows with quality, so the largest fitting quality can be bisected
+    while (low <= high) {
+        int quality = (low + high) / 2;
+        uint64_t size = predict_file_size(coeffs, quality, kernels, settings, zigzag_blocks);
+
+        if (size <= target_size) {
+            best = quality;
+            low = quality + 1;
+        } else {
+            high = quality - 1;
+        }
+    }
+
+    return best;
+}
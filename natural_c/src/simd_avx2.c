@@ -0,0 +1,248 @@
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+/*
+* AVX2 kernels. Same rules as the SSE4.1 set: per-function target attribute, scalar operation order
+* (no FMA contraction), bit-identical results.
+*/
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET
+static void rgb_to_y_avx2(const RGB *pixels, float *out_y, uint32_t count) {
+    const float *src = (const float*)pixels;
+    const __m256 kr = _mm256_set1_ps(0.299f);
+    const __m256 kg = _mm256_set1_ps(0.587f);
+    const __m256 kb = _mm256_set1_ps(0.114f);
+    const __m256i idx = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);     // float offsets of 8 consecutive pixels
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        const float *base = src + i * 3;
+        __m256 r = _mm256_i32gather_ps(base + 0, idx, 4);
+        __m256 g = _mm256_i32gather_ps(base + 1, idx, 4);
+        __m256 b = _mm256_i32gather_ps(base + 2, idx, 4);
+
+        __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(kr, r), _mm256_mul_ps(kg, g)), _mm256_mul_ps(kb, b));
+        _mm256_storeu_ps(out_y + i, y);
+    }
+
+    for (; i < count; i++) {
+        out_y[i] = 0.299f * pixels[i].r + 0.587f * pixels[i].g + 0.114f * pixels[i].b;
+    }
+}
+
+/*
+* Gathers 4 packed BGR pixels per 128-bit lane into b0..b3 | g0..g3 | r0..r3 | zero.
+*/
+static const int8_t bgr_deinterleave_x2[32] = {
+    0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11, -1, -1, -1, -1,
+    0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11, -1, -1, -1, -1
+};
+
+AVX2_TARGET
+static void bgr_to_y_avx2(const uint8_t *bgr, float *out_y, uint32_t count) {
+    const __m256 kr = _mm256_set1_ps(0.299f);
+    const __m256 kg = _mm256_set1_ps(0.587f);
+    const __m256 kb = _mm256_set1_ps(0.114f);
+    const __m256 center = _mm256_set1_ps(128.0f);
+    const __m256i shuffle = _mm256_loadu_si256((const __m256i*)bgr_deinterleave_x2);
+    uint32_t i = 0;
+
+    // Pixels i..i+3 go to the low lane and i+4..i+7 to the high lane; each 16-byte load over-reads 4 bytes
+    for (; i + 10 <= count; i += 8) {
+        __m256i raw = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(bgr + 3 * i))),
+            _mm_loadu_si128((const __m128i*)(bgr + 3 * i + 12)), 1);
+        __m256i px = _mm256_shuffle_epi8(raw, shuffle);
+
+        // Regroup dwords so b, g and r each occupy 8 consecutive bytes
+        __m256i grouped = _mm256_permutevar8x32_epi32(px, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+        __m128i bg = _mm256_castsi256_si128(grouped);
+        __m128i r_ = _mm256_extracti128_si256(grouped, 1);
+
+        __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bg));
+        __m256 g = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(bg, 8)));
+        __m256 r = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(r_));
+
+        __m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(kr, r), _mm256_mul_ps(kg, g)), _mm256_mul_ps(kb, b));
+        _mm256_storeu_ps(out_y + i, _mm256_sub_ps(y, center));
+    }
+
+    bgr_to_y(bgr + 3 * i, out_y + i, count - i);
+}
+
+/*
+* 1D AAN butterfly across 8 vectors (one lane per independent transform).
+*/
+AVX2_TARGET
+static inline void aan_1d_avx2(__m256 *d) {
+    const __m256 c4 = _mm256_set1_ps(0.707106781f);
+    const __m256 c6 = _mm256_set1_ps(0.382683433f);
+    const __m256 c2_m_c6 = _mm256_set1_ps(0.541196100f);
+    const __m256 c2_p_c6 = _mm256_set1_ps(1.306562965f);
+
+    __m256 tmp0 = _mm256_add_ps(d[0], d[7]);
+    __m256 tmp7 = _mm256_sub_ps(d[0], d[7]);
+    __m256 tmp1 = _mm256_add_ps(d[1], d[6]);
+    __m256 tmp6 = _mm256_sub_ps(d[1], d[6]);
+    __m256 tmp2 = _mm256_add_ps(d[2], d[5]);
+    __m256 tmp5 = _mm256_sub_ps(d[2], d[5]);
+    __m256 tmp3 = _mm256_add_ps(d[3], d[4]);
+    __m256 tmp4 = _mm256_sub_ps(d[3], d[4]);
+
+    // Even part
+    __m256 tmp10 = _mm256_add_ps(tmp0, tmp3);
+    __m256 tmp13 = _mm256_sub_ps(tmp0, tmp3);
+    __m256 tmp11 = _mm256_add_ps(tmp1, tmp2);
+    __m256 tmp12 = _mm256_sub_ps(tmp1, tmp2);
+
+    d[0] = _mm256_add_ps(tmp10, tmp11);
+    d[4] = _mm256_sub_ps(tmp10, tmp11);
+
+    __m256 z1 = _mm256_mul_ps(_mm256_add_ps(tmp12, tmp13), c4);
+    d[2] = _mm256_add_ps(tmp13, z1);
+    d[6] = _mm256_sub_ps(tmp13, z1);
+
+    // Odd part
+    tmp10 = _mm256_add_ps(tmp4, tmp5);
+    tmp11 = _mm256_add_ps(tmp5, tmp6);
+    tmp12 = _mm256_add_ps(tmp6, tmp7);
+
+    __m256 z5 = _mm256_mul_ps(_mm256_sub_ps(tmp10, tmp12), c6);
+    __m256 z2 = _mm256_add_ps(_mm256_mul_ps(c2_m_c6, tmp10), z5);
+    __m256 z4 = _mm256_add_ps(_mm256_mul_ps(c2_p_c6, tmp12), z5);
+    __m256 z3 = _mm256_mul_ps(tmp11, c4);
+
+    __m256 z11 = _mm256_add_ps(tmp7, z3);
+    __m256 z13 = _mm256_sub_ps(tmp7, z3);
+
+    d[5] = _mm256_add_ps(z13, z2);
+    d[3] = _mm256_sub_ps(z13, z2);
+    d[1] = _mm256_add_ps(z11, z4);
+    d[7] = _mm256_sub_ps(z11, z4);
+}
+
+AVX2_TARGET
+static inline void transpose_8x8_avx2(__m256 *r) {
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    // Swap 128-bit halves between the upper and lower 4 rows
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+AVX2_TARGET
+static void dct_float_avx2(const float *block, float *out_dct_block) {
+    __m256 r[8];
+
+    for (int i = 0; i < 8; i++) {
+        r[i] = _mm256_loadu_ps(block + i * 8);
+    }
+
+    // Row pass on the transposed block, then column pass on the block transposed back
+    transpose_8x8_avx2(r);
+    aan_1d_avx2(r);
+    transpose_8x8_avx2(r);
+    aan_1d_avx2(r);
+
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_ps(out_dct_block + i * 8, _mm256_mul_ps(r[i], _mm256_loadu_ps(aan_descale + i * 8)));
+    }
+}
+
+/*
+* roundf() emulation, see round_half_away_sse4.
+*/
+AVX2_TARGET
+static inline __m256i round_half_away_avx2(__m256 v) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256 t = _mm256_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256 frac = _mm256_andnot_ps(sign_mask, _mm256_sub_ps(v, t));
+    __m256 step = _mm256_or_ps(_mm256_and_ps(v, sign_mask), one);
+    step = _mm256_and_ps(step, _mm256_cmp_ps(frac, half, _CMP_GE_OQ));
+
+    return _mm256_cvttps_epi32(_mm256_add_ps(t, step));
+}
+
+AVX2_TARGET
+static void quantize_avx2(float *dct_block, const QUANT_TABLE *qt, int16_t *out_quantized_block) {
+    for (int i = 0; i < 64; i += 16) {
+        __m256 q0 = _mm256_loadu_ps(qt->divisor + i);
+        __m256 q1 = _mm256_loadu_ps(qt->divisor + i + 8);
+
+        __m256i r0 = round_half_away_avx2(_mm256_div_ps(_mm256_loadu_ps(dct_block + i), q0));
+        __m256i r1 = round_half_away_avx2(_mm256_div_ps(_mm256_loadu_ps(dct_block + i + 8), q1));
+
+        // packs works per 128-bit lane, fix the qword order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(r0, r1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(out_quantized_block + i), packed);
+    }
+}
+
+AVX2_TARGET
+static void quantize_int_avx2(const int32_t *dct_block, const INT_QUANT_TABLE *table, int16_t *out_quantized_block) {
+    for (int i = 0; i < 64; i += 16) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(dct_block + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(dct_block + i + 8));
+
+        __m256i bias0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(table->bias + i)));
+        __m256i bias1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(table->bias + i + 8)));
+        __m256i recip0 = _mm256_loadu_si256((const __m256i*)(table->recip + i));
+        __m256i recip1 = _mm256_loadu_si256((const __m256i*)(table->recip + i + 8));
+        __m256i shift0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(table->shift + i)));
+        __m256i shift1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(table->shift + i + 8)));
+
+        // ((|x| + bias) * recip) >> shift, the product fits in 32 unsigned bits
+        __m256i q0 = _mm256_srlv_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_abs_epi32(v0), bias0), recip0), shift0);
+        __m256i q1 = _mm256_srlv_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_abs_epi32(v1), bias1), recip1), shift1);
+
+        // Restore the sign (q is 0 whenever x is 0)
+        q0 = _mm256_sign_epi32(q0, v0);
+        q1 = _mm256_sign_epi32(q1, v1);
+
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(q0, q1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(out_quantized_block + i), packed);
+    }
+}
+
+const KERNEL_TABLE kernels_avx2 = {
+    SIMD_ISA_AVX2,
+    "avx2",
+    rgb_to_y_avx2,
+    bgr_to_y_avx2,
+    dct_float_avx2,
+    quantize_avx2,
+    quantize_int_avx2,
+    zigzag_order_sse4
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "simd.h"
+#include <stdio.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <cpuid.h>
+#endif
+
+void rgb_to_y(const RGB *pixels, float *out_y, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        // Using standard luminance calculation - ITU-R BT.601
+        out_y[i] = 0.299f * pixels[i].r + 0.587f * pixels[i].g + 0.114f * pixels[i].b;
+    }
+}
+
+void bgr_to_y(const uint8_t *bgr, float *out_y, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        float y = 0.299f * (float)bgr[3 * i + 2] + 0.587f * (float)bgr[3 * i + 1] + 0.114f * (float)bgr[3 * i];
+        out_y[i] = y - 128.0f;
+    }
+}
+
+static const KERNEL_TABLE kernels_scalar = {
+    SIMD_ISA_SCALAR,
+    "scalar",
+    rgb_to_y,
+    bgr_to_y,
+    perform_dct_one_block_aan,
+    quantize_block,
+    quantize_block_int,
+    zigzag_order
+};
+
+static const KERNEL_TABLE *selected_kernels = NULL;
+static pthread_once_t default_kernels_once = PTHREAD_ONCE_INIT;
+
+static void init_default_kernels(void) {
+    selected_kernels = get_kernel_table(SIMD_ISA_AUTO);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+* Reads XCR0 so we know the OS saves YMM state on context switch (required for AVX).
+*/
+static uint64_t read_xcr0(void) {
+    uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+}
+#endif
+
+SIMD_ISA detect_simd_isa(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return SIMD_ISA_SCALAR;
+    }
+
+    int has_ssse3  = (ecx & bit_SSSE3) != 0;
+    int has_sse41  = (ecx & bit_SSE4_1) != 0;
+    int has_osxsave = (ecx & bit_OSXSAVE) != 0;
+    int has_avx    = (ecx & bit_AVX) != 0;
+
+    if (!(has_ssse3 && has_sse41)) {
+        return SIMD_ISA_SCALAR;
+    }
+
+    // AVX2: CPUID leaf 7 EBX bit 5, plus OS support for XMM and YMM state
+    if (has_osxsave && has_avx && (read_xcr0() & 0x6) == 0x6) {
+        if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2)) {
+            return SIMD_ISA_AVX2;
+        }
+    }
+
+    return SIMD_ISA_SSE4;
+#else
+    return SIMD_ISA_SCALAR;
+#endif
+}
+
+const KERNEL_TABLE* get_kernel_table(SIMD_ISA isa) {
+    SIMD_ISA supported = detect_simd_isa();
+
+    if (isa == SIMD_ISA_AUTO) {
+        isa = supported;
+    }
+    if (isa > supported) {
+        return NULL;
+    }
+
+    switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+        case SIMD_ISA_AVX2:
+            return &kernels_avx2;
+        case SIMD_ISA_SSE4:
+            return &kernels_sse4;
+#endif
+        default:
+            return &kernels_scalar;
+    }
+}
+
+const KERNEL_TABLE* select_kernels(SIMD_ISA isa) {
+    const KERNEL_TABLE *table = get_kernel_table(isa);
+
+    if (table == NULL) {
+        table = get_kernel_table(SIMD_ISA_AUTO);
+        printf("Warning: Requested instruction set is not supported by this CPU, using '%s'.\n", table->name);
+    }
+
+    // Run the default initialization first so it can never overwrite this selection later
+    pthread_once(&default_kernels_once, init_default_kernels);
+    selected_kernels = table;
+    return table;
+}
+
+const KERNEL_TABLE* get_kernels(void) {
+    pthread_once(&default_kernels_once, init_default_kernels);
+    return selected_kernels;
+}
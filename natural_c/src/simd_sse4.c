@@ -0,0 +1,305 @@
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+/*
+* SSE4.1 kernels. Compiled with a per-function target attribute, so the rest of the
+* encoder keeps the baseline ISA and these are only reached through runtime dispatch.
+* Floating point operations are issued in the same order as the scalar code, so results are bit-identical.
+*/
+
+#define SSE4_TARGET __attribute__((target("sse4.1,ssse3")))
+
+SSE4_TARGET
+static void rgb_to_y_sse4(const RGB *pixels, float *out_y, uint32_t count) {
+    const float *src = (const float*)pixels;
+    const __m128 kr = _mm_set1_ps(0.299f);
+    const __m128 kg = _mm_set1_ps(0.587f);
+    const __m128 kb = _mm_set1_ps(0.114f);
+    uint32_t i = 0;
+
+    // Each unaligned load grabs {r, g, b, next r}; a 4x4 transpose turns 4 pixels into r, g, b vectors.
+    // The last pixel's load reads one float past it, so the vector loop stops one pixel early.
+    for (; i + 4 < count; i += 4) {
+        __m128 p0 = _mm_loadu_ps(src + (i + 0) * 3);
+        __m128 p1 = _mm_loadu_ps(src + (i + 1) * 3);
+        __m128 p2 = _mm_loadu_ps(src + (i + 2) * 3);
+        __m128 p3 = _mm_loadu_ps(src + (i + 3) * 3);
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+        __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(kr, p0), _mm_mul_ps(kg, p1)), _mm_mul_ps(kb, p2));
+        _mm_storeu_ps(out_y + i, y);
+    }
+
+    for (; i < count; i++) {
+        out_y[i] = 0.299f * pixels[i].r + 0.587f * pixels[i].g + 0.114f * pixels[i].b;
+    }
+}
+
+/*
+* Gathers 4 packed BGR pixels (12 bytes) into b0..b3 | g0..g3 | r0..r3 | zero.
+*/
+static const int8_t bgr_deinterleave[16] = { 0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11, -1, -1, -1, -1 };
+
+SSE4_TARGET
+static void bgr_to_y_sse4(const uint8_t *bgr, float *out_y, uint32_t count) {
+    const __m128 kr = _mm_set1_ps(0.299f);
+    const __m128 kg = _mm_set1_ps(0.587f);
+    const __m128 kb = _mm_set1_ps(0.114f);
+    const __m128 center = _mm_set1_ps(128.0f);
+    const __m128i shuffle = _mm_loadu_si128((const __m128i*)bgr_deinterleave);
+    uint32_t i = 0;
+
+    // 16-byte loads cover 4 pixels plus 4 bytes of the next ones, so stop while that stays in bounds
+    for (; i + 6 <= count; i += 4) {
+        __m128i px = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(bgr + 3 * i)), shuffle);
+
+        __m128 b = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(px));
+        __m128 g = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(px, 4)));
+        __m128 r = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(px, 8)));
+
+        __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(kr, r), _mm_mul_ps(kg, g)), _mm_mul_ps(kb, b));
+        _mm_storeu_ps(out_y + i, _mm_sub_ps(y, center));
+    }
+
+    bgr_to_y(bgr + 3 * i, out_y + i, count - i);
+}
+
+/*
+* 1D AAN butterfly across 8 vectors (one lane per independent transform).
+*/
+SSE4_TARGET
+static inline void aan_1d_sse4(__m128 *d) {
+    const __m128 c4 = _mm_set1_ps(0.707106781f);
+    const __m128 c6 = _mm_set1_ps(0.382683433f);
+    const __m128 c2_m_c6 = _mm_set1_ps(0.541196100f);
+    const __m128 c2_p_c6 = _mm_set1_ps(1.306562965f);
+
+    __m128 tmp0 = _mm_add_ps(d[0], d[7]);
+    __m128 tmp7 = _mm_sub_ps(d[0], d[7]);
+    __m128 tmp1 = _mm_add_ps(d[1], d[6]);
+    __m128 tmp6 = _mm_sub_ps(d[1], d[6]);
+    __m128 tmp2 = _mm_add_ps(d[2], d[5]);
+    __m128 tmp5 = _mm_sub_ps(d[2], d[5]);
+    __m128 tmp3 = _mm_add_ps(d[3], d[4]);
+    __m128 tmp4 = _mm_sub_ps(d[3], d[4]);
+
+    // Even part
+    __m128 tmp10 = _mm_add_ps(tmp0, tmp3);
+    __m128 tmp13 = _mm_sub_ps(tmp0, tmp3);
+    __m128 tmp11 = _mm_add_ps(tmp1, tmp2);
+    __m128 tmp12 = _mm_sub_ps(tmp1, tmp2);
+
+    d[0] = _mm_add_ps(tmp10, tmp11);
+    d[4] = _mm_sub_ps(tmp10, tmp11);
+
+    __m128 z1 = _mm_mul_ps(_mm_add_ps(tmp12, tmp13), c4);
+    d[2] = _mm_add_ps(tmp13, z1);
+    d[6] = _mm_sub_ps(tmp13, z1);
+
+    // Odd part
+    tmp10 = _mm_add_ps(tmp4, tmp5);
+    tmp11 = _mm_add_ps(tmp5, tmp6);
+    tmp12 = _mm_add_ps(tmp6, tmp7);
+
+    __m128 z5 = _mm_mul_ps(_mm_sub_ps(tmp10, tmp12), c6);
+    __m128 z2 = _mm_add_ps(_mm_mul_ps(c2_m_c6, tmp10), z5);
+    __m128 z4 = _mm_add_ps(_mm_mul_ps(c2_p_c6, tmp12), z5);
+    __m128 z3 = _mm_mul_ps(tmp11, c4);
+
+    __m128 z11 = _mm_add_ps(tmp7, z3);
+    __m128 z13 = _mm_sub_ps(tmp7, z3);
+
+    d[5] = _mm_add_ps(z13, z2);
+    d[3] = _mm_sub_ps(z13, z2);
+    d[1] = _mm_add_ps(z11, z4);
+    d[7] = _mm_sub_ps(z11, z4);
+}
+
+/*
+* Transposes an 8x8 float matrix held as lo[i] (columns 0-3) and hi[i] (columns 4-7) of row i.
+*/
+SSE4_TARGET
+static inline void transpose_8x8_sse4(__m128 *lo, __m128 *hi) {
+    __m128 a0 = lo[0], a1 = lo[1], a2 = lo[2], a3 = lo[3];     // top-left
+    __m128 b0 = hi[0], b1 = hi[1], b2 = hi[2], b3 = hi[3];     // top-right
+    __m128 c0 = lo[4], c1 = lo[5], c2 = lo[6], c3 = lo[7];     // bottom-left
+    __m128 e0 = hi[4], e1 = hi[5], e2 = hi[6], e3 = hi[7];     // bottom-right
+
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+
+    // Off-diagonal quadrants swap places
+    lo[0] = a0; lo[1] = a1; lo[2] = a2; lo[3] = a3;
+    hi[0] = c0; hi[1] = c1; hi[2] = c2; hi[3] = c3;
+    lo[4] = b0; lo[5] = b1; lo[6] = b2; lo[7] = b3;
+    hi[4] = e0; hi[5] = e1; hi[6] = e2; hi[7] = e3;
+}
+
+SSE4_TARGET
+static void dct_float_sse4(const float *block, float *out_dct_block) {
+    __m128 lo[8], hi[8];
+
+    for (int i = 0; i < 8; i++) {
+        lo[i] = _mm_loadu_ps(block + i * 8);
+        hi[i] = _mm_loadu_ps(block + i * 8 + 4);
+    }
+
+    // Row pass: after the transpose vector x holds column x, so the butterfly runs along rows
+    transpose_8x8_sse4(lo, hi);
+    aan_1d_sse4(lo);
+    aan_1d_sse4(hi);
+
+    // Column pass: transpose back so vector y holds row y
+    transpose_8x8_sse4(lo, hi);
+    aan_1d_sse4(lo);
+    aan_1d_sse4(hi);
+
+    for (int i = 0; i < 8; i++) {
+        _mm_storeu_ps(out_dct_block + i * 8, _mm_mul_ps(lo[i], _mm_loadu_ps(aan_descale + i * 8)));
+        _mm_storeu_ps(out_dct_block + i * 8 + 4, _mm_mul_ps(hi[i], _mm_loadu_ps(aan_descale + i * 8 + 4)));
+    }
+}
+
+/*
+* roundf() emulation: truncate, then step away from zero when the dropped fraction is >= 0.5.
+* The fraction v - trunc(v) is exact in float, so this matches roundf for every input.
+*/
+SSE4_TARGET
+static inline __m128i round_half_away_sse4(__m128 v) {
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 t = _mm_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m128 frac = _mm_andnot_ps(sign_mask, _mm_sub_ps(v, t));
+    __m128 step = _mm_or_ps(_mm_and_ps(v, sign_mask), one);             // copysign(1, v)
+    step = _mm_and_ps(step, _mm_cmpge_ps(frac, half));
+
+    return _mm_cvttps_epi32(_mm_add_ps(t, step));
+}
+
+SSE4_TARGET
+static void quantize_sse4(float *dct_block, const QUANT_TABLE *qt, int16_t *out_quantized_block) {
+    for (int i = 0; i < 64; i += 8) {
+        __m128 q0 = _mm_loadu_ps(qt->divisor + i);
+        __m128 q1 = _mm_loadu_ps(qt->divisor + i + 4);
+
+        __m128i r0 = round_half_away_sse4(_mm_div_ps(_mm_loadu_ps(dct_block + i), q0));
+        __m128i r1 = round_half_away_sse4(_mm_div_ps(_mm_loadu_ps(dct_block + i + 4), q1));
+
+        _mm_storeu_si128((__m128i*)(out_quantized_block + i), _mm_packs_epi32(r0, r1));
+    }
+}
+
+/*
+* Zigzag with PSHUFB. Output vector o (zigzag positions 8o..8o+7) gathers bytes from every input row
+* that holds one of its coefficients; lanes not taken from a row are zeroed (0x80) and rows are OR-ed.
+* The masks are constant, one per (output vector, source row) pair, 36 in all.
+*/
+static const uint8_t zigzag_masks[36][16] __attribute__((aligned(16))) = {
+    { 0x00, 0x01, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x04, 0x05, 0x06, 0x07, 0x80, 0x80 },   // out 0, row 0
+    { 0x80, 0x80, 0x80, 0x80, 0x00, 0x01, 0x80, 0x80, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x04, 0x05 },   // out 0, row 1
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x01, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 0, row 2
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x08, 0x09, 0x0a, 0x0b },   // out 1, row 0
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80 },   // out 1, row 1
+    { 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x04, 0x05, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 1, row 2
+    { 0x80, 0x80, 0x00, 0x01, 0x80, 0x80, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 1, row 3
+    { 0x80, 0x80, 0x80, 0x80, 0x00, 0x01, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 1, row 4
+    { 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 2, row 1
+    { 0x80, 0x80, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 2, row 2
+    { 0x80, 0x80, 0x80, 0x80, 0x04, 0x05, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 2, row 3
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x04, 0x05 },   // out 2, row 4
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x01, 0x80, 0x80, 0x02, 0x03, 0x80, 0x80 },   // out 2, row 5
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x01, 0x80, 0x80, 0x80, 0x80 },   // out 2, row 6
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0c, 0x0d, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 3, row 0
+    { 0x80, 0x80, 0x80, 0x80, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x0c, 0x0d, 0x80, 0x80, 0x80, 0x80 },   // out 3, row 1
+    { 0x80, 0x80, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0a, 0x0b, 0x80, 0x80 },   // out 3, row 2
+    { 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x08, 0x09 },   // out 3, row 3
+    { 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x08, 0x09 },   // out 4, row 4
+    { 0x80, 0x80, 0x04, 0x05, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x06, 0x07, 0x80, 0x80 },   // out 4, row 5
+    { 0x80, 0x80, 0x80, 0x80, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x04, 0x05, 0x80, 0x80, 0x80, 0x80 },   // out 4, row 6
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x01, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 4, row 7
+    { 0x80, 0x80, 0x80, 0x80, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 5, row 1
+    { 0x80, 0x80, 0x0c, 0x0d, 0x80, 0x80, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 5, row 2
+    { 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0c, 0x0d, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 5, row 3
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80 },   // out 5, row 4
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x08, 0x09, 0x80, 0x80 },   // out 5, row 5
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x06, 0x07 },   // out 5, row 6
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80 },   // out 6, row 3
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0c, 0x0d, 0x80, 0x80, 0x0e, 0x0f, 0x80, 0x80 },   // out 6, row 4
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0c, 0x0d },   // out 6, row 5
+    { 0x80, 0x80, 0x80, 0x80, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 6, row 6
+    { 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 6, row 7
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 },   // out 7, row 5
+    { 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x0c, 0x0d, 0x80, 0x80, 0x0e, 0x0f, 0x80, 0x80, 0x80, 0x80 },   // out 7, row 6
+    { 0x80, 0x80, 0x08, 0x09, 0x0a, 0x0b, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0c, 0x0d, 0x0e, 0x0f },   // out 7, row 7
+};
+
+#define ZIGZAG_ROW(s, m) _mm_shuffle_epi8(rows[s], _mm_load_si128((const __m128i*)zigzag_masks[m]))
+
+SSE4_TARGET
+void zigzag_order_sse4(const int16_t *input_block, int16_t *output_block) {
+    __m128i rows[8];
+    __m128i acc;
+
+    for (int s = 0; s < 8; s++) {
+        rows[s] = _mm_loadu_si128((const __m128i*)(input_block + s * 8));
+    }
+
+    // Fully unrolled with fixed masks; output vector o only reads the rows it needs
+    acc = _mm_or_si128(ZIGZAG_ROW(0, 0), ZIGZAG_ROW(1, 1));
+    acc = _mm_or_si128(acc, ZIGZAG_ROW(2, 2));
+    _mm_storeu_si128((__m128i*)(output_block + 0), acc);
+
+    acc = _mm_or_si128(ZIGZAG_ROW(0, 3), ZIGZAG_ROW(1, 4));
+    acc = _mm_or_si128(acc, _mm_or_si128(ZIGZAG_ROW(2, 5), ZIGZAG_ROW(3, 6)));
+    acc = _mm_or_si128(acc, ZIGZAG_ROW(4, 7));
+    _mm_storeu_si128((__m128i*)(output_block + 8), acc);
+
+    acc = _mm_or_si128(ZIGZAG_ROW(1, 8), ZIGZAG_ROW(2, 9));
+    acc = _mm_or_si128(acc, _mm_or_si128(ZIGZAG_ROW(3, 10), ZIGZAG_ROW(4, 11)));
+    acc = _mm_or_si128(acc, _mm_or_si128(ZIGZAG_ROW(5, 12), ZIGZAG_ROW(6, 13)));
+    _mm_storeu_si128((__m128i*)(output_block + 16), acc);
+
+    acc = _mm_or_si128(ZIGZAG_ROW(0, 14), ZIGZAG_ROW(1, 15));
+    acc = _mm_or_si128(acc, _mm_or_si128(ZIGZAG_ROW(2, 16), ZIGZAG_ROW(3, 17)));
+    _mm_storeu_si128((__m128i*)(output_block + 24), acc);
+
+    acc = _mm_or_si128(ZIGZAG_ROW(4, 18), ZIGZAG_ROW(5, 19));
+    acc = _mm_or_si128(acc, _mm_or_si128(ZIGZAG_ROW(6, 20), ZIGZAG_ROW(7, 21)));
+    _mm_storeu_si128((__m128i*)(output_block + 32), acc);
+
+    acc = _mm_or_si128(ZIGZAG_ROW(1, 22), ZIGZAG_ROW(2, 23));
+    acc = _mm_or_si128(acc, _mm_or_si128(ZIGZAG_ROW(3, 24), ZIGZAG_ROW(4, 25)));
+    acc = _mm_or_si128(acc, _mm_or_si128(ZIGZAG_ROW(5, 26), ZIGZAG_ROW(6, 27)));
+    _mm_storeu_si128((__m128i*)(output_block + 40), acc);
+
+    acc = _mm_or_si128(ZIGZAG_ROW(3, 28), ZIGZAG_ROW(4, 29));
+    acc = _mm_or_si128(acc, _mm_or_si128(ZIGZAG_ROW(5, 30), ZIGZAG_ROW(6, 31)));
+    acc = _mm_or_si128(acc, ZIGZAG_ROW(7, 32));
+    _mm_storeu_si128((__m128i*)(output_block + 48), acc);
+
+    acc = _mm_or_si128(ZIGZAG_ROW(5, 33), ZIGZAG_ROW(6, 34));
+    acc = _mm_or_si128(acc, ZIGZAG_ROW(7, 35));
+    _mm_storeu_si128((__m128i*)(output_block + 56), acc);
+}
+
+#undef ZIGZAG_ROW
+
+const KERNEL_TABLE kernels_sse4 = {
+    SIMD_ISA_SSE4,
+    "sse4",
+    rgb_to_y_sse4,
+    bgr_to_y_sse4,
+    dct_float_sse4,
+    quantize_sse4,
+    quantize_block_int,         // no per-lane variable shift before AVX2, scalar is used
+    zigzag_order_sse4
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include "yuv_input.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define Y4M_MAGIC "YUV4MPEG2"
+#define Y4M_LINE_MAX 256
+
+/*
+* Reads one header line (up to and without the '\n').
+* Returns 0 on success, 1 at the end of the file before any byte, -1 on error or an overlong line.
+*/
+static int read_line(FILE *file, char *line, size_t size) {
+    size_t length = 0;
+    int c;
+
+    while ((c = fgetc(file)) != EOF && c != '\n') {
+        if (length + 1 >= size) {
+            return -1;
+        }
+        line[length++] = (char)c;
+    }
+    line[length] = '\0';
+
+    if (c == EOF) {
+        return length == 0 ? 1 : -1;
+    }
+    return 0;
+}
+
+/*
+* Parses the Y4M stream header: "YUV4MPEG2 W<width> H<height> ... [C<colorspace>]".
+* The frame rate is kept for MJPEG output; interlacing and aspect ratio are skipped.
+*/
+static int parse_y4m_header(YUV_READER *reader) {
+    char line[Y4M_LINE_MAX];
+
+    if (read_line(reader->file, line, sizeof(line)) != 0 || strncmp(line, Y4M_MAGIC " ", strlen(Y4M_MAGIC) + 1) != 0) {
+        printf("Error: File is not a Y4M stream (missing %s header).\n", Y4M_MAGIC);
+        return -1;
+    }
+
+    reader->sampling = COLOR_MODE_420;          // Y4M default
+
+    for (char *token = strtok(line + strlen(Y4M_MAGIC), " "); token != NULL; token = strtok(NULL, " ")) {
+        switch (token[0]) {
+            case 'W':
+                reader->width = (uint32_t)strtoul(token + 1, NULL, 10);
+                break;
+            case 'H':
+                reader->height = (uint32_t)strtoul(token + 1, NULL, 10);
+                break;
+            case 'F':
+                if (sscanf(token + 1, "%u:%u", &reader->fps_num, &reader->fps_den) != 2 || reader->fps_den == 0) {
+                    reader->fps_num = reader->fps_den = 0;
+                }
+                break;
+            case 'C':
+                if (strcmp(token + 1, "420") == 0 || strcmp(token + 1, "420jpeg") == 0 ||
+                    strcmp(token + 1, "420paldv") == 0 || strcmp(token + 1, "420mpeg2") == 0) {
+                    reader->sampling = COLOR_MODE_420;
+                } else if (strcmp(token + 1, "422") == 0) {
+                    reader->sampling = COLOR_MODE_422;
+                } else if (strcmp(token + 1, "444") == 0) {
+                    reader->sampling = COLOR_MODE_444;
+                } else if (strcmp(token + 1, "mono") == 0) {
+                    reader->sampling = COLOR_MODE_GRAY;
+                } else {
+                    printf("Error: Y4M colorspace '%s' is not supported (8-bit 420, 422, 444 or mono only).\n", token + 1);
+                    return -1;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+/*
+* Chroma plane dimensions for a sampling (rounded up, as in I420 and Y4M).
+*/
+static void chroma_size(const YUV_READER *reader, uint32_t *width, uint32_t *height) {
+    uint32_t h_factor = color_mode_h_factor(reader->sampling);
+    uint32_t v_factor = color_mode_v_factor(reader->sampling);
+    *width = (reader->width + h_factor - 1) / h_factor;
+    *height = (reader->height + v_factor - 1) / v_factor;
+}
+
+int yuv_open(YUV_READER *reader, const char *inputFile, INPUT_FORMAT format, uint32_t width, uint32_t height) {
+    memset(reader, 0, sizeof(*reader));
+    reader->format = format;
+
+    reader->file = fopen(inputFile, "rb");
+    if (reader->file == NULL) {
+        printf("Error: Cannot open file %s\n", inputFile);
+        return -1;
+    }
+
+    if (format == INPUT_FORMAT_Y4M) {
+        if (parse_y4m_header(reader) != 0) {
+            yuv_close(reader);
+            return -1;
+        }
+    } else {
+        reader->width = width;
+        reader->height = height;
+        reader->sampling = format == INPUT_FORMAT_YUYV ? COLOR_MODE_422 : COLOR_MODE_420;
+    }
+
+    if (reader->width == 0 || reader->height == 0 || reader->width > 65535 || reader->height > 65535) {
+        printf("Error: Frame size must be 1-65535 in both dimensions (use -size WIDTHxHEIGHT for raw YUV).\n");
+        yuv_close(reader);
+        return -1;
+    }
+
+    if (format == INPUT_FORMAT_YUYV && reader->width % 2 != 0) {
+        printf("Error: YUYV frames need an even width.\n");
+        yuv_close(reader);
+        return -1;
+    }
+
+    size_t luma_size = (size_t)reader->width * reader->height;
+    uint32_t chroma_w, chroma_h;
+    chroma_size(reader, &chroma_w, &chroma_h);
+
+    if (format == INPUT_FORMAT_YUYV) {
+        reader->frame_size = luma_size * 2;
+    } else if (reader->sampling == COLOR_MODE_GRAY) {
+        reader->frame_size = luma_size;
+    } else {
+        reader->frame_size = luma_size + 2 * (size_t)chroma_w * chroma_h;
+    }
+
+    reader->buffer = (uint8_t*)malloc(reader->frame_size);
+    if (reader->buffer == NULL) {
+        printf("Error: Not enough memory for a %ux%u frame.\n", reader->width, reader->height);
+        yuv_close(reader);
+        return -1;
+    }
+
+    return 0;
+}
+
+int yuv_read_frame(YUV_READER *reader, YUV_IMAGE *image) {
+    if (reader->format == INPUT_FORMAT_Y4M) {
+        char line[Y4M_LINE_MAX];
+        int status = read_line(reader->file, line, sizeof(line));
+        if (status == 1) {
+            return 1;
+        }
+        if (status != 0 || strncmp(line, "FRAME", 5) != 0) {
+            printf("Error: Y4M frame header is missing.\n");
+            return -1;
+        }
+    }
+
+    size_t bytes = fread(reader->buffer, 1, reader->frame_size, reader->file);
+    if (bytes == 0 && reader->format != INPUT_FORMAT_Y4M && feof(reader->file)) {
+        return 1;
+    }
+    if (bytes != reader->frame_size) {
+        printf("Error: Frame is truncated (expected %zu bytes, read %zu).\n", reader->frame_size, bytes);
+        return -1;
+    }
+
+    uint32_t width = reader->width;
+    uint32_t height = reader->height;
+    uint32_t chroma_w, chroma_h;
+    chroma_size(reader, &chroma_w, &chroma_h);
+
+    image->width = width;
+    image->height = height;
+    image->sampling = reader->sampling;
+
+    const uint8_t *data = reader->buffer;
+    YUV_PLANE *y = &image->planes[0];
+    YUV_PLANE *u = &image->planes[1];
+    YUV_PLANE *v = &image->planes[2];
+
+    switch (reader->format) {
+        case INPUT_FORMAT_NV12:
+            // Y plane, then one plane of interleaved U, V pairs
+            *y = (YUV_PLANE){ data, width, height, width, 1 };
+            *u = (YUV_PLANE){ data + (size_t)width * height, chroma_w, chroma_h, chroma_w * 2, 2 };
+            *v = (YUV_PLANE){ data + (size_t)width * height + 1, chroma_w, chroma_h, chroma_w * 2, 2 };
+            break;
+        case INPUT_FORMAT_YUYV:
+            // Y0 U Y1 V per pixel pair
+            *y = (YUV_PLANE){ data, width, height, width * 2, 2 };
+            *u = (YUV_PLANE){ data + 1, chroma_w, chroma_h, width * 2, 4 };
+            *v = (YUV_PLANE){ data + 3, chroma_w, chroma_h, width * 2, 4 };
+            break;
+        default:
+            // I420 and Y4M: three consecutive planes (Y only for mono)
+            *y = (YUV_PLANE){ data, width, height, width, 1 };
+            if (reader->sampling == COLOR_MODE_GRAY) {
+                *u = *v = *y;
+            } else {
+                *u = (YUV_PLANE){ data + (size_t)width * height, chroma_w, chroma_h, chroma_w, 1 };
+                *v = (YUV_PLANE){ u->data + (size_t)chroma_w * chroma_h, chroma_w, chroma_h, chroma_w, 1 };
+            }
+            break;
+    }
+
+    return 0;
+}
+
+void yuv_close(YUV_READER *reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+
+    if (reader->file != NULL) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
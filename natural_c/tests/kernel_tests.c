@@ -0,0 +1,532 @@
+#include "test_util.h"
+#include "dct.h"
+#include "simd.h"
+#include "entropy.h"
+#include "output_sink.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* kernel_tests - equivalence of every kernel variant with the reference implementation.
+* Blocks come from a fixed seed plus edge cases (all-zero, saturated at -128 / +127, single
+* coefficient, single sample). Checks:
+*   - DCT: float AAN (every kernel set), islow and ifast stay within a bound of the exact DCT,
+*     and the SIMD float DCTs are bit-identical to the scalar one
+*   - quantization: float quantizers of every kernel set match the scalar one, integer quantizers
+*     match exact rounding for every coefficient value they accept
+*   - zigzag and color conversion kernels match the scalar ones
+*   - entropy coding: hand-derived golden bitstreams, dry run sizes and threaded coding
+*
+* Usage: kernel_tests
+*/
+
+// Largest allowed difference from the exact DCT, in coefficient units (|coefficient| <= 1024).
+// ifast truncates every multiply to 8-bit constants: its worst case (about 7) is the highest
+// frequencies of saturated noise, where the quantization step is large at any usual quality.
+#define DCT_FLOAT_BOUND 0.01
+#define DCT_ISLOW_BOUND 1.0
+#define DCT_IFAST_BOUND 8.0
+
+#define RANDOM_BLOCKS 512
+#define MAX_TEST_BLOCKS (RANDOM_BLOCKS + 1024)
+
+static const int test_qualities[] = { 1, 10, 25, 50, 75, 90, 100 };
+#define QUALITY_COUNT ((int)(sizeof(test_qualities) / sizeof(test_qualities[0])))
+
+/*
+* Test blocks: centered integer samples, as floats and as int16 (the integer DCT input).
+*/
+typedef struct {
+    uint32_t count;
+    float samples[MAX_TEST_BLOCKS][64];
+    int16_t samples_int[MAX_TEST_BLOCKS][64];
+    float exact[MAX_TEST_BLOCKS][64];       // perform_dct_one_block of each block
+} TEST_BLOCKS;
+
+static TEST_BLOCKS blocks;
+
+static const KERNEL_TABLE *tables[3];
+static int table_count;
+
+static int16_t clamp_sample(long value) {
+    if (value < -128) return -128;
+    if (value > 127) return 127;
+    return (int16_t)value;
+}
+
+static int16_t *add_block(void) {
+    return blocks.samples_int[blocks.count++];
+}
+
+static void build_blocks(void) {
+    blocks.count = 0;
+
+    // All-zero, flat saturated and checkerboards of the extremes
+    memset(add_block(), 0, 64 * sizeof(int16_t));
+    int16_t *low = add_block();
+    int16_t *high = add_block();
+    int16_t *checker = add_block();
+    int16_t *checker_inv = add_block();
+    int16_t *rows = add_block();
+    int16_t *columns = add_block();
+    for (int i = 0; i < 64; i++) {
+        int x = i % 8, y = i / 8;
+        low[i] = -128;
+        high[i] = 127;
+        checker[i] = ((x + y) & 1) ? 127 : -128;
+        checker_inv[i] = ((x + y) & 1) ? -128 : 127;
+        rows[i] = (y & 1) ? 127 : -128;
+        columns[i] = (x & 1) ? 127 : -128;
+    }
+
+    // Random mixes of -128 and +127
+    for (int b = 0; b < 64; b++) {
+        int16_t *block = add_block();
+        for (int i = 0; i < 64; i++) {
+            block[i] = (test_random() & 1) ? 127 : -128;
+        }
+    }
+
+    // Single coefficient: one cosine basis function at full and small amplitude
+    for (int amplitude = 0; amplitude < 2; amplitude++) {
+        float scale = amplitude ? 127.0f : 3.0f;
+        for (int u = 0; u < 8; u++) {
+            for (int v = 0; v < 8; v++) {
+                int16_t *block = add_block();
+                for (int i = 0; i < 64; i++) {
+                    int x = i % 8, y = i / 8;
+                    double basis = cos((2 * x + 1) * u * M_PI / 16) * cos((2 * y + 1) * v * M_PI / 16);
+                    block[i] = clamp_sample(lround(scale * basis));
+                }
+            }
+        }
+    }
+
+    // Single sample at either extreme
+    for (int i = 0; i < 64; i++) {
+        int16_t *positive = add_block();
+        int16_t *negative = add_block();
+        memset(positive, 0, 64 * sizeof(int16_t));
+        memset(negative, 0, 64 * sizeof(int16_t));
+        positive[i] = 127;
+        negative[i] = -128;
+    }
+
+    // Uniform random samples, and smooth ones with a little noise (typical photo content)
+    for (int b = 0; b < RANDOM_BLOCKS; b++) {
+        int16_t *block = add_block();
+        int base = test_random_range(-128, 127);
+        int slope_x = test_random_range(-12, 12);
+        int slope_y = test_random_range(-12, 12);
+        for (int i = 0; i < 64; i++) {
+            if (b & 1) {
+                block[i] = (int16_t)test_random_range(-128, 127);
+            } else {
+                block[i] = clamp_sample(base + slope_x * (i % 8) + slope_y * (i / 8) + test_random_range(-3, 3));
+            }
+        }
+    }
+
+    for (uint32_t b = 0; b < blocks.count; b++) {
+        for (int i = 0; i < 64; i++) {
+            blocks.samples[b][i] = (float)blocks.samples_int[b][i];
+        }
+        perform_dct_one_block(blocks.samples[b], blocks.exact[b]);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// DCT
+// ---------------------------------------------------------------------------------------------
+
+static void test_dct_float(void) {
+    float scalar[64];
+    float out[64];
+
+    for (int t = 0; t < table_count; t++) {
+        double max_error = 0.0;
+        int identical = 1;
+
+        for (uint32_t b = 0; b < blocks.count; b++) {
+            tables[t]->dct_float(blocks.samples[b], out);
+            perform_dct_one_block_aan(blocks.samples[b], scalar);
+
+            for (int i = 0; i < 64; i++) {
+                double error = fabs((double)out[i] - blocks.exact[b][i]);
+                if (error > max_error) max_error = error;
+            }
+            if (memcmp(out, scalar, sizeof(out)) != 0) identical = 0;
+        }
+
+        test_check(max_error <= DCT_FLOAT_BOUND, "dct %s: max error %.5f vs exact (bound %.2f)",
+                   tables[t]->name, max_error, DCT_FLOAT_BOUND);
+        test_check(identical, "dct %s: bit-identical to the scalar AAN DCT", tables[t]->name);
+    }
+}
+
+static void test_dct_int(void) {
+    int32_t out[64];
+
+    double islow_error = 0.0;
+    double ifast_error = 0.0;
+    for (uint32_t b = 0; b < blocks.count; b++) {
+        perform_dct_one_block_islow(blocks.samples_int[b], out);
+        for (int i = 0; i < 64; i++) {
+            double error = fabs(out[i] / 8.0 - blocks.exact[b][i]);
+            if (error > islow_error) islow_error = error;
+        }
+
+        perform_dct_one_block_ifast(blocks.samples_int[b], out);
+        for (int i = 0; i < 64; i++) {
+            double error = fabs(out[i] * (double)aan_descale[i] - blocks.exact[b][i]);
+            if (error > ifast_error) ifast_error = error;
+        }
+    }
+
+    test_check(islow_error <= DCT_ISLOW_BOUND, "dct islow: max error %.3f vs exact (bound %.1f)",
+               islow_error, DCT_ISLOW_BOUND);
+    test_check(ifast_error <= DCT_IFAST_BOUND, "dct ifast: max error %.3f vs exact (bound %.1f)",
+               ifast_error, DCT_IFAST_BOUND);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Quantization
+// ---------------------------------------------------------------------------------------------
+
+/*
+* Float quantizers on the exact DCT of every test block and on values at and next to the
+* rounding ties (k + 0.5) * divisor.
+*/
+static void test_quantize_float(void) {
+    static float inputs[MAX_TEST_BLOCKS + 64][64];
+    uint32_t input_count = 0;
+    int16_t expected[64];
+    int16_t out[64];
+
+    for (int q = 0; q < QUALITY_COUNT; q++) {
+        QUANT_TABLE qt;
+        init_quant_table(&qt, test_qualities[q]);
+
+        input_count = 0;
+        for (uint32_t b = 0; b < blocks.count; b++) {
+            memcpy(inputs[input_count++], blocks.exact[b], sizeof(inputs[0]));
+        }
+        for (int k = -32; k < 32; k++) {
+            float *block = inputs[input_count++];
+            for (int i = 0; i < 64; i++) {
+                float tie = ((float)k + 0.5f) * qt.divisor[i];
+                int side = (i + k) % 3;
+                block[i] = side == 0 ? tie : nextafterf(tie, side == 1 ? INFINITY : -INFINITY);
+            }
+        }
+
+        for (int t = 0; t < table_count; t++) {
+            int mismatches = 0;
+            for (uint32_t b = 0; b < input_count; b++) {
+                float scratch[64];
+                memcpy(scratch, inputs[b], sizeof(scratch));
+                quantize_block(scratch, &qt, expected);
+                memcpy(scratch, inputs[b], sizeof(scratch));
+                tables[t]->quantize(scratch, &qt, out);
+                if (memcmp(out, expected, sizeof(out)) != 0) mismatches++;
+            }
+            test_check(mismatches == 0, "quantize %s q%d: %d of %u blocks differ from the scalar quantizer",
+                       tables[t]->name, test_qualities[q], mismatches, input_count);
+        }
+    }
+}
+
+/*
+* Integer quantizers against exact round-half-away-from-zero division for every coefficient
+* value |v| < 2^15 at every position.
+*/
+static void test_quantize_int(void) {
+    const DCT_METHOD methods[2] = { DCT_METHOD_ISLOW, DCT_METHOD_IFAST };
+    int32_t in[64];
+    int16_t out[64];
+
+    for (int m = 0; m < 2; m++) {
+        for (int q = 0; q < QUALITY_COUNT; q++) {
+            QUANT_TABLE qt;
+            INT_QUANT_TABLE int_qt;
+            init_quant_table(&qt, test_qualities[q]);
+            init_int_quant_table(&int_qt, qt.natural, methods[m]);
+
+            for (int t = 0; t < table_count; t++) {
+                int mismatches = 0;
+                for (int32_t v = -32767; v <= 32767 && mismatches < 10; v += 64) {
+                    for (int i = 0; i < 64; i++) {
+                        in[i] = v + i;
+                    }
+                    tables[t]->quantize_int(in, &int_qt, out);
+
+                    for (int i = 0; i < 64; i++) {
+                        if (in[i] > 32767) continue;
+                        int32_t magnitude = in[i] < 0 ? -in[i] : in[i];
+                        int32_t expected = (2 * magnitude + int_qt.divisor[i]) / (2 * int_qt.divisor[i]);
+                        if (in[i] < 0) expected = -expected;
+                        if (out[i] != expected) {
+                            if (mismatches++ == 0) {
+                                printf("    %d / %u at position %d: got %d, expected %d\n",
+                                       in[i], int_qt.divisor[i], i, out[i], expected);
+                            }
+                        }
+                    }
+                }
+                test_check(mismatches == 0, "quantize_int %s %s q%d: exact rounding over |v| < 2^15",
+                           tables[t]->name, methods[m] == DCT_METHOD_ISLOW ? "islow" : "ifast",
+                           test_qualities[q]);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Zigzag and color conversion
+// ---------------------------------------------------------------------------------------------
+
+static void test_zigzag(void) {
+    int16_t in[64];
+    int16_t expected[64];
+    int16_t out[64];
+
+    for (int t = 0; t < table_count; t++) {
+        int mismatches = 0;
+        for (int b = 0; b < 64; b++) {
+            for (int i = 0; i < 64; i++) {
+                in[i] = (int16_t)(test_random() & 0xFFFF);
+            }
+            for (int k = 0; k < 64; k++) {
+                expected[k] = in[zigzag_map[k]];
+            }
+            tables[t]->zigzag(in, out);
+            if (memcmp(out, expected, sizeof(out)) != 0) mismatches++;
+        }
+        test_check(mismatches == 0, "zigzag %s: matches zigzag_map", tables[t]->name);
+    }
+}
+
+/*
+* Color conversion over every pixel count up to 67 (vector tails) and one large run.
+*/
+static void test_color_conversion(void) {
+    enum { MAX_PIXELS = 4099 };
+    static RGB rgb[MAX_PIXELS];
+    static uint8_t bgr[MAX_PIXELS * 3];
+    static float expected[MAX_PIXELS];
+    static float out[MAX_PIXELS + 1];      // one extra to catch writes past the end
+
+    for (int i = 0; i < MAX_PIXELS; i++) {
+        uint32_t r = test_random();
+        // The first 256 pixels are the gray levels, the rest random colors
+        uint8_t red = i < 256 ? (uint8_t)i : (uint8_t)r;
+        uint8_t green = i < 256 ? (uint8_t)i : (uint8_t)(r >> 8);
+        uint8_t blue = i < 256 ? (uint8_t)i : (uint8_t)(r >> 16);
+        rgb[i].r = red;
+        rgb[i].g = green;
+        rgb[i].b = blue;
+        bgr[3 * i] = blue;
+        bgr[3 * i + 1] = green;
+        bgr[3 * i + 2] = red;
+    }
+
+    int centered = 1;
+    rgb_to_y(rgb, expected, MAX_PIXELS);
+    bgr_to_y(bgr, out, MAX_PIXELS);
+    for (int i = 0; i < MAX_PIXELS; i++) {
+        if (out[i] != expected[i] - 128.0f) centered = 0;
+    }
+    test_check(centered, "bgr_to_y: equals rgb_to_y - 128");
+
+    for (int t = 0; t < table_count; t++) {
+        int rgb_mismatches = 0;
+        int bgr_mismatches = 0;
+        for (uint32_t count = 1; count <= 68; count++) {
+            uint32_t n = count <= 67 ? count : MAX_PIXELS;
+            rgb_to_y(rgb, expected, n);
+            memset(out, 0, sizeof(out));
+            tables[t]->rgb_to_y(rgb, out, n);
+            if (memcmp(out, expected, n * sizeof(float)) != 0 || out[n] != 0.0f) rgb_mismatches++;
+
+            bgr_to_y(bgr, expected, n);
+            memset(out, 0, sizeof(out));
+            tables[t]->bgr_to_y(bgr, out, n);
+            if (memcmp(out, expected, n * sizeof(float)) != 0 || out[n] != 0.0f) bgr_mismatches++;
+        }
+        test_check(rgb_mismatches == 0, "rgb_to_y %s: bit-identical to scalar, no write past the end", tables[t]->name);
+        test_check(bgr_mismatches == 0, "bgr_to_y %s: bit-identical to scalar, no write past the end", tables[t]->name);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Entropy coding
+// ---------------------------------------------------------------------------------------------
+
+/*
+* Encodes one zigzag-ordered block with the luminance tables and compares the flushed bytes.
+*/
+static void check_golden_block(const char *name, const int16_t *zigzag, const uint8_t *expected, uint32_t length) {
+    uint8_t buffer[64];
+    BitWriter bw;
+    bw_init(&bw, buffer, sizeof(buffer));
+    encode_coefficients(zigzag, 0, &std_lum_huffman, &bw);
+    bw_flush(&bw);
+
+    test_check(bw.byte_pos == length && memcmp(buffer, expected, length) == 0,
+               "golden %s: %u bytes, expected %u", name, bw.byte_pos, length);
+}
+
+/*
+* Bitstreams derived by hand from the Annex K luminance tables (bw_flush pads with zeros).
+*/
+static void test_golden_blocks(void) {
+    int16_t block[64];
+
+    // DC size 0 (00), EOB (1010)
+    memset(block, 0, sizeof(block));
+    static const uint8_t zero_block[] = { 0x28 };
+    check_golden_block("all-zero block", block, zero_block, sizeof(zero_block));
+
+    // DC size 1 (010) value -1 (0), EOB (1010)
+    block[0] = -1;
+    static const uint8_t dc_minus_one[] = { 0x4A };
+    check_golden_block("DC -1", block, dc_minus_one, sizeof(dc_minus_one));
+
+    // DC size 0 (00), AC 0/1 (00) value 1 (1), EOB (1010)
+    memset(block, 0, sizeof(block));
+    block[1] = 1;
+    static const uint8_t first_ac[] = { 0x0D, 0x00 };
+    check_golden_block("first AC 1", block, first_ac, sizeof(first_ac));
+
+    // DC size 0 (00), ZRL (11111111001), AC 0/1 (00) value 1 (1), EOB (1010)
+    block[1] = 0;
+    block[17] = 1;
+    static const uint8_t zero_run[] = { 0x3F, 0xC9, 0xA0 };
+    check_golden_block("16-zero run", block, zero_run, sizeof(zero_run));
+
+    // DC size 0 (00), 3 x ZRL, AC 14/1 (1111111111101011) value -1 (0), no EOB after the last
+    // position; the fourth byte is 0xFF and gets stuffed
+    memset(block, 0, sizeof(block));
+    block[63] = -1;
+    static const uint8_t last_ac[] = { 0x3F, 0xCF, 0xF9, 0xFF, 0x00, 0x3F, 0xFD, 0x60 };
+    check_golden_block("last AC -1", block, last_ac, sizeof(last_ac));
+
+    // 0xFF bytes of scan data are followed by a stuffed 0x00
+    uint8_t buffer[16];
+    BitWriter bw;
+    bw_init(&bw, buffer, sizeof(buffer));
+    bw_write(&bw, 0xFF, 8);
+    bw_write(&bw, 0x7F, 8);
+    bw_flush(&bw);
+    test_check(bw.byte_pos == 3 && buffer[0] == 0xFF && buffer[1] == 0x00 && buffer[2] == 0x7F,
+               "golden byte stuffing: FF 7F -> FF 00 7F");
+}
+
+/*
+* Random blocks with the given fraction of zero AC coefficients, in zigzag order.
+*/
+static int16_t *random_zigzag_blocks(uint32_t count, double sparsity) {
+    int16_t *zigzag = (int16_t*)malloc((size_t)count * 64 * sizeof(int16_t));
+    if (zigzag == NULL) return NULL;
+
+    for (uint32_t b = 0; b < count; b++) {
+        int16_t *block = &zigzag[(size_t)b * 64];
+        block[0] = (int16_t)test_random_range(-1024, 1023);
+        for (int k = 1; k < 64; k++) {
+            if ((test_random() % 1000) < sparsity * 1000) {
+                block[k] = 0;
+            } else {
+                // Mostly small values, some up to the baseline limit of 10 bits
+                int magnitude = (test_random() & 7) ? test_random_range(1, 15) : test_random_range(16, 1023);
+                block[k] = (int16_t)((test_random() & 1) ? magnitude : -magnitude);
+            }
+        }
+    }
+    return zigzag;
+}
+
+/*
+* Encodes blocks into a growable buffer, returns the number of scan bytes or -1.
+*/
+static long encode_scan(const int16_t *zigzag, uint32_t count, uint32_t restart_interval, int threads,
+                        GROWABLE_BUFFER *buffer) {
+    BW_SINK sink;
+    BitWriter bw;
+    buffer->offset = 0;
+    init_growable_sink(&sink, buffer);
+    bw_init_sink(&bw, &sink);
+
+    int status = encode_blocks(zigzag, count, restart_interval, &std_lum_huffman, threads, NULL, &bw);
+    if (bw_finish(&bw) != 0 || status != 0) return -1;
+    return (long)bw_total_bytes(&bw);
+}
+
+static void test_scan_coding(void) {
+    const uint32_t count = 3000;
+    const double sparsities[3] = { 0.0, 0.6, 0.95 };
+    const uint32_t intervals[3] = { 0, 1, 7 };
+    const int thread_counts[3] = { 2, 3, 8 };
+
+    for (int s = 0; s < 3; s++) {
+        int16_t *zigzag = random_zigzag_blocks(count, sparsities[s]);
+        GROWABLE_BUFFER serial = { NULL, 0, 0 };
+        GROWABLE_BUFFER threaded = { NULL, 0, 0 };
+        if (zigzag == NULL || growable_buffer_reserve(&serial, 4096) != 0 ||
+            growable_buffer_reserve(&threaded, 4096) != 0) {
+            test_check(0, "scan coding: out of memory");
+            free(zigzag);
+            growable_buffer_free(&serial);
+            growable_buffer_free(&threaded);
+            return;
+        }
+
+        for (int r = 0; r < 3; r++) {
+            long serial_size = encode_scan(zigzag, count, intervals[r], 1, &serial);
+            uint64_t dry_size = dry_run_scan_size(zigzag, count, intervals[r], &std_lum_huffman, 1, NULL);
+            test_check(serial_size > 0 && (uint64_t)serial_size == dry_size,
+                       "scan sparsity %.2f restart %u: dry run %llu bytes, encoded %ld",
+                       sparsities[s], intervals[r], (unsigned long long)dry_size, serial_size);
+
+            for (int t = 0; t < 3; t++) {
+                long threaded_size = encode_scan(zigzag, count, intervals[r], thread_counts[t], &threaded);
+                test_check(threaded_size == serial_size && memcmp(threaded.data, serial.data, (size_t)serial_size) == 0,
+                           "scan sparsity %.2f restart %u: %d threads byte-identical to serial",
+                           sparsities[s], intervals[r], thread_counts[t]);
+            }
+        }
+
+        free(zigzag);
+        growable_buffer_free(&serial);
+        growable_buffer_free(&threaded);
+    }
+}
+
+int main(void) {
+    test_seed(1);
+
+    SIMD_ISA isas[3] = { SIMD_ISA_SCALAR, SIMD_ISA_SSE4, SIMD_ISA_AVX2 };
+    for (int i = 0; i < 3; i++) {
+        const KERNEL_TABLE *table = get_kernel_table(isas[i]);
+        if (table != NULL) tables[table_count++] = table;
+    }
+
+    printf("Kernel sets:");
+    for (int t = 0; t < table_count; t++) printf(" %s", tables[t]->name);
+    printf("\n");
+
+    build_blocks();
+    printf("%u test blocks.\n", blocks.count);
+
+    test_dct_float();
+    test_dct_int();
+    test_quantize_float();
+    test_quantize_int();
+    test_zigzag();
+    test_color_conversion();
+    test_golden_blocks();
+    test_scan_coding();
+
+    return test_summary();
+}
@@ -0,0 +1,435 @@
+#include "test_util.h"
+#include "dct.h"
+#include "bmp_handler.h"
+#include "color_spaces.h"
+#include "grayscale.h"
+#include "simd.h"
+#include "encoder.h"
+#include "entropy.h"
+#include "output_sink.h"
+#include "pipeline.h"
+#include "jpegenc.h"
+#include "bmp_stream.h"
+#include "jfif_handler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+* scan_tests - byte-identical output of every way the encoder can produce a scan.
+* For each image of a corpus (e.g. gen_corpus -preset quick), DCT method, quality and restart
+* interval, the grayscale scan of the staged pipeline on scalar kernels and one thread is the
+* reference; the staged pipeline on every kernel set and thread count and the fused pipeline on
+* every kernel set, as well as the staged pipeline of libjpegenc, must produce the same bytes
+* (the slow exact DCT only staged against fused and libjpegenc).
+* Color files from libjpegenc must not depend on the kernel set, and streamed output must match
+* the in-memory file. The strip reader must refuse to go backwards.
+*
+* Usage: scan_tests <file.bmp | directory>...
+*/
+
+#define MAX_CORPUS_FILES 256
+
+static const DCT_METHOD methods[4] = { DCT_METHOD_EXACT, DCT_METHOD_FLOAT, DCT_METHOD_ISLOW, DCT_METHOD_IFAST };
+static const char *method_names[4] = { "exact", "float", "islow", "ifast" };
+static const int qualities[2] = { 50, 95 };
+static const uint32_t restart_intervals[2] = { 0, 3 };
+static const int thread_counts[2] = { 1, 4 };
+
+static const KERNEL_TABLE *tables[3];
+static int table_count;
+
+typedef struct {
+    BMP_IMAGE image;
+    uint32_t width;
+    uint32_t height;
+    const char *name;
+} TEST_IMAGE;
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/*
+* Adds a file, or every .bmp file of a directory (sorted by name).
+* Returns the new number of paths.
+*/
+static int add_input(char **paths, int count, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        printf("Error: Cannot open '%s'.\n", path);
+        return count;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        if (count < MAX_CORPUS_FILES) paths[count++] = strdup(path);
+        return count;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        printf("Error: Cannot read directory '%s'.\n", path);
+        return count;
+    }
+
+    int first = count;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < MAX_CORPUS_FILES) {
+        size_t length = strlen(entry->d_name);
+        if (length < 4 || strcmp(entry->d_name + length - 4, ".bmp") != 0) continue;
+
+        char file[4096];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        paths[count++] = strdup(file);
+    }
+    closedir(dir);
+
+    qsort(paths + first, count - first, sizeof(char*), compare_paths);
+    return count;
+}
+
+/*
+* Staged grayscale scan: whole-image Y conversion, segmentation and DCT on the selected kernels,
+* then quantization and entropy coding on 'threads' threads.
+* Returns the scan size in bytes, -1 on error.
+*/
+static long encode_staged_scan(TEST_IMAGE *test, DCT_METHOD method, const QUANT_TABLE *qt, uint32_t restart_interval,
+                               const KERNEL_TABLE *kernels, int threads, GROWABLE_BUFFER *scan) {
+    uint32_t blocks_w, blocks_h;
+    float *blocks;
+
+    select_kernels(kernels->isa);
+    RGB *pixels = read_pixels(test->image.buffer, test->width, test->height, test->image.info.height < 0);
+    float *y = convert_to_grayscale(pixels, test->width, test->height);
+    free(pixels);
+    center_around_zero(y, test->width, test->height);
+    image_to_blocks(y, test->width, test->height, &blocks_w, &blocks_h, &blocks);
+    free(y);
+
+    DCT_COEFFICIENTS coeffs = { method, blocks_w, blocks_h, blocks_w * blocks_h, NULL, NULL };
+    int16_t *zigzag = (int16_t*)malloc((size_t)coeffs.block_count * 64 * sizeof(int16_t));
+    if (method == DCT_METHOD_ISLOW || method == DCT_METHOD_IFAST) {
+        coeffs.coeffs_int = (int32_t*)malloc((size_t)coeffs.block_count * 64 * sizeof(int32_t));
+        if (coeffs.coeffs_int != NULL) perform_dct_int(blocks, blocks_w, blocks_h, coeffs.coeffs_int, method);
+    } else {
+        coeffs.coeffs = (float*)malloc((size_t)coeffs.block_count * 64 * sizeof(float));
+        if (coeffs.coeffs != NULL) perform_dct(blocks, blocks_w, blocks_h, coeffs.coeffs, method);
+    }
+    free(blocks);
+
+    long size = -1;
+    if (zigzag != NULL && (coeffs.coeffs != NULL || coeffs.coeffs_int != NULL)) {
+        quantize_coefficients(&coeffs, qt, kernels, threads, zigzag);
+
+        BW_SINK sink;
+        BitWriter bw;
+        scan->offset = 0;
+        init_growable_sink(&sink, scan);
+        bw_init_sink(&bw, &sink);
+
+        int status = encode_blocks(zigzag, coeffs.block_count, restart_interval, &std_lum_huffman, threads, NULL, &bw);
+        if (bw_finish(&bw) == 0 && status == 0) size = (long)bw_total_bytes(&bw);
+
+        // The dry run has to agree with the coder on every image
+        uint64_t predicted = dry_run_scan_size(zigzag, coeffs.block_count, restart_interval, &std_lum_huffman, threads, NULL);
+        if (size >= 0 && predicted != (uint64_t)size) {
+            printf("    dry run predicted %llu bytes, coded %ld\n", (unsigned long long)predicted, size);
+            size = -1;
+        }
+    }
+
+    free_dct_coefficients(&coeffs);
+    free(zigzag);
+    return size;
+}
+
+/*
+* Fused grayscale scan on the given kernels. Returns the scan size in bytes, -1 on error.
+*/
+static long encode_fused_scan(TEST_IMAGE *test, DCT_METHOD method, const QUANT_TABLE *qt, uint32_t restart_interval,
+                              const KERNEL_TABLE *kernels, GROWABLE_BUFFER *scan) {
+    ROW_SOURCE source;
+    BMP_MEMORY_SOURCE source_state;
+    init_bmp_memory_source(&source, &source_state, test->image.buffer, test->width, test->height,
+                           test->image.info.height > 0);
+
+    BW_SINK sink;
+    BitWriter bw;
+    scan->offset = 0;
+    init_growable_sink(&sink, scan);
+    bw_init_sink(&bw, &sink);
+
+    int status = encode_fused(&source, test->width, test->height, method, kernels, qt, restart_interval, NULL, NULL, &bw);
+    if (bw_finish(&bw) != 0 || status != 0) return -1;
+    return (long)bw_total_bytes(&bw);
+}
+
+/*
+* Staged grayscale scan from libjpegenc (DCT row by row from the source) on the given kernels and
+* threads, copied to 'scan'. Returns the scan size in bytes, -1 on error.
+*/
+static long encode_library_scan(TEST_IMAGE *test, DCT_METHOD method, int quality, uint32_t restart_interval,
+                                const KERNEL_TABLE *kernels, int threads, GROWABLE_BUFFER *scan) {
+    ROW_SOURCE source;
+    BMP_MEMORY_SOURCE source_state;
+    init_bmp_memory_source(&source, &source_state, test->image.buffer, test->width, test->height,
+                           test->image.info.height > 0);
+
+    JPEGENC_OPTIONS options;
+    jpegenc_default_options(&options, test->width, test->height);
+    options.quality = quality;
+    options.dct_method = method;
+    options.restart_interval = restart_interval;
+    options.isa = kernels->isa;
+    options.pipeline = PIPELINE_STAGED;
+    options.threads = threads;
+
+    JPEGENC_OUTPUT output;
+    JPEGENC_CONTEXT *ctx = jpegenc_create(&options);
+    long size = -1;
+    if (ctx != NULL && jpegenc_encode_rows(ctx, &source, &output) == 0 &&
+        growable_buffer_reserve(scan, output.scan_size) == 0) {
+        // The scan sits between the header and EOI
+        memcpy(scan->data, output.data + output.size - 2 - output.scan_size, output.scan_size);
+        size = (long)output.scan_size;
+    }
+    jpegenc_destroy(ctx);
+    return size;
+}
+
+static int same_scan(long size, const GROWABLE_BUFFER *scan, long reference_size, const GROWABLE_BUFFER *reference) {
+    return size >= 0 && size == reference_size && memcmp(scan->data, reference->data, (size_t)size) == 0;
+}
+
+/*
+* Grayscale scans of one image in every configuration against the staged scalar single-thread one.
+*/
+static void test_grayscale(TEST_IMAGE *test, GROWABLE_BUFFER *reference, GROWABLE_BUFFER *scan) {
+    for (int m = 0; m < 4; m++) {
+        for (int q = 0; q < 2; q++) {
+            QUANT_TABLE qt;
+            init_quant_table(&qt, qualities[q]);
+
+            for (int r = 0; r < 2; r++) {
+                // The exact DCT costs thousands of cosf calls per block and is only a reference
+                // (kernel_tests checks the others against it): staged against fused, once
+                int exact = methods[m] == DCT_METHOD_EXACT;
+                if (exact && (q > 0 || r > 0)) continue;
+
+                uint32_t restart = restart_intervals[r];
+                long reference_size = encode_staged_scan(test, methods[m], &qt, restart, tables[0], 1, reference);
+                int variants = 0;
+                int failed = reference_size < 0;
+
+                for (int t = 0; t < (exact ? 1 : table_count) && !failed; t++) {
+                    for (int n = exact ? 2 : 0; n < 2; n++) {
+                        if (t == 0 && thread_counts[n] == 1) continue;
+                        long size = encode_staged_scan(test, methods[m], &qt, restart, tables[t], thread_counts[n], scan);
+                        variants++;
+                        if (!same_scan(size, scan, reference_size, reference)) {
+                            printf("    staged %s, %d threads differs\n", tables[t]->name, thread_counts[n]);
+                            failed = 1;
+                        }
+                    }
+
+                    long size = encode_fused_scan(test, methods[m], &qt, restart, tables[t], scan);
+                    variants++;
+                    if (!same_scan(size, scan, reference_size, reference)) {
+                        printf("    fused %s differs\n", tables[t]->name);
+                        failed = 1;
+                    }
+
+                    size = encode_library_scan(test, methods[m], qualities[q], restart, tables[t], 4, scan);
+                    variants++;
+                    if (!same_scan(size, scan, reference_size, reference)) {
+                        printf("    libjpegenc staged %s, 4 threads differs\n", tables[t]->name);
+                        failed = 1;
+                    }
+                }
+
+                test_check(!failed, "%s gray %s q%d restart %u: %d variants byte-identical (%ld bytes)",
+                           test->name, method_names[m], qualities[q], restart, variants, reference_size);
+            }
+        }
+    }
+}
+
+/*
+* Writes the reference file's scan with jfif_writev behind a header built from 'frame' and reads it back.
+* Returns 1 when the file matches the reference byte for byte.
+*/
+static int same_as_writev(const JPEGENC_OUTPUT *reference, const JFIF_FRAME *frame) {
+    JFIF_HEADER header;
+    jfif_header_init(&header, frame);
+
+    FILE *file = tmpfile();
+    uint8_t *written = (uint8_t*)malloc(reference->size);
+    const uint8_t *scan = reference->data + reference->size - 2 - reference->scan_size;
+    int same = file != NULL && written != NULL &&
+               jfif_writev(fileno(file), &header, scan, (uint32_t)reference->scan_size) == 0;
+    if (same) {
+        rewind(file);
+        same = fread(written, 1, reference->size, file) == reference->size && fgetc(file) == EOF &&
+               memcmp(written, reference->data, reference->size) == 0;
+    }
+    free(written);
+    if (file != NULL) fclose(file);
+    return same;
+}
+
+/*
+* Color files from libjpegenc on every kernel set, the streamed file on the scalar set and the same
+* file written with jfif_writev.
+*/
+static void test_color(TEST_IMAGE *test) {
+    const COLOR_MODE modes[3] = { COLOR_MODE_444, COLOR_MODE_422, COLOR_MODE_420 };
+    const char *mode_names[3] = { "444", "422", "420" };
+
+    ROW_SOURCE source;
+    BMP_MEMORY_SOURCE source_state;
+    init_bmp_memory_source(&source, &source_state, test->image.buffer, test->width, test->height,
+                           test->image.info.height > 0);
+
+    for (int c = 0; c < 3; c++) {
+        for (int m = 1; m < 4; m++) {     // without the exact DCT, which is covered by test_grayscale
+            JPEGENC_OPTIONS options;
+            jpegenc_default_options(&options, test->width, test->height);
+            options.quality = 75;
+            options.color_mode = modes[c];
+            options.dct_method = methods[m];
+            options.isa = tables[0]->isa;
+
+            JPEGENC_CONTEXT *ctx = jpegenc_create(&options);
+            JPEGENC_CONTEXT *variant_ctx = jpegenc_create(&options);
+            JPEGENC_OUTPUT reference;
+            JPEGENC_OUTPUT output;
+            int failed = ctx == NULL || variant_ctx == NULL || jpegenc_encode_rows(ctx, &source, &reference) != 0;
+
+            for (int t = 1; t < table_count && !failed; t++) {
+                options.isa = tables[t]->isa;
+                if (jpegenc_reset(variant_ctx, &options) != 0 || jpegenc_encode_rows(variant_ctx, &source, &output) != 0 ||
+                    output.size != reference.size || memcmp(output.data, reference.data, reference.size) != 0) {
+                    printf("    %s differs\n", tables[t]->name);
+                    failed = 1;
+                }
+            }
+
+            // Streamed through the file descriptor ring, read back
+            FILE *file = tmpfile();
+            options.isa = tables[0]->isa;
+            if (!failed && (file == NULL || jpegenc_reset(variant_ctx, &options) != 0 ||
+                            jpegenc_stream_rows(variant_ctx, &source, fileno(file), &output) != 0 ||
+                            output.size != reference.size)) {
+                printf("    streaming failed or has the wrong size\n");
+                failed = 1;
+            }
+            if (!failed) {
+                uint8_t *streamed = (uint8_t*)malloc(reference.size);
+                rewind(file);
+                if (streamed == NULL || fread(streamed, 1, reference.size, file) != reference.size ||
+                    memcmp(streamed, reference.data, reference.size) != 0) {
+                    printf("    streamed file differs\n");
+                    failed = 1;
+                }
+                free(streamed);
+            }
+            if (file != NULL) fclose(file);
+
+            // The default options use the standard tables, so the header can be rebuilt here
+            QUANT_TABLE qt, chroma_qt;
+            init_quant_table(&qt, options.quality);
+            init_chroma_quant_table(&chroma_qt, options.quality);
+            JFIF_FRAME frame = { (uint16_t)test->width, (uint16_t)test->height, 0, modes[c], { &qt, &chroma_qt },
+                                 { &std_lum_huffman, &std_chrom_huffman } };
+            if (!failed && !same_as_writev(&reference, &frame)) {
+                printf("    file written with jfif_writev differs\n");
+                failed = 1;
+            }
+
+            test_check(!failed, "%s color %s %s: kernel sets, streaming and writev byte-identical (%zu bytes)",
+                       test->name, mode_names[c], method_names[m], failed ? (size_t)0 : reference.size);
+
+            jpegenc_destroy(ctx);
+            jpegenc_destroy(variant_ctx);
+        }
+    }
+}
+
+/*
+* The strip reader only reads forwards: fetching a strip it has passed must fail instead of waiting.
+*/
+static void test_strip_order(const char *path, const char *name) {
+    BMP_STRIP_READER reader;
+    ROW_SOURCE source;
+    const uint8_t *rows[8];
+
+    if (bmp_strip_open(&reader, path) != 0) {
+        test_check(0, "%s: strip reader cannot open the file", name);
+        return;
+    }
+    init_bmp_strip_source(&source, &reader);
+
+    int forwards = source.fetch_rows(source.ctx, 0, rows) == 0 && source.fetch_rows(source.ctx, 0, rows) == 0 &&
+                   source.fetch_rows(source.ctx, 1, rows) == 0;
+    int backwards = source.fetch_rows(source.ctx, 0, rows);
+    bmp_strip_close(&reader);
+
+    test_check(forwards && backwards != 0, "%s: strip reader refuses an earlier strip", name);
+}
+
+int main(int argc, char *argv[]) {
+    char *paths[MAX_CORPUS_FILES];
+    int count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        count = add_input(paths, count, argv[i]);
+    }
+    if (count == 0) {
+        printf("Usage: scan_tests <file.bmp | directory>...\n");
+        return 1;
+    }
+
+    SIMD_ISA isas[3] = { SIMD_ISA_SCALAR, SIMD_ISA_SSE4, SIMD_ISA_AVX2 };
+    for (int i = 0; i < 3; i++) {
+        const KERNEL_TABLE *table = get_kernel_table(isas[i]);
+        if (table != NULL) tables[table_count++] = table;
+    }
+
+    GROWABLE_BUFFER reference = { NULL, 0, 0 };
+    GROWABLE_BUFFER scan = { NULL, 0, 0 };
+    if (growable_buffer_reserve(&reference, 4096) != 0 || growable_buffer_reserve(&scan, 4096) != 0) {
+        printf("Error: Not enough memory for the scan buffers.\n");
+        return 1;
+    }
+
+    int strip_order_tested = 0;
+    for (int i = 0; i < count; i++) {
+        TEST_IMAGE test;
+        const char *slash = strrchr(paths[i], '/');
+        test.name = slash ? slash + 1 : paths[i];
+        test.image = load_bmp_image(paths[i]);
+        if (test.image.buffer == NULL) {
+            test_check(0, "%s: cannot be loaded", test.name);
+            free(paths[i]);
+            continue;
+        }
+        test.width = (uint32_t)test.image.info.width;
+        test.height = (uint32_t)(test.image.info.height < 0 ? -test.image.info.height : test.image.info.height);
+
+        test_grayscale(&test, &reference, &scan);
+        test_color(&test);
+        if (!strip_order_tested && test.height > BMP_STRIP_ROWS) {
+            test_strip_order(paths[i], test.name);
+            strip_order_tested = 1;
+        }
+
+        free(test.image.buffer);
+        free(paths[i]);
+    }
+
+    growable_buffer_free(&reference);
+    growable_buffer_free(&scan);
+    return test_summary();
+}
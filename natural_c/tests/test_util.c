@@ -0,0 +1,43 @@
+#include "test_util.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+static uint32_t rng_state = 1;
+static int checks;
+static int failures;
+
+void test_seed(uint32_t seed) {
+    rng_state = seed ? seed : 1;
+}
+
+uint32_t test_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+int test_random_range(int low, int high) {
+    return low + (int)(test_random() % (uint32_t)(high - low + 1));
+}
+
+void test_check(int passed, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    printf("%s ", passed ? "ok  " : "FAIL");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+
+    checks++;
+    if (!passed) failures++;
+}
+
+int test_summary(void) {
+    if (failures) {
+        printf("%d of %d checks failed.\n", failures, checks);
+        return 1;
+    }
+    printf("All %d checks passed.\n", checks);
+    return 0;
+}
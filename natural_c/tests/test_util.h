@@ -0,0 +1,35 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdint.h>
+
+/*
+* Helpers shared by the test executables: a seeded generator and pass/fail bookkeeping.
+*/
+
+/*
+* Seeds the generator (xorshift32, 0 is replaced by 1).
+*/
+void test_seed(uint32_t seed);
+
+/*
+* Returns the next 32-bit pseudo-random value.
+*/
+uint32_t test_random(void);
+
+/*
+* Returns a pseudo-random value in [low, high].
+*/
+int test_random_range(int low, int high);
+
+/*
+* Records one check and prints "ok" or "FAIL" with the formatted description.
+*/
+void test_check(int passed, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/*
+* Prints the number of failed checks. Returns the process exit code: 0 if all checks passed, 1 otherwise.
+*/
+int test_summary(void);
+
+#endif
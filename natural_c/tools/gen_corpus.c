@@ -0,0 +1,397 @@
+#include "bmp_handler.h"
+#include "pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+/*
+* gen_corpus - synthetic 24-bit BMP images for benchmarks and tests.
+* Content types cover the range of entropy-coder load: smooth gradients, flat regions,
+* text/screen content, white noise and natural-image-like 1/f noise. Any size works,
+* including sizes that are not multiples of 8. Output is deterministic for a given seed.
+*
+* Usage:
+*   gen_corpus -pattern NAME -size WxH [-noise N] [-slope S] [-seed N] -output file.bmp
+*   gen_corpus -preset quick|default|stress [-noise N] [-seed N] -output directory
+*/
+
+typedef enum {
+    PATTERN_GRADIENT = 0,
+    PATTERN_FLAT,
+    PATTERN_TEXT,
+    PATTERN_NOISE,
+    PATTERN_NATURAL,
+    PATTERN_COUNT
+} PATTERN;
+
+static const char *pattern_names[PATTERN_COUNT] = { "gradient", "flat", "text", "noise", "natural" };
+
+typedef struct {
+    PATTERN pattern;
+    uint32_t width;
+    uint32_t height;
+    int noise;                  // additive noise amplitude in levels, 0 = none
+    double slope;               // natural: amplitude ~ wavelength^slope (1 = 1/f)
+    uint32_t seed;
+} IMAGE_SPEC;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+} FRAME_SIZE;
+
+/*
+* Image sets written by -preset: every pattern at every size.
+*   quick   - tiny and odd sizes for tests (edge blocks, partial MCUs, single pixel)
+*   default - common video and photo sizes, one of them odd, for benchmarks
+*   stress  - 4K and 8K
+*/
+static const FRAME_SIZE preset_quick[] = { {1, 1}, {7, 5}, {8, 8}, {17, 9}, {64, 64}, {101, 67} };
+static const FRAME_SIZE preset_default[] = { {640, 480}, {1280, 720}, {1920, 1080}, {1921, 1081} };
+static const FRAME_SIZE preset_stress[] = { {3840, 2160}, {7680, 4320} };
+
+static uint32_t rng_state;
+
+static uint32_t next_random(void) {
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/*
+* Stateless hash of lattice coordinates, for noise that does not depend on evaluation order.
+*/
+static uint32_t hash3(uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ z * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+}
+
+static uint8_t clamp_byte(int value) {
+    return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+/*
+* Image being generated: bottom-up BGR rows as stored in the BMP file.
+*/
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint8_t *pixels;
+} CANVAS;
+
+static inline void put_pixel(CANVAS *canvas, uint32_t x, uint32_t y, int r, int g, int b) {
+    uint8_t *p = canvas->pixels + (size_t)(canvas->height - 1 - y) * canvas->stride + (size_t)x * 3;
+    p[0] = clamp_byte(b);
+    p[1] = clamp_byte(g);
+    p[2] = clamp_byte(r);
+}
+
+static void draw_gradient(CANVAS *canvas) {
+    double wx = canvas->width > 1 ? canvas->width - 1 : 1;
+    double hy = canvas->height > 1 ? canvas->height - 1 : 1;
+
+    for (uint32_t y = 0; y < canvas->height; y++) {
+        for (uint32_t x = 0; x < canvas->width; x++) {
+            put_pixel(canvas, x, y, (int)(255.0 * x / wx), (int)(255.0 * y / hy), (int)(127.5 * (x / wx + y / hy)));
+        }
+    }
+}
+
+/*
+* Flat regions: a jittered grid of cells 16-200 pixels wide, one color each. Edges fall
+* anywhere inside the 8x8 blocks.
+*/
+static void draw_flat(CANVAS *canvas, uint32_t seed) {
+    uint32_t cell = 16 + hash3(seed, 1, 0) % 185;
+    uint32_t offset_x = hash3(seed, 2, 0) % cell;
+    uint32_t offset_y = hash3(seed, 3, 0) % cell;
+
+    for (uint32_t y = 0; y < canvas->height; y++) {
+        for (uint32_t x = 0; x < canvas->width; x++) {
+            uint32_t h = hash3((x + offset_x) / cell, (y + offset_y) / cell, seed);
+            put_pixel(canvas, x, y, h & 0xFF, (h >> 8) & 0xFF, (h >> 16) & 0xFF);
+        }
+    }
+}
+
+/*
+* Screen content: window backgrounds, title bars and lines of 5x7 glyphs in 6x10 cells.
+*/
+static void draw_text(CANVAS *canvas, uint32_t seed) {
+    static const int palette[4][3] = { {250, 250, 250}, {236, 240, 244}, {255, 253, 240}, {32, 34, 40} };
+    uint8_t glyphs[64][7];
+
+    for (int g = 0; g < 64; g++) {
+        for (int row = 0; row < 7; row++) {
+            glyphs[g][row] = (uint8_t)(hash3(g, row, seed) & 0x1F);
+        }
+    }
+
+    for (uint32_t y = 0; y < canvas->height; y++) {
+        uint32_t band = y / 240;                    // one window per 240 rows
+        uint32_t band_y = y % 240;
+        const int *background = palette[hash3(band, 7, seed) % 4];
+        int dark = background[0] < 128;
+
+        for (uint32_t x = 0; x < canvas->width; x++) {
+            int r = background[0], g = background[1], b = background[2];
+
+            if (band_y < 24) {
+                // Title bar
+                uint32_t h = hash3(band, 8, seed);
+                r = 40 + (h & 0x7F);
+                g = 60 + ((h >> 8) & 0x7F);
+                b = 120 + ((h >> 16) & 0x7F);
+            } else if (x >= 8 && band_y >= 32) {
+                uint32_t line = (band_y - 32) / 10;
+                uint32_t column = (x - 8) / 6;
+                uint32_t gx = (x - 8) % 6;
+                uint32_t gy = (band_y - 32) % 10;
+                uint32_t code = hash3(column, line * 131 + band, seed);
+
+                // Words of 2-8 characters, lines of varying length
+                int blank = code % 7 == 0 || column > 20 + hash3(line, band, seed) % (canvas->width / 6 + 1);
+                if (!blank && gx < 5 && gy < 7 && (glyphs[code % 64][gy] >> (4 - gx) & 1)) {
+                    int ink = dark ? 220 : 20;
+                    r = ink;
+                    g = ink;
+                    b = code % 11 == 0 ? 200 : ink;     // some colored links
+                }
+            }
+            put_pixel(canvas, x, y, r, g, b);
+        }
+    }
+}
+
+static void draw_noise(CANVAS *canvas) {
+    for (uint32_t y = 0; y < canvas->height; y++) {
+        for (uint32_t x = 0; x < canvas->width; x++) {
+            uint32_t r = next_random();
+            put_pixel(canvas, x, y, r & 0xFF, (r >> 8) & 0xFF, (r >> 16) & 0xFF);
+        }
+    }
+}
+
+/*
+* Value noise in [-1, 1] with lattice spacing 'period', smoothly interpolated.
+*/
+static float value_noise(uint32_t x, uint32_t y, uint32_t period, uint32_t layer) {
+    uint32_t cx = x / period, cy = y / period;
+    float fx = (float)(x % period) / period;
+    float fy = (float)(y % period) / period;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+
+    float v00 = (float)(hash3(cx, cy, layer) & 0xFFFF);
+    float v10 = (float)(hash3(cx + 1, cy, layer) & 0xFFFF);
+    float v01 = (float)(hash3(cx, cy + 1, layer) & 0xFFFF);
+    float v11 = (float)(hash3(cx + 1, cy + 1, layer) & 0xFFFF);
+
+    float top = v00 + (v10 - v00) * fx;
+    float bottom = v01 + (v11 - v01) * fx;
+    return (top + (bottom - top) * fy) / 32767.5f - 1.0f;
+}
+
+/*
+* Natural-image-like content: octaves of value noise with amplitude proportional to
+* wavelength^slope, which approximates the 1/f spectrum of photographs for slope = 1.
+* Luminance has all octaves down to 1 pixel, chroma only the coarse ones.
+*/
+static void draw_natural(CANVAS *canvas, uint32_t seed, double slope) {
+    enum { OCTAVES = 9 };
+    float amplitude[OCTAVES];
+    float total = 0.0f;
+
+    for (int o = 0; o < OCTAVES; o++) {
+        amplitude[o] = (float)pow((double)(256u >> o), slope);
+        total += amplitude[o];
+    }
+
+    for (uint32_t y = 0; y < canvas->height; y++) {
+        for (uint32_t x = 0; x < canvas->width; x++) {
+            float luma = 0.0f;
+            for (int o = 0; o < OCTAVES; o++) {
+                luma += amplitude[o] * value_noise(x, y, 256u >> o, seed * 16 + o);
+            }
+            luma = 128.0f + 180.0f * luma / total;
+
+            float u = 40.0f * value_noise(x, y, 192, seed * 16 + 10) + 15.0f * value_noise(x, y, 48, seed * 16 + 11);
+            float v = 40.0f * value_noise(x, y, 160, seed * 16 + 12) + 15.0f * value_noise(x, y, 40, seed * 16 + 13);
+
+            put_pixel(canvas, x, y, (int)(luma + v), (int)(luma - 0.35f * u - 0.55f * v), (int)(luma + u));
+        }
+    }
+}
+
+/*
+* Adds triangular noise of +-'amount' levels to every channel.
+*/
+static void add_noise(CANVAS *canvas, int amount) {
+    for (uint32_t y = 0; y < canvas->height; y++) {
+        uint8_t *row = canvas->pixels + (size_t)y * canvas->stride;
+        for (uint32_t i = 0; i < canvas->width * 3; i++) {
+            uint32_t r = next_random();
+            int delta = (int)((r & 0xFFFF) % (uint32_t)(amount + 1)) - (int)(((r >> 16) & 0xFFFF) % (uint32_t)(amount + 1));
+            row[i] = clamp_byte(row[i] + delta);
+        }
+    }
+}
+
+/*
+* Generates one image and writes it as a bottom-up 24-bit BMP.
+* Returns 0 on success, -1 on error.
+*/
+static int generate_image(const IMAGE_SPEC *spec, const char *path) {
+    CANVAS canvas;
+    canvas.width = spec->width;
+    canvas.height = spec->height;
+    canvas.stride = bmp_row_stride(spec->width);
+    canvas.pixels = (uint8_t*)calloc((size_t)canvas.stride * canvas.height, 1);
+    if (canvas.pixels == NULL) {
+        printf("Error: Not enough memory for a %ux%u image.\n", spec->width, spec->height);
+        return -1;
+    }
+
+    rng_state = hash3(spec->seed, spec->pattern, spec->width * 65536u + spec->height) | 1;
+
+    switch (spec->pattern) {
+        case PATTERN_GRADIENT: draw_gradient(&canvas); break;
+        case PATTERN_FLAT: draw_flat(&canvas, spec->seed); break;
+        case PATTERN_TEXT: draw_text(&canvas, spec->seed); break;
+        case PATTERN_NOISE: draw_noise(&canvas); break;
+        default: draw_natural(&canvas, spec->seed, spec->slope); break;
+    }
+    if (spec->noise > 0) {
+        add_noise(&canvas, spec->noise);
+    }
+
+    BMP_IMAGE image;
+    memset(&image, 0, sizeof(image));
+    image.header.file_type = 0x4D42;            // "BM"
+    image.info.width = (int32_t)spec->width;
+    image.info.height = (int32_t)spec->height;
+    image.info.planes = 1;
+    image.info.bit_per_px = 24;
+    image.info.img_size = canvas.stride * canvas.height;
+    image.info.x_px_m = 2835;                   // 72 DPI
+    image.info.y_px_m = 2835;
+    image.buffer = canvas.pixels;
+
+    // store_bmp_image fills in the header sizes and offsets; it does not report errors, so a
+    // stale file must not be mistaken for the new one
+    remove(path);
+    store_bmp_image(image, path);
+    free(canvas.pixels);
+
+    struct stat st;
+    return stat(path, &st) == 0 ? 0 : -1;
+}
+
+/*
+* Writes every pattern at every size of a preset into 'directory' as PATTERN_WxH.bmp.
+*/
+static int generate_preset(const FRAME_SIZE *sizes, int size_count, IMAGE_SPEC spec, const char *directory) {
+    mkdir(directory, 0755);
+
+    int status = 0;
+    for (int s = 0; s < size_count; s++) {
+        for (int p = 0; p < PATTERN_COUNT; p++) {
+            char path[4096];
+            spec.pattern = (PATTERN)p;
+            spec.width = sizes[s].width;
+            spec.height = sizes[s].height;
+            snprintf(path, sizeof(path), "%s/%s_%ux%u.bmp", directory, pattern_names[p], spec.width, spec.height);
+
+            if (generate_image(&spec, path) != 0) status = -1;
+        }
+    }
+    return status;
+}
+
+static void print_usage(void) {
+    printf("Usage:\n");
+    printf("  gen_corpus -pattern NAME -size WxH [options] -output file.bmp\n");
+    printf("  gen_corpus -preset quick|default|stress [options] -output directory\n");
+    printf("Patterns: gradient, flat, text, noise, natural\n");
+    printf("  -noise N          add +-N levels of noise to every channel (default 0)\n");
+    printf("  -slope S          natural: amplitude ~ wavelength^S, 1 = 1/f (default 1.0)\n");
+    printf("  -seed N           generator seed (default 1)\n");
+}
+
+int main(int argc, char *argv[]) {
+    IMAGE_SPEC spec = { PATTERN_NATURAL, 0, 0, 0, 1.0, 1 };
+    const char *preset = NULL;
+    const char *output = NULL;
+    int have_pattern = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp("-pattern", argv[i]) == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            int p;
+            for (p = 0; p < PATTERN_COUNT && strcmp(name, pattern_names[p]) != 0; p++) {}
+            if (p == PATTERN_COUNT) {
+                printf("Error: Unknown pattern '%s'.\n", name);
+                return -1;
+            }
+            spec.pattern = (PATTERN)p;
+            have_pattern = 1;
+        }
+        else if (strcmp("-size", argv[i]) == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ux%u", &spec.width, &spec.height) != 2 || spec.width == 0 || spec.height == 0) {
+                printf("Error: Size must be WIDTHxHEIGHT.\n");
+                return -1;
+            }
+        }
+        else if (strcmp("-noise", argv[i]) == 0 && i + 1 < argc) {
+            spec.noise = atoi(argv[++i]);
+        }
+        else if (strcmp("-slope", argv[i]) == 0 && i + 1 < argc) {
+            spec.slope = atof(argv[++i]);
+        }
+        else if (strcmp("-seed", argv[i]) == 0 && i + 1 < argc) {
+            spec.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp("-preset", argv[i]) == 0 && i + 1 < argc) {
+            preset = argv[++i];
+        }
+        else if (strcmp("-output", argv[i]) == 0 && i + 1 < argc) {
+            output = argv[++i];
+        }
+        else {
+            print_usage();
+            return -1;
+        }
+    }
+
+    if (output == NULL || (preset == NULL && (!have_pattern || spec.width == 0))) {
+        print_usage();
+        return -1;
+    }
+    if (spec.noise < 0) spec.noise = 0;
+
+    if (preset == NULL) {
+        return generate_image(&spec, output);
+    }
+    if (strcmp(preset, "quick") == 0) {
+        return generate_preset(preset_quick, sizeof(preset_quick) / sizeof(preset_quick[0]), spec, output);
+    }
+    if (strcmp(preset, "default") == 0) {
+        return generate_preset(preset_default, sizeof(preset_default) / sizeof(preset_default[0]), spec, output);
+    }
+    if (strcmp(preset, "stress") == 0) {
+        return generate_preset(preset_stress, sizeof(preset_stress) / sizeof(preset_stress[0]), spec, output);
+    }
+
+    printf("Error: Unknown preset '%s'.\n", preset);
+    return -1;
+}
@@ -39,6 +39,7 @@ typedef struct {
 typedef struct {
     char* inputFile;
     char* outputFile;
+    int quality;            // quantization table quality factor, 1-100 (50 = standard table)
 } PARAMETERS;
 
 BMP_IMAGE load_bmp_image(const char* inputFile);
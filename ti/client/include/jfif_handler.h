@@ -31,9 +31,9 @@ void write_app0(FILE *f);
 
 /*
 * Writes DQT marker - Define Quantization Table
-* It uses external quantization table std_lum_qt
+* Input: quantization table in zigzag order
 */
-void write_dqt(FILE *f);
+void write_dqt(FILE *f, const uint8_t *qt_zigzagged);
 
 /*
 * Writes SOF0 marker - Start of Frame
@@ -69,5 +69,6 @@ void write_bitstream(FILE *f, uint8_t *buffer, int length);
 * Input: buffer length
 * Input: image width
 * Input: image height
+* Input: quantization table in zigzag order (as built by build_quant_tables)
 */
-void write_to_jfif(FILE *f, uint8_t *buffer, int length, uint16_t width, uint16_t height);
+void write_to_jfif(FILE *f, uint8_t *buffer, int length, uint16_t width, uint16_t height, const uint8_t *qt_zigzagged);
@@ -97,7 +97,7 @@ void free_bmp_image(BMP_IMAGE image) {
 }
 
 PARAMETERS parse_parameters(int argc, char* argv[]) {
-    PARAMETERS params = {NULL, NULL};
+    PARAMETERS params = {NULL, NULL, 50};
     for(int i = 0; i < argc; i++) {
         if(strcmp("-output", argv[i]) == 0 && i + 1 < argc) {
             params.outputFile = argv[++i];
@@ -105,6 +105,13 @@ PARAMETERS parse_parameters(int argc, char* argv[]) {
         else if(strcmp("-input", argv[i]) == 0 && i + 1 < argc) {
             params.inputFile = argv[++i];
         }
+        else if(strcmp("-quality", argv[i]) == 0 && i + 1 < argc) {
+            params.quality = (int)strtol(argv[++i], NULL, 10);
+            if(params.quality < 1 || params.quality > 100) {
+                printf("Warning: Quality must be 1-100, using 50.\n");
+                params.quality = 50;
+            }
+        }
     }
     return params;
 }
@@ -36,7 +36,7 @@ void write_app0(FILE *f) {
     fputc(0x00, f);         // thumbnail height (0 = no thumbnail)
 }
 
-void write_dqt(FILE *f) {
+void write_dqt(FILE *f, const uint8_t *qt_zigzagged) {
     fputc(0xFF, f);
     fputc(0xDB, f);         // DQT marker
 
@@ -46,7 +46,7 @@ void write_dqt(FILE *f) {
                             // upper 4 bits represent precision (0 = 8-bit)
                             // lower 4 bits represent table ID (0 = Luminance)
 
-    fwrite(std_lum_qt_zigzagged, 1, 64, f);
+    fwrite(qt_zigzagged, 1, 64, f);
 }
 
 void write_sof0(FILE *f, uint16_t width, uint16_t height) {
@@ -159,10 +159,10 @@ void write_bitstream(FILE *f, uint8_t *buffer, int length) {
     fwrite(buffer, 1, length, f);
 }
 
-void write_to_jfif(FILE *f, uint8_t *buffer, int length, uint16_t width, uint16_t height) {
+void write_to_jfif(FILE *f, uint8_t *buffer, int length, uint16_t width, uint16_t height, const uint8_t *qt_zigzagged) {
     write_soi(f);
     write_app0(f);
-    write_dqt(f);      
+    write_dqt(f, qt_zigzagged);      
     write_sof0(f, width, height);
     write_dht(f);      
     write_sos(f);
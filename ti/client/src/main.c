@@ -21,7 +21,7 @@
 // --------------------------------------------------------------------------------
 // Function Declaration
 // --------------------------------------------------------------------------------
-void send_image_to_c7x(RGB *original_rgb_data, int width, int height, uint8_t* result, uint32_t* result_size);
+int send_image_to_c7x(RGB *original_rgb_data, int width, int height, const float *qt_recip, uint8_t** result, uint32_t* result_size);
 void image_to_blocks(RGB *image_buffer, uint32_t width, uint32_t height, uint32_t *out_blocks_w, uint32_t *out_blocks_h, RGB *out_blocks);
 
 // --------------------------------------------------------------------------------
@@ -60,20 +60,33 @@ int main(int argc, char **argv)
     printf("Original size: %u x %u\n", image.info.width, image.info.height);
     printf("File size: %u\n", image.header.file_size);
 
-    uint8_t* buffer = (uint8_t*)calloc(image.info.width *  image.info.height, sizeof(uint8_t));
+    // Quantization tables for the requested quality (DQT form for the file, reciprocals for the C7x)
+    uint8_t qt[64];
+    uint8_t qt_zigzagged[64];
+    float qt_recip[64];
+    build_quant_tables(params.quality, qt, qt_zigzagged, qt_recip);
+
+    uint8_t* buffer = NULL;
     uint32_t result_size;
 
-    // Dispatch processing to C7x
-    send_image_to_c7x(block_order_pixels, blocks_w * 8, blocks_h * 8, buffer, &result_size);
+    // Dispatch processing to C7x, the scan comes back in a buffer of its exact size
+    if (send_image_to_c7x(block_order_pixels, blocks_w * 8, blocks_h * 8, qt_recip, &buffer, &result_size) != 0) {
+        free(block_order_pixels);
+        free(pixels);
+        free(image.buffer);
+        appDeInit();
+        return -1;
+    }
 
     FILE *f_out = fopen(params.outputFile, "wb");
     if(f_out) {
-        write_to_jfif(f_out, buffer, result_size, image.info.width, image.info.height);
+        write_to_jfif(f_out, buffer, result_size, image.info.width, image.info.height, qt_zigzagged);
         fclose(f_out);
         printf("[A72] JFIF serialization completed.\n");
     }
 
     free(buffer);
+    free(block_order_pixels);
     free(pixels);
     free(image.buffer);
     appDeInit();
@@ -111,20 +124,80 @@ void image_to_blocks(RGB *image_buffer, uint32_t width, uint32_t height, uint32_
 // --------------------------------------------------------------------------------
 // A72 Logic to communicate with C7x
 // --------------------------------------------------------------------------------
-void send_image_to_c7x(RGB* original_rgb_data, int width, int height, uint8_t* result, uint32_t* result_size)
+/*
+* Runs the C7x service once with an output buffer of 'capacity' bytes.
+* Returns 0 on success, 1 if the scan did not fit, -1 on error. On success *result holds a
+* heap copy of the scan.
+*/
+static int run_c7x_service(JPEG_COMPRESSION_DTO *packet, uint32_t capacity, uint8_t** result, uint32_t* result_size)
+{
+    uint8_t *shared_output_virt = appMemAlloc(APP_MEM_HEAP_DDR, capacity, 64);
+    if (!shared_output_virt) {
+        printf("[A72] Error: Memory allocation failed!\n");
+        return -1;
+    }
+
+    packet->phys_addr_y_out = appMemGetVirt2PhyBufPtr((uint64_t)shared_output_virt, APP_MEM_HEAP_DDR);
+    packet->output_capacity = capacity;
+    packet->output_size = 0;
+    packet->output_overflow = 0;
+
+    printf("[A72] Sending IPC message to C7x...\n");
+    printf("[A72] Targeting service: %s\n", JPEG_COMPRESSION_REMOTE_SERVICE_NAME);
+
+    // CALL REMOTE SERVICE
+    int32_t status = appRemoteServiceRun(
+        APP_IPC_CPU_C7x_1,                     
+        JPEG_COMPRESSION_REMOTE_SERVICE_NAME,  
+        0,                  
+        packet,                               
+        sizeof(*packet),                       
+        0                                      
+    );
+
+    int ret = 0;
+    if (status != 0) {
+        printf("[A72] Error: Remote service call failed with status %d\n", status);
+        ret = -1;
+    } else if (packet->output_overflow) {
+        printf("[A72] Scan does not fit in %u bytes.\n", capacity);
+        ret = 1;
+    } else {
+        printf("[A72] Remote service success!\n");
+
+        // CACHE INVALIDATE: Pull data from DDR to A72 Cache to see what C7x wrote
+        appMemCacheInv(shared_output_virt, packet->output_size);
+
+        // Copy result to an exactly sized buffer
+        *result = (uint8_t*)malloc(packet->output_size ? packet->output_size : 1);
+        if (*result == NULL) {
+            printf("[A72] Error: Memory allocation failed!\n");
+            ret = -1;
+        } else {
+            memcpy(*result, shared_output_virt, packet->output_size);
+            *result_size = packet->output_size;
+        }
+    }
+
+    appMemFree(APP_MEM_HEAP_DDR, shared_output_virt, capacity);
+    return ret;
+}
+
+int send_image_to_c7x(RGB* original_rgb_data, int width, int height, const float *qt_recip, uint8_t** result, uint32_t* result_size)
 {
     uint32_t plane_size = width * height;
     uint32_t total_input_size = plane_size * 3;
+    uint32_t batch_count = (plane_size / 64 + JPEG_BATCH_BLOCKS - 1) / JPEG_BATCH_BLOCKS;
+    uint32_t worst_case_size = batch_count * JPEG_BATCH_BLOCKS * JPEG_MAX_BLOCK_BYTES + 2;
 
     printf("[A72] Allocating shared memory...\n");
 
     // Allocate contiguous memory in DDR
     uint8_t *shared_input_virt = appMemAlloc(APP_MEM_HEAP_DDR, total_input_size, 64);
-    uint8_t *shared_output_virt = appMemAlloc(APP_MEM_HEAP_DDR, plane_size, 64);
 
-    if (!shared_input_virt || !shared_output_virt) {
+    if (!shared_input_virt) {
         printf("[A72] Error: Memory allocation failed!\n");
-        return;
+        return -1;
     }
 
     // Separate planar pointers
@@ -147,43 +220,25 @@ void send_image_to_c7x(RGB* original_rgb_data, int width, int height, uint8_t* r
     JPEG_COMPRESSION_DTO packet;
     packet.width = width;
     packet.height = height;
+    memcpy(packet.qt_recip, qt_recip, sizeof(packet.qt_recip));
 
     // Each processor has it's own virtual memory space. We need to translate virtual -> physical address.
     uint64_t input_phys_base = appMemGetVirt2PhyBufPtr((uint64_t)shared_input_virt, APP_MEM_HEAP_DDR);
     
     packet.phys_addr_r = input_phys_base;
     packet.phys_addr_gb = input_phys_base + plane_size;
-    
-    packet.phys_addr_y_out = appMemGetVirt2PhyBufPtr((uint64_t)shared_output_virt, APP_MEM_HEAP_DDR);
 
-    
-    printf("[A72] Sending IPC message to C7x...\n");
-    printf("[A72] Targeting service: %s\n", JPEG_COMPRESSION_REMOTE_SERVICE_NAME);
+    // One byte per pixel covers typical images; the C7x checks the room before every batch of
+    // blocks, and a scan that does not fit is encoded again into a worst-case sized buffer
+    uint32_t capacity = plane_size;
+    if (capacity < JPEG_BATCH_BLOCKS * JPEG_MAX_BLOCK_BYTES + 2) capacity = JPEG_BATCH_BLOCKS * JPEG_MAX_BLOCK_BYTES + 2;
 
-    // CALL REMOTE SERVICE
-    int32_t status = appRemoteServiceRun(
-        APP_IPC_CPU_C7x_1,                     
-        JPEG_COMPRESSION_REMOTE_SERVICE_NAME,  
-        0,                  
-        &packet,                               
-        sizeof(packet),                       
-        0                                      
-    );
-
-    if (status != 0) {
-        printf("[A72] Error: Remote service call failed with status %d\n", status);
-    } else {
-        printf("[A72] Remote service success!\n");
+    int status = run_c7x_service(&packet, capacity, result, result_size);
+    if (status == 1) {
+        status = run_c7x_service(&packet, worst_case_size, result, result_size);
     }
 
-    // CACHE INVALIDATE: Pull data from DDR to A72 Cache to see what C7x wrote
-    appMemCacheInv(shared_output_virt, plane_size);
-
-    // Copy result to out buffer
-    *result_size = packet.output_size;
-    memcpy(result, shared_output_virt, packet.output_size);
-    
     // Free Memory
     appMemFree(APP_MEM_HEAP_DDR, shared_input_virt, total_input_size);
-    appMemFree(APP_MEM_HEAP_DDR, shared_output_virt, plane_size);
+    return status == 0 ? 0 : -1;
 }
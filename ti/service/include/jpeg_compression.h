@@ -38,6 +38,12 @@
 
 #define PI_VAL 3.14159265358979323846f
 
+// Worst-case entropy-coded size of one block (DC + 63 AC codes of up to 26 bits, every byte stuffed)
+#define JPEG_MAX_BLOCK_BYTES 416
+
+// Blocks the C7x fetches, transforms and encodes per batch
+#define JPEG_BATCH_BLOCKS 32
+
 /*
 * Structure definitions. These are used when passing data via IPC.
 */
@@ -55,9 +61,19 @@ typedef struct
     // uint64_t phys_addr_intermediate_3;    
     // uint64_t phys_addr_dct_buff;
     uint64_t phys_addr_y_out;               // return value
+    uint32_t output_capacity;               // size of the output buffer, set by the host
     uint32_t output_size;
+    uint32_t output_overflow;               // 1 = the C7x stopped because the output buffer was too small
+    float qt_recip[64];                     // reciprocal quantization table (row-major), built by the host for the requested quality
 } JPEG_COMPRESSION_DTO;
 
+/*
+* Builds quantization tables for a quality factor 1-100 (IJG scaling of std_lum_qt, 50 = standard table).
+* Used by the host at encoder init; the reciprocal table is passed to the C7x in JPEG_COMPRESSION_DTO.
+* Output: row-major table, the same table in zigzag order (DQT form), reciprocal table (1.0/val)
+*/
+void build_quant_tables(int quality, uint8_t *out_qt, uint8_t *out_qt_zigzagged, float *out_qt_recip);
+
 #ifdef DEBUG_CYCLE_COUNT
     extern uint64_t timer1;
     extern uint64_t timer2;
@@ -72,8 +88,7 @@ typedef struct
 #ifdef __C7000__
     #define ASSERT_ALIGNED_64(x) (_nassert(((uint64_t)(x) & 0x3F) == 0))
 
-    extern uint8_t std_lum_qt[64];                  // quantization table declaration (defined in quantization_table.c)
-    extern const float std_lum_qt_recip[64];        // precalculated reciprocal standard quantization table (defined in quantization_table_reciprocal.c)
+    extern const uint8_t std_lum_qt[64];               // quantization table declaration (defined in quantization_table.c)
 
     typedef struct {
         uint8_t *buffer;    // Buffer in which we write encoded coefficients
@@ -137,7 +152,8 @@ typedef struct
     }
     #endif
 
-    void quantize_block(float* restrict dct_block, int16_t* restrict out_quantized_block, int16_t num_blocks);
+    // qt_recip: 64-byte aligned reciprocal quantization table
+    void quantize_block(float* restrict dct_block, int16_t* restrict out_quantized_block, int16_t num_blocks, const float* restrict qt_recip);
 
     void zigzag_order(const int16_t* restrict input_block, int16_t* restrict output_block, uint8_t num_blocks);
     void init_zigzag(void);
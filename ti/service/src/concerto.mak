@@ -6,7 +6,7 @@ TARGET      := app_utils_jpeg_compression
 TARGETTYPE  := library
 
 # Add your source file
-CSOURCES    := jpeg_compression.c quantization_table.c huffman_tables.c dct_matrix.c dct.c quantization.c quantization_table_reciprocal.c zigzag.c encoding.c
+CSOURCES    := jpeg_compression.c quantization_table.c huffman_tables.c dct_matrix.c dct.c quantization.c zigzag.c encoding.c
 CPPSOURCES  := fetch_block.cpp
 
 # For passing through user flags
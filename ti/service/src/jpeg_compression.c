@@ -4,7 +4,7 @@
 #include <utils/mem/include/app_mem.h>
 #include <math.h>
 
-#define NUM_BLOCKS 32
+#define NUM_BLOCKS JPEG_BATCH_BLOCKS
 
 #ifdef DEBUG_CYCLE_COUNT
     static void format_commas(uint64_t n, char *out) {
@@ -85,6 +85,10 @@ int32_t JpegCompression_RemoteServiceHandler(char *service_name, uint32_t cmd, v
     float __attribute__((aligned(64))) dct_block[size];
     int16_t __attribute__((aligned(64))) quantized_dct[size];
     int16_t __attribute__((aligned(64))) zigzagged[size];
+    float __attribute__((aligned(64))) qt_recip[64];
+
+    // Quantization table for the requested quality, copied out of the DTO for aligned vector loads
+    memcpy(qt_recip, packet->qt_recip, sizeof(qt_recip));
 
     // We are procesing num-blocks at once.
     // This could lead to memory unsafety, but because we are configuring SE with total_pixels
@@ -100,8 +104,16 @@ int32_t JpegCompression_RemoteServiceHandler(char *service_name, uint32_t cmd, v
     bw.current = 0;
 
     int16_t global_prev_dc = 0;
+    packet->output_overflow = 0;
 
     for(i = 0; i < total_blocks; i += NUM_BLOCKS) {
+        // Stop before a batch that might not fit (2 more bytes for the final flush);
+        // the host retries with a larger buffer
+        if (packet->output_capacity - bw.byte_pos < NUM_BLOCKS * JPEG_MAX_BLOCK_BYTES + 2) {
+            packet->output_overflow = 1;
+            break;
+        }
+
         #ifdef DEBUG_CYCLE_COUNT
             start = __TSC;
         #endif
@@ -120,7 +132,7 @@ int32_t JpegCompression_RemoteServiceHandler(char *service_name, uint32_t cmd, v
             start = __TSC;
         #endif
 
-        quantize_block(dct_block, quantized_dct, NUM_BLOCKS);
+        quantize_block(dct_block, quantized_dct, NUM_BLOCKS, qt_recip);
 
         #ifdef DEBUG_CYCLE_COUNT
             total_quantization_time += __TSC - start;
@@ -151,7 +163,7 @@ int32_t JpegCompression_RemoteServiceHandler(char *service_name, uint32_t cmd, v
 
     // CACHE WRITEBACK (After processing)
     // Push data from cache to DDR so A72 can read it. 
-    appMemCacheWb(vec_y, total_pixels);
+    appMemCacheWb(vec_y, bw.byte_pos);
 
     // Perform cycle calculation and print
 
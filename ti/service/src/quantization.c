@@ -2,14 +2,15 @@
 #include <math.h>
 #include <c7x.h>
 
-void quantize_block(float* restrict dct_block, int16_t* restrict out_quantized_block, int16_t num_blocks) {
+void quantize_block(float* restrict dct_block, int16_t* restrict out_quantized_block, int16_t num_blocks, const float* restrict qt_recip) {
     ASSERT_ALIGNED_64(dct_block);
     ASSERT_ALIGNED_64(out_quantized_block);
+    ASSERT_ALIGNED_64(qt_recip);
 
     uint8_t b = 0;
     float16* input = (float16*)dct_block;
     short16* out = (short16*)out_quantized_block;
-    float16* dct_table = (float16*)std_lum_qt_recip;
+    const float16* dct_table = (const float16*)qt_recip;
 
     // Load QT table once
     float16 tbl_row0 = dct_table[0];
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include "jpeg_compression.h"
 
 /*
 * Predefined luminance quantization table.
@@ -28,3 +29,38 @@ const uint8_t std_lum_qt_zigzagged[64] = {
     95, 98, 103, 104, 103, 62, 77, 113,
     121, 112, 100, 120, 92, 101, 103, 99
 };
+
+/*
+* Zigzag position -> row-major index.
+*/
+static const uint8_t qt_zigzag_map[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+void build_quant_tables(int quality, uint8_t *out_qt, uint8_t *out_qt_zigzagged, float *out_qt_recip) {
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
+
+    // IJG scaling: percentage applied to the base table
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+    for (int i = 0; i < 64; i++) {
+        int value = (std_lum_qt[i] * scale + 50) / 100;
+        if (value < 1) value = 1;
+        if (value > 255) value = 255;       // baseline DQT holds 8-bit values
+
+        out_qt[i] = (uint8_t)value;
+        out_qt_recip[i] = 1.0f / (float)value;
+    }
+
+    for (int i = 0; i < 64; i++) {
+        out_qt_zigzagged[i] = out_qt[qt_zigzag_map[i]];
+    }
+}
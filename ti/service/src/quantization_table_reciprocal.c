@@ -1,16 +0,0 @@
-/*
- * Reciprocal value of quantization table (1.0/val).
- */
-
-#include <stdint.h>
-
-const __attribute__((aligned(64))) float std_lum_qt_recip[64] = {
-    0.062500000f,  0.090909091f,  0.100000000f,  0.062500000f,  0.041666667f,  0.025000000f,  0.019607843f,  0.016393443f,  
-    0.083333333f,  0.083333333f,  0.071428571f,  0.052631579f,  0.038461538f,  0.017241379f,  0.016666667f,  0.018181818f,  
-    0.071428571f,  0.076923077f,  0.062500000f,  0.041666667f,  0.025000000f,  0.017543860f,  0.014492754f,  0.017857143f,  
-    0.071428571f,  0.058823529f,  0.045454545f,  0.034482759f,  0.019607843f,  0.011494253f,  0.012500000f,  0.016129032f,  
-    0.055555556f,  0.045454545f,  0.027027027f,  0.017857143f,  0.014705882f,  0.009174312f,  0.009708738f,  0.012987013f,  
-    0.041666667f,  0.028571429f,  0.018181818f,  0.015625000f,  0.012345679f,  0.009615385f,  0.008849558f,  0.010869565f,  
-    0.020408163f,  0.015625000f,  0.012820513f,  0.011494253f,  0.009708738f,  0.008264463f,  0.008333333f,  0.009900990f,  
-    0.013888889f,  0.010869565f,  0.010526316f,  0.010204082f,  0.008928571f,  0.010000000f,  0.009708738f,  0.010101010f   
-};